@@ -74,6 +74,7 @@ static AudioGeneratorWAVLoop *wav;
 
 static AudioFileSourceFSLoop *myFS0L;
 static AudioFileSourceSDLoop *mySD0L;
+static AudioFileSourceSDLoop *mySD1L;     // Pre-opened next music track
 
 static AudioOutputI2S *out;
 
@@ -82,12 +83,65 @@ bool audioMute = false;
 
 bool            haveMusic = false;
 bool            mpActive = false;
-static uint16_t *playList = NULL;
 static int      mpCurrIdx = 0;
 
+// Shuffle: Play order is a keyed permutation of the track numbers
+// (4-round Feistel network, cycle-walked down to the number of 
+// tracks). No play list needs to be stored, and the permutation is 
+// invertible, so looking up a track's position is O(1).
+#define MP_SHUF_ROUNDS  4
+#define MP_SHUF_HIST    4         // Tracks not repeated after a reshuffle
+#define MP_SHUF_TRIES   8         // Max attempts to find a suitable key
+static uint32_t mpShufSeed = 0;
+static uint32_t mpShufKey[MP_SHUF_ROUNDS];
+static uint16_t mpShufHBits = 0;
+static uint16_t mpShufHMask = 0;
+
+// Gapless: Next track is opened (and ID3 skipped) while
+// current one is still playing
+#define MP_PRELOAD_DELAY 2000     // ms after track start
+#define MP_PRELOAD_TRIES 10       // max missing files to skip
+static int           mpPreIdx = -1;
+static bool          mpPreChecked = false;
+static unsigned long mpTrackNow = 0;
+
+// Music library index: One file per music folder holding the number of
+// tracks and per-track meta data (title, artist, duration). Built once 
+// after renaming, so a (re)boot or folder switch only needs to validate 
+// it instead of searching for the last file.
+// Each entry holds the track's file size as a fingerprint: At boot, the
+// sizes of first and last track are checked; every other track is
+// checked (and re-scanned if it was replaced) when its info is loaded.
+#define MPLIB_MAGIC    0x494c4744    // "DGLI"
+#define MPLIB_VERSION  2
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t maxMusic;
+} MPLibHeader;
+static MPLibEntry    mpCurInfo;
+static int           mpCurInfoTrack = -1;
+
 Aud_State  aud_state  = { .state = 0, .curVolume = DEFAULT_VOLUME, .curTrack = 0, .maxMusic = 0, .mpShuffle = 0 };
 #ifdef DG_HAVEMQTT
-Aud_State  mpOldState = { .state = -1 };
+// Status backchannel: Changed fields are flagged, bursts of changes
+// (eg. volume up/down repeated) are published as one document after
+// MP_STAT_INT. While playing, the position is re-sent every MP_STAT_POS_INT.
+#define MP_STAT_INT      250
+#define MP_STAT_POS_INT  10000
+#define MPS_STATE        0x01
+#define MPS_TRACK        0x02
+#define MPS_VOL          0x04
+#define MPS_LAST         0x08
+#define MPS_SHUF         0x10
+#define MPS_POS          0x20
+#define MPS_ALL          0x3f
+static Aud_State     mpOldState = { .state = -1 };
+static uint8_t       mpStatDirty = MPS_ALL;
+static unsigned long mpStatLastPub = 0;
+static unsigned long mpStatLastPos = 0;
+static char          mpStatBuf[256];
+static int           mpStatLen = 0;
 #endif
 
 static const float volTable[VOL_LEVELS] = {
@@ -122,6 +176,7 @@ static char     keySnd[] = "/key3.mp3";   // not const
 static uint32_t haveKeySnd = 0;
 
 static const char *tcdrdone = "/TCD_DONE.TXT";   // leave "TCD", SD is interchangable this way
+static const char *mplibfn  = "/DG_INDEX.BIN";
 unsigned long   renNow1;
 unsigned long   renNow2;
 
@@ -129,6 +184,16 @@ static float    getVolume();
 
 static int      mp_findMaxNum();
 static bool     mp_checkForFile(int num);
+static void     mp_shuffleSetKey(uint32_t seed);
+static int      mp_idx2track(int idx);
+static int      mp_track2idx(int track);
+static void     mp_reshuffle();
+static void     mp_preload();
+static bool     mp_play_preloaded();
+static void     mp_dropPreload();
+static bool     mplib_check(int folder, int& maxMusic);
+static void     mplib_build(bool isSetup);
+static void     mplib_loadInfo(int track);
 static void     mp_nextprev(bool forcePlay, bool next);
 static bool     mp_play_int(bool force);
 static void     mp_buildFileName(char *fnbuf, int num);
@@ -136,6 +201,7 @@ static bool     mp_renameFilesInDir(bool isSetup);
 static uint8_t* mpren_renOrder(uint8_t *a, uint32_t s, int e);
 uint8_t*        m(uint8_t *a, uint32_t s, int e) { return mpren_renOrder(a, s, e/4); }
 static void     mpren_insertionSort(char **a, int n);
+static void     mpren_looper(bool isSetup, bool checking, int perc);
 
 /*
  * audio_setup()
@@ -157,6 +223,7 @@ void audio_setup()
 
     if(haveSD) {
         mySD0L = new AudioFileSourceSDLoop();
+        mySD1L = new AudioFileSourceSDLoop();
     }
 
     loadCurVolume();
@@ -191,19 +258,25 @@ void audio_loop()
 {   
     if(mp3->isRunning()) {
         if(!mp3->loop()) {
-            mp3->stop();
             playingEmpty = playingDoor = false;
             key_playing = 0;
             if(appendFile) {
+                mp3->stop();
                 play_file(append_audio_file, append_flags, append_vol);
-            } else if(mpActive) {
-                mp_next(true);
+            } else if(!mpActive || !mp_play_preloaded()) {
+                mp3->stop();
+                if(mpActive) mp_next(true);
             }
-        } else if(dynVol) {
-            sampleCnt++;
-            if(sampleCnt > 1) {
-                out->SetGain(getVolume());
-                sampleCnt = 0;
+        } else {
+            if(dynVol) {
+                sampleCnt++;
+                if(sampleCnt > 1) {
+                    out->SetGain(getVolume());
+                    sampleCnt = 0;
+                }
+            }
+            if(mpActive && !mpPreChecked && (millis() - mpTrackNow > MP_PRELOAD_DELAY)) {
+                mp_preload();
             }
         }
     } else if(wav->isRunning()) {
@@ -251,6 +324,19 @@ static int32_t skipID3(char *buf)
     return 0;
 }
 
+static void play_setflags(uint32_t flags, float volumeFactor)
+{
+    curVolFact = volumeFactor;
+    dynVol     = (flags & PA_DYNVOL) ? true : false;
+
+    playingEmpty = (flags & PA_ISEMPTY) ? true : false;
+    playingEmptyEnds = false;
+    playingDoor = (flags & PA_DOOR) ? true : false;
+    key_playing = flags & 0x1ff00;
+    
+    out->SetGain(getVolume());
+}
+
 void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
 {
     char buf[64];
@@ -285,15 +371,7 @@ void play_file(const char *audio_file, uint32_t flags, float volumeFactor)
         wav->stop();
     }
 
-    curVolFact = volumeFactor;
-    dynVol     = (flags & PA_DYNVOL) ? true : false;
-
-    playingEmpty = (flags & PA_ISEMPTY) ? true : false;
-    playingEmptyEnds = false;
-    playingDoor = (flags & PA_DOOR) ? true : false;
-    key_playing = flags & 0x1ff00;
-    
-    out->SetGain(getVolume());
+    play_setflags(flags, volumeFactor);
 
     buf[0] = 0;
 
@@ -490,12 +568,10 @@ void mp_init(bool isSetup)
     
     haveMusic = false;
 
-    if(playList) {
-        free(playList);
-        playList = NULL;
-    }
+    mp_dropPreload();
 
     mpCurrIdx = aud_state.curTrack = aud_state.maxMusic = 0;
+    mpCurInfoTrack = -1;
     
     if(haveSD) {
         #ifdef DG_DBG
@@ -508,28 +584,19 @@ void mp_init(bool isSetup)
         if(SD.exists(fnbuf)) {
             haveMusic = true;
 
-            aud_state.maxMusic = mp_findMaxNum();
+            if(!mplib_check(musFolderNum, aud_state.maxMusic)) {
+                aud_state.maxMusic = mp_findMaxNum();
+                mplib_build(isSetup);
+            }
             #ifdef DG_DBG
             Serial.printf("MusicPlayer: last file num %d\n", aud_state.maxMusic);
             #endif
 
-            playList = (uint16_t *)malloc((aud_state.maxMusic + 1) * 2);
-
-            if(!playList) {
+            // Init play order
+            mp_makeShuffle(!!aud_state.mpShuffle);
 
-                haveMusic = false;
-                #ifdef DG_DBG
-                Serial.println("MusicPlayer: Failed to allocate PlayList");
-                #endif
-
-            } else {
-
-                // Init play list
-                mp_makeShuffle(!!aud_state.mpShuffle);
-                
-            }
-
-            aud_state.curTrack = playList[0];
+            mpCurrIdx = 0;
+            aud_state.curTrack = mp_idx2track(0);
 
         } else {
             #ifdef DG_DBG
@@ -577,35 +644,34 @@ static int mp_findMaxNum()
     return i;
 }
 
-void mp_makeShuffle(bool enable)
+void mp_makeShuffle(bool enable, uint32_t seed)
 {
-    int numMsx = aud_state.maxMusic + 1;
-
     aud_state.mpShuffle = enable ? 1 : 0;
     saveShuffle();
 
-    if(haveMusic) {
-    
-        for(int i = 0; i < numMsx; i++) {
-            playList[i] = i;
-        }
+    mp_dropPreload();
+
+    if(haveMusic && enable) {
+
+        // Keep position in terms of track, not index
+        int curTrack = aud_state.curTrack;
+
+        mp_shuffleSetKey(seed ? seed : esp_random());
+        mpCurrIdx = mp_track2idx(curTrack);
         
-        if(enable && numMsx > 2) {
-            for(int i = 0; i < numMsx; i++) {
-                int ti = esp_random() % numMsx;
-                uint16_t t = playList[ti];
-                playList[ti] = playList[i];
-                playList[i] = t;
-            }
-            /*
-            #ifdef DG_DBG
-            for(int i = 0; i <= aud_state.maxMusic; i++) {
-                Serial.printf("%d ", playList[i]);
-                if((i+1) % 16 == 0 || i == aud_state.maxMusic) Serial.printf("\n");
-            }
-            #endif
-            */
+        /*
+        #ifdef DG_DBG
+        for(int i = 0; i <= aud_state.maxMusic; i++) {
+            Serial.printf("%d ", mp_idx2track(i));
+            if((i+1) % 16 == 0 || i == aud_state.maxMusic) Serial.printf("\n");
         }
+        #endif
+        */
+
+    } else if(haveMusic) {
+
+        mpCurrIdx = aud_state.curTrack;
+        
     }
 
     #ifdef DG_HAVEMQTT
@@ -632,6 +698,8 @@ bool mp_stop(bool forceStatus)
 {
     bool ret = mpActive;
     
+    mp_dropPreload();
+    
     if(mpActive) {
         mp3->stop();
         mpActive = false;
@@ -666,7 +734,13 @@ static void mp_nextprev(bool forcePlay, bool next)
     do {
         if(next) {
             mpCurrIdx++;
-            if(mpCurrIdx > aud_state.maxMusic) mpCurrIdx = 0;
+            if(mpCurrIdx > aud_state.maxMusic) {
+                mpCurrIdx = 0;
+                if(aud_state.mpShuffle) {
+                    mp_reshuffle();
+                    oldIdx = aud_state.maxMusic;
+                }
+            }
         } else {
             mpCurrIdx--;
             if(mpCurrIdx < 0) mpCurrIdx = aud_state.maxMusic;
@@ -684,30 +758,29 @@ int mp_gotonum(int num, bool forcePlay)
     if(num < 0) num = 0;
     else if(num > aud_state.maxMusic) num = aud_state.maxMusic;
 
-    if(aud_state.mpShuffle) {
-        for(int i = 0; i <= aud_state.maxMusic; i++) {
-            if(playList[i] == num) {
-                mpCurrIdx = i;
-                break;
-            }
-        }
-    } else 
-        mpCurrIdx = num;
+    mpCurrIdx = mp_track2idx(num);
 
     mp_play(forcePlay);
 
-    return playList[mpCurrIdx];
+    return mp_idx2track(mpCurrIdx);
 }
 
 static bool mp_play_int(bool force)
 {
     char fnbuf[20];
 
-    mp_buildFileName(fnbuf, playList[mpCurrIdx]);
+    int track = mp_idx2track(mpCurrIdx);
+
+    mp_dropPreload();
+
+    mp_buildFileName(fnbuf, track);
     if(SD.exists(fnbuf)) {
-        if(force) play_file(fnbuf, PA_MUSIC|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, 1.0f);
+        if(force) {
+            play_file(fnbuf, PA_MUSIC|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, 1.0f);
+            mpTrackNow = millis();
+        }
         mpActive = force;
-        aud_state.curTrack = playList[mpCurrIdx];
+        aud_state.curTrack = track;
         #ifdef DG_HAVEMQTT
         mp_sendStatus();
         #endif
@@ -716,29 +789,314 @@ static bool mp_play_int(bool force)
     return false;
 }
 
-#ifdef DG_HAVEMQTT
-void mp_sendStatus(int force)
+/*
+ * Gapless playback: Pre-open next track
+ */
+
+static void mp_preload()
 {
-    if(pubMP && mqttConnected()) {
-        aud_state.state = (!FPBUnitIsOn || TTrunning || !haveMusic || dgBusy) ? 0 : (mpActive ? 1 : 2);         
-        if(memcmp((void *)&mpOldState, (void *)&aud_state, sizeof(aud_state)) || force) {
-            static const char statec[] = "OPI";
-            char msg[128];
-            sprintf(msg, 
-                "{\"S\":\"%c\",\"C\":\"%d\",\"V\":\"%d\",\"F\":\"0\",\"L\":\"%d\",\"SH\":\"%d\"}", 
-                    statec[aud_state.state], 
-                    aud_state.curTrack, 
-                    (aud_state.curVolume * 100 / (VOL_LEVELS - 1)), 
-                    aud_state.maxMusic, 
-                    aud_state.mpShuffle);
-            if(mqttPublish("bttf/dg/mpstatus", msg, strlen(msg) + 1)) {
-                memcpy((void *)&mpOldState, (void *)&aud_state, sizeof(aud_state));
-            } else {
-                mpOldState.state = -1;
+    char fnbuf[20];
+    char buf[10];
+    int idx = mpCurrIdx;
+
+    mpPreChecked = true;
+
+    if(!haveSD || !haveMusic || mpPreIdx >= 0)
+        return;
+
+    for(int i = 0; i < MP_PRELOAD_TRIES; i++) {
+        idx++;
+        // Wrapping around in shuffle mode means reshuffle;
+        // leave this to mp_next().
+        if(idx > aud_state.maxMusic) {
+            if(aud_state.mpShuffle) return;
+            idx = 0;
+        }
+        if(idx == mpCurrIdx) return;
+        
+        mp_buildFileName(fnbuf, mp_idx2track(idx));
+        if(mySD1L->open(fnbuf)) {
+            int32_t curSeek;
+            mySD1L->setPlayLoop(false);
+            mySD1L->read((void *)buf, 10);
+            curSeek = skipID3(buf);
+            mySD1L->setStartPos(curSeek);
+            mySD1L->seek(curSeek, SEEK_SET);
+            mpPreIdx = idx;
+            #ifdef DG_DBG
+            Serial.printf("MusicPlayer: Pre-opened %s\n", fnbuf);
+            #endif
+            return;
+        }
+    }
+}
+
+static bool mp_play_preloaded()
+{
+    AudioFileSourceSDLoop *t;
+    
+    if(mpPreIdx < 0 || audioMute)
+        return false;
+
+    // Keep the output running: What is left in its buffer
+    // plays while the next track starts decoding
+    mp3->stopKeepOutput();
+
+    // Swap sources; the pre-opened one becomes current
+    t = mySD0L;
+    mySD0L = mySD1L;
+    mySD1L = t;
+
+    mpCurrIdx = mpPreIdx;
+    mpPreIdx = -1;
+    mpPreChecked = false;
+    mpTrackNow = millis();
+
+    appendFile = false;
+    play_setflags(PA_MUSIC|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, 1.0f);
+    mp3->begin(mySD0L, out);
+
+    aud_state.curTrack = mp_idx2track(mpCurrIdx);
+    #ifdef DG_HAVEMQTT
+    mp_sendStatus();
+    #endif
+
+    return true;
+}
+
+static void mp_dropPreload()
+{
+    if(mpPreIdx >= 0) {
+        mySD1L->close();
+        mpPreIdx = -1;
+    }
+    mpPreChecked = false;
+}
+
+/*
+ * Shuffle permutation
+ */
+
+static uint32_t mp_shuffleRound(uint32_t x, uint32_t k)
+{
+    x ^= k;
+    x *= 0x45d9f3b;
+    x ^= x >> 16;
+    x *= 0x45d9f3b;
+    x ^= x >> 16;
+    
+    return x & mpShufHMask;
+}
+
+static void mp_shuffleSetKey(uint32_t seed)
+{
+    int numMsx = aud_state.maxMusic + 1;
+    uint32_t k = seed ? seed : 0x9e3779b9;
+
+    mpShufSeed = seed;
+
+    // Split domain into two halves of equal bit width,
+    // large enough to hold numMsx
+    for(mpShufHBits = 1; (1 << (mpShufHBits * 2)) < numMsx; mpShufHBits++);
+    mpShufHMask = (1 << mpShufHBits) - 1;
+    
+    for(int i = 0; i < MP_SHUF_ROUNDS; i++) {
+        k ^= k << 13; k ^= k >> 17; k ^= k << 5;    // xorshift32
+        mpShufKey[i] = k;
+    }
+}
+
+static int mp_idx2track(int idx)
+{
+    uint32_t l, r, t;
+
+    if(!aud_state.mpShuffle || aud_state.maxMusic < 2)
+        return idx;
+
+    // Cycle-walk until result is within range. Domain is at
+    // most 4 times the number of tracks, so this terminates
+    // quickly.
+    do {
+        l = (uint32_t)idx >> mpShufHBits;
+        r = (uint32_t)idx & mpShufHMask;
+        for(int i = 0; i < MP_SHUF_ROUNDS; i++) {
+            t = r;
+            r = l ^ mp_shuffleRound(r, mpShufKey[i]);
+            l = t;
+        }
+        idx = (l << mpShufHBits) | r;
+    } while(idx > aud_state.maxMusic);
+
+    return idx;
+}
+
+static int mp_track2idx(int track)
+{
+    uint32_t l, r, t;
+
+    if(!aud_state.mpShuffle || aud_state.maxMusic < 2)
+        return track;
+
+    do {
+        l = (uint32_t)track >> mpShufHBits;
+        r = (uint32_t)track & mpShufHMask;
+        for(int i = MP_SHUF_ROUNDS - 1; i >= 0; i--) {
+            t = l;
+            l = r ^ mp_shuffleRound(l, mpShufKey[i]);
+            r = t;
+        }
+        track = (l << mpShufHBits) | r;
+    } while(track > aud_state.maxMusic);
+
+    return track;
+}
+
+// New play order at end of list; avoid playing one of 
+// the last MP_SHUF_HIST tracks again right away
+static void mp_reshuffle()
+{
+    int numMsx = aud_state.maxMusic + 1;
+    int hist = (numMsx >= MP_SHUF_HIST * 4) ? MP_SHUF_HIST : 0;
+    uint16_t last[MP_SHUF_HIST];
+    uint32_t seed = mpShufSeed;
+
+    for(int i = 0; i < hist; i++) {
+        last[i] = mp_idx2track(numMsx - 1 - i);
+    }
+    
+    for(int t = 0; t < MP_SHUF_TRIES; t++) {
+        bool clash = false;
+        seed = seed * 1664525 + 1013904223;
+        if(!seed) seed++;
+        mp_shuffleSetKey(seed);
+        for(int i = 0; i < hist && !clash; i++) {
+            int nt = mp_idx2track(i);
+            for(int j = 0; j < hist; j++) {
+                if(nt == last[j]) {
+                    clash = true;
+                    break;
+                }
             }
         }
+        if(!clash) break;
+    }
+    
+    #ifdef DG_DBG
+    Serial.printf("MusicPlayer: Reshuffled, seed %x\n", mpShufSeed);
+    #endif
+}
+
+#ifdef DG_HAVEMQTT
+static void mps_putStr(const char *str)
+{
+    while(*str && mpStatLen < (int)sizeof(mpStatBuf) - 1) {
+        mpStatBuf[mpStatLen++] = *str++;
     }
 }
+
+static void mps_putInt(int val)
+{
+    char buf[12];
+    int i = 0;
+    unsigned int v = (val < 0) ? -val : val;
+
+    do {
+        buf[i++] = '0' + (v % 10);
+        v /= 10;
+    } while(v);
+    if(val < 0) buf[i++] = '-';
+
+    while(i && mpStatLen < (int)sizeof(mpStatBuf) - 1) {
+        mpStatBuf[mpStatLen++] = buf[--i];
+    }
+}
+
+// Add "key":"value"; strings are JSON-safe (mplib_putChar)
+static void mps_putKeyStr(const char *key, const char *val)
+{
+    mps_putStr(mpStatLen > 1 ? ",\"" : "\"");
+    mps_putStr(key);
+    mps_putStr("\":\"");
+    mps_putStr(val);
+    mps_putStr("\"");
+}
+
+static void mps_putKeyInt(const char *key, int val)
+{
+    mps_putStr(mpStatLen > 1 ? ",\"" : "\"");
+    mps_putStr(key);
+    mps_putStr("\":\"");
+    mps_putInt(val);
+    mps_putStr("\"");
+}
+
+static void mps_buildStatus()
+{
+    static const char *statec[] = { "O", "P", "I" };
+    int pos = 0;
+    
+    mplib_loadInfo(aud_state.curTrack);
+    if(aud_state.state == 1) {
+        pos = (millis() - mpTrackNow) / 1000;
+        if(mpCurInfo.duration && pos > mpCurInfo.duration) pos = mpCurInfo.duration;
+    }
+
+    mpStatLen = 0;
+    mps_putStr("{");
+    mps_putKeyStr("S", statec[aud_state.state]);
+    mps_putKeyInt("C", aud_state.curTrack);
+    mps_putKeyInt("V", aud_state.curVolume * 100 / (VOL_LEVELS - 1));
+    mps_putKeyStr("F", "0");
+    mps_putKeyInt("L", aud_state.maxMusic);
+    mps_putKeyInt("SH", aud_state.mpShuffle);
+    mps_putKeyStr("T", mpCurInfo.title);
+    mps_putKeyStr("A", mpCurInfo.artist);
+    mps_putKeyInt("D", mpCurInfo.duration);
+    mps_putKeyInt("P", pos);
+    mps_putStr("}");
+    mpStatBuf[mpStatLen] = 0;
+}
+
+void mp_sendStatus(int force)
+{
+    unsigned long now;
+    
+    if(!pubMP || !mqttConnected())
+        return;
+        
+    aud_state.state = (!FPBUnitIsOn || TTrunning || !haveMusic || dgBusy) ? 0 : (mpActive ? 1 : 2);
+
+    if(aud_state.state != mpOldState.state)           mpStatDirty |= MPS_STATE;
+    if(aud_state.curTrack != mpOldState.curTrack)     mpStatDirty |= MPS_TRACK;
+    if(aud_state.curVolume != mpOldState.curVolume)   mpStatDirty |= MPS_VOL;
+    if(aud_state.maxMusic != mpOldState.maxMusic)     mpStatDirty |= MPS_LAST;
+    if(aud_state.mpShuffle != mpOldState.mpShuffle)   mpStatDirty |= MPS_SHUF;
+
+    now = millis();
+
+    if(mpStatDirty & (MPS_STATE|MPS_TRACK)) {
+        mpStatLastPos = now;
+    } else if(aud_state.state == 1 && now - mpStatLastPos >= MP_STAT_POS_INT) {
+        mpStatDirty |= MPS_POS;
+    }
+
+    if(force) {
+        mpStatDirty |= MPS_ALL;
+    } else if(!mpStatDirty || (now - mpStatLastPub < MP_STAT_INT)) {
+        return;
+    }
+
+    mps_buildStatus();
+
+    if(mqttPublish("bttf/dg/mpstatus", mpStatBuf, mpStatLen + 1)) {
+        mpOldState = aud_state;
+        mpStatDirty = 0;
+        mpStatLastPos = now;
+    }
+
+    // Also on failure, to avoid retrying on every call
+    mpStatLastPub = now;
+}
 #endif
 
 static void mp_buildFileName(char *fnbuf, int num)
@@ -795,6 +1153,391 @@ int mp_checkForFolder(int num)
     return -1;
 }
 
+/*
+ * Music library index
+ */
+
+static void mplib_buildFileName(char *fnbuf, int folder)
+{
+    sprintf(fnbuf, "/music%1d%s", folder, mplibfn);
+}
+
+// Check if size of track file matches the one in index entry
+static bool mplib_checkSize(int folder, int num, uint32_t size)
+{
+    char fnbuf[32];
+    bool ret = false;
+
+    sprintf(fnbuf, "/music%1d/%03d.mp3", folder, num);
+    File f = SD.open(fnbuf, FILE_READ);
+    if(f) {
+        ret = (f.size() == size);
+        f.close();
+    }
+
+    return ret;
+}
+
+// Check if index exists and matches folder contents
+static bool mplib_check(int folder, int& maxMusic)
+{
+    char fnbuf[32];
+    MPLibHeader hdr;
+    MPLibEntry first, last;
+    bool ret = false;
+
+    mplib_buildFileName(fnbuf, folder);
+    File f = SD.open(fnbuf, FILE_READ);
+    if(!f) return false;
+
+    if(f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr)        &&
+       hdr.magic == MPLIB_MAGIC && hdr.version == MPLIB_VERSION   &&
+       f.size() == sizeof(hdr) + (hdr.maxMusic + 1) * sizeof(MPLibEntry)) {
+        f.read((uint8_t *)&first, sizeof(first));
+        f.seek(sizeof(hdr) + hdr.maxMusic * sizeof(MPLibEntry));
+        ret = (f.read((uint8_t *)&last, sizeof(last)) == sizeof(last));
+    }
+    f.close();
+    
+    // First and last file must exist with same size as when
+    // indexed, the one after the last must not exist
+    if(ret) {
+        if(mplib_checkSize(folder, 0, first.size) && 
+           mplib_checkSize(folder, hdr.maxMusic, last.size)) {
+            if(hdr.maxMusic < 999) {
+                sprintf(fnbuf, "/music%1d/%03d.mp3", folder, hdr.maxMusic + 1);
+                ret = !SD.exists(fnbuf);
+            }
+        } else {
+            ret = false;
+        }
+    }
+
+    if(ret) maxMusic = hdr.maxMusic;
+
+    #ifdef DG_DBG
+    Serial.printf("MusicPlayer: Library index for folder %d %s\n", folder, ret ? "valid" : "missing or stale");
+    #endif
+
+    return ret;
+}
+
+bool mp_checkLibIndex(int folder)
+{
+    int temp;
+    
+    if(!haveSD) return true;
+    
+    return mplib_check(folder, temp);
+}
+
+static uint32_t mplib_syncsafe(uint8_t *b)
+{
+    return (b[0] << 21) | (b[1] << 14) | (b[2] << 7) | b[3];
+}
+
+static uint32_t mplib_be32(uint8_t *b)
+{
+    return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+// Append unicode char as UTF-8, make it JSON-safe
+static bool mplib_putChar(char *dst, int dstLen, int& o, uint16_t c)
+{
+    if(c < 0x20 || (c >= 0xd800 && c <= 0xdfff)) c = ' ';
+    else if(c == '"')  c = '\'';
+    else if(c == '\\') c = '/';
+    
+    if(c < 0x80) {
+        if(o + 1 >= dstLen) return false;
+        dst[o++] = c;
+    } else if(c < 0x800) {
+        if(o + 2 >= dstLen) return false;
+        dst[o++] = 0xc0 | (c >> 6);
+        dst[o++] = 0x80 | (c & 0x3f);
+    } else {
+        if(o + 3 >= dstLen) return false;
+        dst[o++] = 0xe0 | (c >> 12);
+        dst[o++] = 0x80 | ((c >> 6) & 0x3f);
+        dst[o++] = 0x80 | (c & 0x3f);
+    }
+    
+    return true;
+}
+
+// Convert ID3 text frame contents to UTF-8
+static void mplib_id3Text(char *dst, int dstLen, uint8_t *src, int len)
+{
+    int o = 0;
+    uint8_t enc;
+
+    if(len < 1) return;
+    
+    enc = *src++;
+    len--;
+    
+    if(enc == 1 || enc == 2) {
+        // UTF-16 (with BOM) or UTF-16BE
+        bool le = false;
+        if(enc == 1 && len >= 2) {
+            le = (src[0] == 0xff && src[1] == 0xfe);
+            src += 2;
+            len -= 2;
+        }
+        for(int i = 0; i + 1 < len; i += 2) {
+            uint16_t c = le ? (src[i] | (src[i+1] << 8)) : ((src[i] << 8) | src[i+1]);
+            if(!c || !mplib_putChar(dst, dstLen, o, c)) break;
+        }
+    } else if(enc == 3) {
+        // UTF-8: Copy, but do not cut multi-byte sequences
+        for(int i = 0; i < len && src[i]; ) {
+            int n = 1;
+            if(src[i] >= 0xf0)      n = 4;
+            else if(src[i] >= 0xe0) n = 3;
+            else if(src[i] >= 0xc0) n = 2;
+            if(n == 1) {
+                if(!mplib_putChar(dst, dstLen, o, src[i])) break;
+            } else {
+                if(o + n >= dstLen || i + n > len) break;
+                memcpy(dst + o, src + i, n);
+                o += n;
+            }
+            i += n;
+        }
+    } else {
+        // ISO-8859-1
+        for(int i = 0; i < len && src[i]; i++) {
+            if(!mplib_putChar(dst, dstLen, o, src[i])) break;
+        }
+    }
+
+    dst[o] = 0;
+}
+
+// Parse ID3v2 tag for title and artist; returns start of audio data
+static uint32_t mplib_scanID3(File& f, MPLibEntry *e, uint8_t *buf, int bufSize)
+{
+    uint32_t pos, end;
+    uint8_t ver;
+    int fhLen;
+    bool haveT = false, haveA = false;
+
+    if(f.read(buf, 10) != 10) return 0;
+    if(!skipID3((char *)buf)) return 0;
+
+    ver = buf[3];
+    end = mplib_syncsafe(&buf[6]) + 10;
+    pos = 10;
+
+    // Skip extended header
+    if((buf[5] & 0x40) && ver > 2) {
+        if(f.read(buf, 4) != 4) return end;
+        pos += (ver == 4) ? mplib_syncsafe(buf) : mplib_be32(buf) + 4;
+    }
+
+    fhLen = (ver == 2) ? 6 : 10;
+
+    while(pos + fhLen <= end && (!haveT || !haveA)) {
+        uint32_t size;
+        bool isT, isA;
+        
+        f.seek(pos);
+        if((int)f.read(buf, fhLen) != fhLen) break;
+        if(!buf[0]) break;     // Padding
+        
+        if(ver == 2) {
+            size = (buf[3] << 16) | (buf[4] << 8) | buf[5];
+            isT = !memcmp(buf, "TT2", 3);
+            isA = !memcmp(buf, "TP1", 3);
+        } else {
+            size = (ver == 4) ? mplib_syncsafe(&buf[4]) : mplib_be32(&buf[4]);
+            isT = !memcmp(buf, "TIT2", 4);
+            isA = !memcmp(buf, "TPE1", 4);
+        }
+        if(!size || pos + fhLen + size > end) break;
+
+        if(isT || isA) {
+            int len = min((int)size, bufSize);
+            if((int)f.read(buf, len) != len) break;
+            if(isT) {
+                mplib_id3Text(e->title, sizeof(e->title), buf, len);
+                haveT = true;
+            } else {
+                mplib_id3Text(e->artist, sizeof(e->artist), buf, len);
+                haveA = true;
+            }
+        }
+        
+        pos += fhLen + size;
+    }
+
+    return end;
+}
+
+// Determine duration from first MPEG frame (Xing/Info or CBR)
+static uint16_t mplib_duration(File& f, uint32_t audioStart, uint8_t *buf, int bufSize)
+{
+    static const uint8_t br1[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 0, 0, 0 };
+    static const uint8_t br2[16] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 };
+    static const uint16_t srt[3] = { 44100, 48000, 32000 };
+    uint32_t sr, br, spf, xoffs;
+    uint8_t ver;
+    int len, i;
+
+    f.seek(audioStart);
+    if((len = f.read(buf, bufSize)) < 64) return 0;
+
+    // Find frame sync
+    for(i = 0; i < len - 48; i++) {
+        if(buf[i] == 0xff && (buf[i+1] & 0xe0) == 0xe0) break;
+    }
+    if(i >= len - 48) return 0;
+
+    ver = (buf[i+1] >> 3) & 0x03;                       // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+    if(ver == 1 || ((buf[i+1] >> 1) & 0x03) != 1)       // Layer III only
+        return 0;
+    if(((buf[i+2] >> 2) & 0x03) == 3) return 0;
+
+    sr = srt[(buf[i+2] >> 2) & 0x03];
+    if(ver == 3) {
+        br = buf[i+2] >> 4;
+        br = (br == 13) ? 256 : ((br == 14) ? 320 : br1[br]);
+        spf = 1152;
+        xoffs = ((buf[i+3] >> 6) == 3) ? 17 : 32;
+    } else {
+        br = br2[buf[i+2] >> 4];
+        sr >>= (ver == 2) ? 1 : 2;
+        spf = 576;
+        xoffs = ((buf[i+3] >> 6) == 3) ? 9 : 17;
+    }
+
+    // VBR: Xing/Info header holds number of frames
+    xoffs += i + 4;
+    if(!memcmp(&buf[xoffs], "Xing", 4) || !memcmp(&buf[xoffs], "Info", 4)) {
+        if(buf[xoffs + 7] & 0x01) {
+            return mplib_be32(&buf[xoffs + 8]) * spf / sr;
+        }
+    }
+
+    if(!br) return 0;
+    
+    return (f.size() - audioStart - i) * 8 / (br * 1000);
+}
+
+static void mplib_scanTrack(int num, MPLibEntry *e, uint8_t *buf, int bufSize)
+{
+    char fnbuf[20];
+    
+    memset((void *)e, 0, sizeof(*e));
+    
+    mp_buildFileName(fnbuf, num);
+    File f = SD.open(fnbuf, FILE_READ);
+    if(f) {
+        e->size = f.size();
+        uint32_t audioStart = mplib_scanID3(f, e, buf, bufSize);
+        e->duration = mplib_duration(f, audioStart, buf, bufSize);
+        f.close();
+    }
+}
+
+static void mplib_build(bool isSetup)
+{
+    char fnbuf[32];
+    uint8_t buf[192];
+    MPLibHeader hdr = { MPLIB_MAGIC, MPLIB_VERSION, (uint16_t)aud_state.maxMusic };
+    MPLibEntry e;
+    int numMsx = aud_state.maxMusic + 1;
+    bool showProgress = (numMsx > 50);
+    
+    mplib_buildFileName(fnbuf, musFolderNum);
+    // Don't leave a stale index behind if we fail below
+    if(SD.exists(fnbuf)) SD.remove(fnbuf);
+    
+    File f = SD.open(fnbuf, FILE_WRITE);
+    if(!f) {
+        #ifdef DG_DBG
+        Serial.printf("MusicPlayer: Failed to create %s\n", fnbuf);
+        #endif
+        return;
+    }
+
+    // Header is written last, index is invalid until then
+    hdr.magic = 0;
+    f.write((uint8_t *)&hdr, sizeof(hdr));
+
+    renNow1 = renNow2 = millis();
+    
+    for(int i = 0; i < numMsx; i++) {
+        mpren_looper(isSetup, !showProgress, (numMsx - i) * 100 / numMsx);
+        mplib_scanTrack(i, &e, buf, sizeof(buf));
+        if(f.write((uint8_t *)&e, sizeof(e)) != sizeof(e)) {
+            f.close();
+            SD.remove(fnbuf);
+            return;
+        }
+    }
+
+    hdr.magic = MPLIB_MAGIC;
+    f.seek(0);
+    f.write((uint8_t *)&hdr, sizeof(hdr));
+    f.close();
+
+    #ifdef DG_DBG
+    Serial.printf("MusicPlayer: Wrote library index with %d entries\n", numMsx);
+    #endif
+}
+
+// Load meta data of given track into mpCurInfo
+static void mplib_loadInfo(int track)
+{
+    char fnbuf[32];
+
+    if(track == mpCurInfoTrack)
+        return;
+
+    memset((void *)&mpCurInfo, 0, sizeof(mpCurInfo));
+    mpCurInfoTrack = track;
+    
+    if(!haveSD || !haveMusic || track > aud_state.maxMusic)
+        return;
+
+    mplib_buildFileName(fnbuf, musFolderNum);
+    File f = SD.open(fnbuf, FILE_READ);
+    if(f) {
+        f.seek(sizeof(MPLibHeader) + track * sizeof(MPLibEntry));
+        if(f.read((uint8_t *)&mpCurInfo, sizeof(mpCurInfo)) != sizeof(mpCurInfo)) {
+            memset((void *)&mpCurInfo, 0, sizeof(mpCurInfo));
+        }
+        // Terminate, in case file was tampered with
+        mpCurInfo.title[sizeof(mpCurInfo.title) - 1] = 0;
+        mpCurInfo.artist[sizeof(mpCurInfo.artist) - 1] = 0;
+        f.close();
+    }
+
+    // Track replaced since indexed? Re-scan and update index.
+    if(!mplib_checkSize(musFolderNum, track, mpCurInfo.size)) {
+        uint8_t buf[192];
+        mplib_scanTrack(track, &mpCurInfo, buf, sizeof(buf));
+        f = SD.open(fnbuf, "r+");
+        if(f) {
+            if(f.seek(sizeof(MPLibHeader) + track * sizeof(MPLibEntry))) {
+                f.write((uint8_t *)&mpCurInfo, sizeof(mpCurInfo));
+            }
+            f.close();
+        }
+        #ifdef DG_DBG
+        Serial.printf("MusicPlayer: Track %d changed, index updated\n", track);
+        #endif
+    }
+}
+
+const MPLibEntry *mp_getTrackInfo()
+{
+    mplib_loadInfo(aud_state.curTrack);
+    
+    return &mpCurInfo;
+}
+
 /*
  * Auto-renamer
  */
@@ -852,27 +1595,192 @@ static void mpren_looper(bool isSetup, bool checking, int perc)
     }
 }
 
+// Directory scan: Enumeration runs in a separate task on the other
+// core, feeding file names through a bounded queue to the loop task, 
+// which filters and collects them (while keeping WiFi alive). If the
+// task cannot be created, everything is done on the loop task.
+
+#define MPREN_QUEUE_LEN  8
+#define MPREN_ITEM_SIZE  256
+
+typedef bool (*mpren_cb)(const char *fn, void *ctx);
+
+typedef struct {
+    bool          isSetup;
+    char          **d;
+    char          *c;
+    char          *bufs[8];
+    unsigned long bufSize;
+    int           allocBufIdx;
+    int           fileNum;
+    bool          stopLoop;
+} MPRenState;
+
+static QueueHandle_t mprenQueue = NULL;
+static volatile bool mprenScanStop = false;
+static const char   *mprenFuncName = "MusicPlayer/Renamer: ";
+
+// Call cb for every (non-directory) file in origin; names are 
+// passed without path.
+static void mpren_enumerate(File& origin, mpren_cb cb, void *ctx)
+{
+#ifdef HAVE_GETNEXTFILENAME
+    bool isDir;
+    String fileName = origin.getNextFileName(&isDir);
+    while(fileName.length() > 0) {
+        if(!isDir) {
+            const char *fn = fileName.c_str();
+            if(strlen(fn) < 256) {
+                if(!cb((fn[0] == '/') ? fn + 8 : fn, ctx)) break;
+            }
+        }
+        fileName = origin.getNextFileName(&isDir);
+    }
+#else
+    File file = origin.openNextFile();
+    while(file) {
+        if(!file.isDirectory()) {
+            const char *fn = file.name();
+            if(strlen(fn) < 256) {
+                if(!cb((fn[0] == '/') ? fn + 8 : fn, ctx)) {
+                    file.close();
+                    break;
+                }
+            }
+        }
+        file.close();
+        file = origin.openNextFile();
+    }
+#endif
+}
+
+// Filter and collect file name
+static void mpren_addName(MPRenState *st, const char *fn)
+{
+    unsigned long sz = strlen(fn) + 1;
+
+    if(st->stopLoop)
+        return;
+    
+    if((sz > st->bufSize) && (st->allocBufIdx < 7)) {
+        static const unsigned long bufSizes[8] = {
+            16384, 16384, 8192, 8192, 8192, 8192, 8192, 4096 
+        };
+        st->allocBufIdx++;
+        if(!(st->bufs[st->allocBufIdx] = (char *)malloc(bufSizes[st->allocBufIdx]))) {
+            Serial.printf("%sFailed to allocate additional sort buffer\n", mprenFuncName);
+        } else {
+            #ifdef DG_DBG
+            Serial.printf("%sAllocated additional sort buffer\n", mprenFuncName);
+            #endif
+            st->c = st->bufs[st->allocBufIdx];
+            st->bufSize = bufSizes[st->allocBufIdx];
+        }
+    }
+    if(sz <= st->bufSize) {
+        if(!mpren_checkFN(fn)) {
+            *st->d++ = st->c;
+            strcpy(st->c, fn);
+            #ifdef DG_DBG
+            Serial.printf("%sAdding '%s'\n", mprenFuncName, st->c);
+            #endif
+            st->c += sz;
+            st->bufSize -= sz;
+            st->fileNum++;
+        }
+    } else {
+        st->stopLoop = true;
+        Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", mprenFuncName);
+    }
+
+    if(st->fileNum >= 1000) st->stopLoop = true;
+}
+
+// Enumeration callback when running on loop task
+static bool mpren_addNameDirect(const char *fn, void *ctx)
+{
+    MPRenState *st = (MPRenState *)ctx;
+
+    mpren_looper(st->isSetup, true, 0);
+    mpren_addName(st, fn);
+
+    return !st->stopLoop;
+}
+
+// Enumeration callback when running in scan task
+static bool mpren_queueName(const char *fn, void *ctx)
+{
+    char *item = (char *)ctx;
+    
+    if(mprenScanStop)
+        return false;
+
+    strcpy(item, fn);
+    xQueueSend(mprenQueue, item, portMAX_DELAY);
+
+    return true;
+}
+
+static void mpren_scanTask(void *arg)
+{
+    char item[MPREN_ITEM_SIZE];
+
+    mpren_enumerate(*(File *)arg, mpren_queueName, item);
+
+    // Signal end of list
+    item[0] = 0;
+    xQueueSend(mprenQueue, item, portMAX_DELAY);
+
+    vTaskDelete(NULL);
+}
+
+static void mpren_scanDir(File& origin, MPRenState *st)
+{
+    char *item;
+
+    if((item = (char *)malloc(MPREN_ITEM_SIZE))) {
+        if((mprenQueue = xQueueCreate(MPREN_QUEUE_LEN, MPREN_ITEM_SIZE))) {
+            mprenScanStop = false;
+            if(xTaskCreatePinnedToCore(mpren_scanTask, "mpren", 4096, (void *)&origin, 
+                                       uxTaskPriorityGet(NULL), NULL, xPortGetCoreID() ^ 1) == pdPASS) {
+                // Receive until end marker; the scan task 
+                // does not touch origin after sending it.
+                for(;;) {
+                    mpren_looper(st->isSetup, true, 0);
+                    if(xQueueReceive(mprenQueue, item, pdMS_TO_TICKS(100)) != pdTRUE)
+                        continue;
+                    if(!*item) 
+                        break;
+                    mpren_addName(st, item);
+                    if(st->stopLoop) mprenScanStop = true;
+                }
+                vQueueDelete(mprenQueue);
+                mprenQueue = NULL;
+                free(item);
+                return;
+            }
+            #ifdef DG_DBG
+            Serial.printf("%sFailed to create scan task\n", mprenFuncName);
+            #endif
+            vQueueDelete(mprenQueue);
+            mprenQueue = NULL;
+        }
+        free(item);
+    }
+
+    // Fall back to scanning on loop task
+    mpren_enumerate(origin, mpren_addNameDirect, (void *)st);
+}
+
 static bool mp_renameFilesInDir(bool isSetup)
 {
     char fnbuf[20];
     char fnbuf3[32];
-    char **a, **d;
-    char *c;
+    char **a;
     int count = 0;
-    int fileNum = 0;
-    int strLength;
-    int nameOffs = 8;
-    int allocBufIdx = 0;
-    static const unsigned long bufSizes[8] = {
-        16384, 16384, 8192, 8192, 8192, 8192, 8192, 4096 
-    };
-    char *bufs[8] = { NULL };
-    unsigned long sz, bufSize;
-    bool stopLoop = false;
-#ifdef HAVE_GETNEXTFILENAME
-    bool isDir;
-#endif
-    const char *funcName = "MusicPlayer/Renamer: ";
+    int fileNum;
+    MPRenState st;
+    const char *funcName = mprenFuncName;
 
     renNow1 = renNow2 = millis();
 
@@ -916,120 +1824,28 @@ static bool mp_renameFilesInDir(bool isSetup)
         return false;
     }
 
+    memset((void *)&st, 0, sizeof(st));
+    st.isSetup = isSetup;
+
     // Allocate (first) buffer for file names
-    if(!(bufs[0] = (char *)malloc(bufSizes[0]))) {
+    if(!(st.bufs[0] = (char *)malloc(16384))) {
         Serial.printf("%sFailed to allocate first sort buffer\n", funcName);
         origin.close();
         free(a);
         return false;
     }
 
-    c = bufs[0];
-    bufSize = bufSizes[0];
-    d = a;
+    st.c = st.bufs[0];
+    st.bufSize = 16384;
+    st.d = a;
 
     // Loop through all files in folder
-
-#ifdef HAVE_GETNEXTFILENAME
-    String fileName = origin.getNextFileName(&isDir);
-    // Check if File::name() returns FQN or plain name
-    if(fileName.length() > 0) nameOffs = (fileName.charAt(0) == '/') ? 8 : 0;
-    while(!stopLoop && fileName.length() > 0)
-#else
-    File file = origin.openNextFile();
-    // Check if File::name() returns FQN or plain name
-    if(file) nameOffs = (file.name()[0] == '/') ? 8 : 0;
-    while(!stopLoop && file)
-#endif
-    {
-
-        mpren_looper(isSetup, true, 0);
-
-#ifdef HAVE_GETNEXTFILENAME
-
-        if(!isDir) {
-            const char *fn = fileName.c_str();
-            strLength = strlen(fn);
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                } else {
-                    #ifdef DG_DBG
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(fn + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, fn + nameOffs);
-                    #ifdef DG_DBG
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
-                stopLoop = true;
-                Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
-            }
-        }
-        
-#else // --------------
-
-        if(!file.isDirectory()) {
-            strLength = strlen(file.name());
-            sz = strLength - nameOffs + 1;
-            if((sz > bufSize) && (allocBufIdx < 7)) {
-                allocBufIdx++;
-                if(!(bufs[allocBufIdx] = (char *)malloc(bufSizes[allocBufIdx]))) {
-                    Serial.printf("%sFailed to allocate additional sort buffer\n", funcName);
-                } else {
-                    #ifdef DG_DBG
-                    Serial.printf("%sAllocated additional sort buffer\n", funcName);
-                    #endif
-                    c = bufs[allocBufIdx];
-                    bufSize = bufSizes[allocBufIdx];
-                }
-            }
-            if((strLength < 256) && (sz <= bufSize)) {
-                if(!mpren_checkFN(file.name() + nameOffs)) {
-                    *d++ = c;
-                    strcpy(c, file.name() + nameOffs);
-                    #ifdef DG_DBG
-                    Serial.printf("%sAdding '%s'\n", funcName, c);
-                    #endif
-                    c += sz;
-                    bufSize -= sz;
-                    fileNum++;
-                }
-            } else if(sz > bufSize) {
-                stopLoop = true;
-                Serial.printf("%sSort buffer(s) exhausted, remaining files ignored\n", funcName);
-            }
-        }
-        file.close();
-        
-#endif
-        
-        if(fileNum >= 1000) stopLoop = true;
-
-        if(!stopLoop) {
-            #ifdef HAVE_GETNEXTFILENAME
-            fileName = origin.getNextFileName(&isDir);
-            #else
-            file = origin.openNextFile();
-            #endif
-        }
-    }
+    mpren_scanDir(origin, &st);
 
     origin.close();
 
+    fileNum = st.fileNum;
+
     #ifdef DG_DBG
     Serial.printf("%s%d files to process\n", funcName, fileNum);
     #endif
@@ -1079,8 +1895,8 @@ static bool mp_renameFilesInDir(bool isSetup)
         }
     }
 
-    for(int i = 0; i <= allocBufIdx; i++) {
-        if(bufs[i]) free(bufs[i]);
+    for(int i = 0; i <= st.allocBufIdx; i++) {
+        if(st.bufs[i]) free(st.bufs[i]);
     }
     free(a);
 
@@ -95,8 +95,9 @@ bool     mp_stop(bool forceStatus = false);
 void     mp_next(bool forcePlay = false);
 void     mp_prev(bool forcePlay = false);
 int      mp_gotonum(int num, bool force = false);
-void     mp_makeShuffle(bool enable);
+void     mp_makeShuffle(bool enable, uint32_t seed = 0);
 int      mp_checkForFolder(int num);
+bool     mp_checkLibIndex(int folder);
 uint8_t* m(uint8_t *a, uint32_t s, int e);
 #ifdef DG_HAVEMQTT
 void     mp_sendStatus(int force = 0);
@@ -111,6 +112,16 @@ typedef struct {
 } Aud_State;
 extern Aud_State aud_state;
 
+typedef struct {
+    uint16_t duration;          // seconds, 0 if unknown
+    uint16_t reserved;
+    uint32_t size;              // file size, to detect replaced files
+    char     title[48];         // UTF-8, JSON-safe
+    char     artist[32];
+} MPLibEntry;
+
+const MPLibEntry *mp_getTrackInfo();
+
 extern bool audioInitDone;
 extern bool audioMute;
 
@@ -57,9 +57,11 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <Wire.h>
+#include <lwip/sockets.h>
 
 #include "dgdisplay.h"
 #include "input.h"
+#include "dg_sched.h"
 
 #include "dg_main.h"
 #include "dg_settings.h"
@@ -85,7 +87,7 @@ static uint8_t center_gauge_empty = 0;
 static uint8_t right_gauge_empty = 0;
 
 // The emptyLED object
-static EmptyLED emptyLED = EmptyLED(0);
+static EmptyLED emptyLED = EmptyLED();
 
 // The side switch
 static DGButton sideSwitch = DGButton(SIDESWITCH_PIN,
@@ -158,18 +160,29 @@ static bool          dsPlayTCDO = false;
 static bool          doorTCDS = true;
 static unsigned long dsDelay = 0;
 static unsigned long dsDelayC = 0;
-static unsigned long dsNow = 0;
-static unsigned long d2sNow = 0;
-static unsigned long dsADelay = 0;
-static unsigned long d2sADelay = 0;
 static bool          dsOpen = false;
 static bool          d2sOpen = false;
-static bool          dsTimer = false;
-static bool          d2sTimer = false;
+static struct schedTimer dsTimer;
+static struct schedTimer d2sTimer;
 
 static unsigned long lastDoorSoundNow = 0;
 static int           lastDoorNum = 0;
 
+// Door events, written by tick job, read by main loop
+#define DS_EVQ_LEN  8       // Power of 2
+struct dsEvent {
+    unsigned long time;
+    uint8_t       door;
+    bool          active;
+};
+static struct dsEvent dsEvQ[DS_EVQ_LEN];
+static volatile uint8_t dsEvHead = 0;
+static volatile uint8_t dsEvTail = 0;
+static volatile bool    dsEvOverflow = false;
+
+// Door latency histograms
+static struct dsLatStats dsLat;
+
 uint16_t             doPlayDoorSound = 0;
 unsigned long        doPlayDoorSoundNow = 0;
 #endif
@@ -180,11 +193,11 @@ bool showUpdAvail = true;
 
 #define STARTUP_DELAY 2300
 bool                 startup = false;
-static unsigned long startupNow = 0;
+static struct schedTimer startupTimer;
 
 #define REFILL_DELAY 1235
 bool                 refill = false;
-static unsigned long refillNow = 0;
+static struct schedTimer refillTimer;
 bool                 refillWA = false;
 
 static unsigned long autoRefill = 0;
@@ -192,7 +205,7 @@ static unsigned long autoMute = 0;
 
 #define ALARM_DELAY 1000
 bool                 startAlarm = false;
-static unsigned long startAlarmNow = 0;
+static struct schedTimer startAlarmTimer;
 
 bool networkTimeTravel = false;
 bool networkTCDTT      = false;
@@ -226,19 +239,14 @@ bool doWakeup = false;
 bool                 TTrunning = false;  // TT sequence is running
 static bool          extTT = false;      // TT was triggered by TCD
 static unsigned long TTstart = 0;
-static unsigned long TTfUpdNow = 0;
 static unsigned long P0duration = ETTO_LEAD;
 static unsigned long P1_maxtimeout = 10000;
 static bool          TTP0 = false;
 static bool          TTP1 = false;
 static bool          TTP2 = false;
-static unsigned long TTfUpdLNow = 0;
-static unsigned long TTfUpdCNow = 0; 
-static unsigned long TTfUpdRNow = 0;
-static unsigned long TTFIntL = 0;
-static unsigned long TTFIntC = 0;
-static unsigned long TTFIntR = 0;
-static int           TTStepL = 1, TTStepC = 1, TTStepR = 1;
+static unsigned long TTDurL = 0;
+static unsigned long TTDurC = 0;
+static unsigned long TTDurR = 0;
 static bool          TTdrPri = true, TTdrPPo = true, TTdrRoe = true;
 static bool          playTTsounds = true; // for stand-alone TT
 
@@ -288,10 +296,18 @@ static bool          mprengaugetouched = false;
 #define BTTF_PACKET_SIZE          48
 #define BTTF_DEFAULT_LOCAL_PORT 1338
 #define BTTFN_POLL_INT          1200
-#define BTTFN_RESPONSE_TO        700
+#define BTTFN_POLL_INT_FAST      400    // Poll interval after NOT_PREPARE
+#define BTTFN_POLL_FAST_DUR    20000    // Duration of fast polling
+#define BTTFN_POLL_INT_MAX     30000    // Max poll interval when backing off
+#define BTTFN_RETRIES              3    // Immediate retries before backing off
+#define BTTFN_RESPONSE_TO        700    // Initial (and max) response timeout
+#define BTTFN_RESPONSE_TO_MIN    200
 #define BTTFN_KA_OFFSET            7
 #define BTTFN_KA_INTERVAL  ((60+BTTFN_KA_OFFSET)*1000)
 #define BTTFN_DATA_TO          17400
+#define BTTFN_DRAIN_MAX            8    // Max unicast packets per loop
+#define BTTFN_DRAIN_BUDGET         4    // Max ms spent on draining
+#define BTTFN_SEQ_WINDOW          64    // Max age of reordered packets
 #define BTTFN_TYPE_ANY     0    // Any, unknown or no device
 #define BTTFN_TYPE_FLUX    1    // Flux Capacitor
 #define BTTFN_TYPE_SID     2    // SID
@@ -331,10 +347,10 @@ static bool          mprengaugetouched = false;
 #define BTTFN_TCDI2_BUSY    0x0001
 static const uint8_t BTTFUDPHD[4] = { 'B', 'T', 'T', 'F' };
 static bool          useBTTFN = false;
-static WiFiUDP       bttfUDP;
-static UDP*          dgUDP;
-static WiFiUDP       bttfMcUDP;
-static UDP*          dgMcUDP;
+static int           bttfnSock = -1;
+static int           bttfnMcSock = -1;
+static TaskHandle_t  bttfnRxTask = NULL;
+static unsigned long bttfnPktTime = 0;
 static byte          BTTFUDPBuf[BTTF_PACKET_SIZE];
 static byte          BTTFUDPTBuf[BTTF_PACKET_SIZE];
 static unsigned long BTTFNUpdateNow = 0;
@@ -343,6 +359,12 @@ static unsigned long BTTFNLastCmdSent = 0;
 static bool          BTTFNPacketDue = false;
 static bool          BTTFNWiFiUp = false;
 static uint8_t       BTTFNfailCount = 0;
+static unsigned long BTTFNPollInt = BTTFN_POLL_INT;
+static unsigned long BTTFNRespTO = BTTFN_RESPONSE_TO;
+static unsigned long BTTFNFastPollNow = 0;
+static unsigned long BTTFNsRTT = 0;         // Smoothed RTT (x8)
+static unsigned long BTTFNRTTVar = 0;       // RTT variation (x4)
+static bool          BTTFNHaveRTT = false;
 static uint32_t      BTTFUDPID = 0;
 static unsigned long lastBTTFNpacket = 0;
 static unsigned long lastBTTFNKA = 0;
@@ -362,13 +384,22 @@ static bool          TCDSupportsCMDDOOR = false;
 static bool          TCDSupportsSSID = false;
 static bool          bttfnDataNotEnabled = false;
 static uint32_t      tcdHostNameHash = 0;
-static byte          BTTFMCBuf[BTTF_PACKET_SIZE];
 static IPAddress     bttfnMcIP(224, 0, 0, 224);
 static uint32_t      bttfnSeqCnt = 1;
 
-static int      iCmdIdx = 0;
-static int      oCmdIdx = 0;
-static uint32_t commandQueue[16] = { 0 };
+// Command queue (multiple producers, single consumer)
+// A slot's seq, relative to the lap (pos & ~(CMDQ_LEN-1)),
+// is 0 if free, 1 if filled; consumer advances it to next lap.
+#define CMDQ_LEN  16    // Power of 2
+struct cmdSlot {
+    uint32_t seq;
+    uint32_t cmd;
+};
+static struct cmdSlot cmdQ[CMDQ_LEN];
+static uint32_t cmdQTail = 0;       // Next position to fill (producers)
+static uint32_t cmdQHead = 0;       // Next position to take (consumer)
+static uint32_t cmdQDropped = 0;    // Commands lost (queue full)
+#define CMD_BATCH_BUDGET  5     // Max ms spent on commands per loop
 
 #ifdef ESP32
 /*  "warning: taking address of packed member of 'struct <anonymous>' may 
@@ -380,14 +411,8 @@ static uint32_t commandQueue[16] = { 0 };
  *  penalty."
  *  https://docs.espressif.com/projects/esp-idf/en/v5.1/esp32s3/migration-guides/release-5.x/5.0/gcc.html
  */
-#define GET32(a,b)    *((uint32_t *)((a) + (b)))
 #define SET32(a,b,c)  *((uint32_t *)((a) + (b))) = c
 #else
-#define GET32(a,b)          \
-    (((a)[b])            |  \
-    (((a)[(b)+1]) << 8)  |  \
-    (((a)[(b)+2]) << 16) |  \
-    (((a)[(b)+3]) << 24))   
 #define SET32(a,b,c)                        \
     (a)[b]       = ((uint32_t)(c)) & 0xff;  \
     ((a)[(b)+1]) = ((uint32_t)(c)) >> 8;    \
@@ -395,19 +420,116 @@ static uint32_t commandQueue[16] = { 0 };
     ((a)[(b)+3]) = ((uint32_t)(c)) >> 24; 
 #endif
 
+/*
+ * BTTFN packet layout (received packets)
+ * 
+ * Packets are evaluated in place through these views after 
+ * bttfn_parse() validated them. Multi-byte fields are little 
+ * endian, as are all our targets. Offsets are checked below.
+ */
+struct __attribute__((packed)) bttfnRsp {   // Response to our request; NOT_DATA
+    uint8_t  hdr[4];        //  0: "BTTF"
+    uint8_t  ver;           //  4: Version | 0x80 (response) / 0x40 (notification)
+    uint8_t  flags;         //  5: Request bits echoed; notification type
+    uint32_t id;            //  6: Request ID; NOT_DATA: sequence counter
+    uint8_t  r1[8];
+    union {
+        int16_t  speed;     // 18: Speed
+        struct __attribute__((packed)) {
+            char    ssid7;  // 18: NOT_DATA w/ SSID: 7th char of SSID
+            uint8_t pwMark; // 19: NOT_DATA w/ SSID: password marker
+        };
+    };
+    uint8_t  r2[6];
+    uint8_t  status;        // 26: TCD status
+    uint32_t session;       // 27: NOT_DATA: session ID
+    uint8_t  caps;          // 31: TCD capabilities
+    uint8_t  r3[9];
+    uint8_t  ssid[6];       // 41: TCD's AP SSID (first 6 chars)
+    uint8_t  csum;          // 47: Checksum
+};
+
+struct __attribute__((packed)) bttfnNot {   // Notification
+    uint8_t  hdr[4];        //  0: "BTTF"
+    uint8_t  ver;           //  4: Version | 0x40
+    uint8_t  type;          //  5: BTTFN_NOT_xx
+    union {
+        uint32_t cmd;       //  6: NOT_PCG_CMD: Command
+        struct __attribute__((packed)) {
+            uint16_t p0;    //  6: NOT_SPD: Speed; NOT_TT: Lead; NOT_INFO: tcdi1
+            uint16_t p1;    //  8: NOT_SPD: Source; NOT_TT: P1 dur; NOT_INFO: tcdi2
+        };
+    };
+    uint8_t  r1[2];
+    uint32_t seq;           // 12: NOT_SPD: Sequence counter
+    uint8_t  r2[31];
+    uint8_t  csum;          // 47: Checksum
+};
+
+union bttfnPacket {
+    uint8_t         raw[BTTF_PACKET_SIZE];
+    struct bttfnRsp rsp;
+    struct bttfnNot ntf;
+};
+
+static_assert(sizeof(union bttfnPacket) == BTTF_PACKET_SIZE, "BTTFN packet size");
+static_assert(offsetof(struct bttfnRsp, speed)   == 18, "BTTFN rsp.speed");
+static_assert(offsetof(struct bttfnRsp, status)  == 26, "BTTFN rsp.status");
+static_assert(offsetof(struct bttfnRsp, session) == 27, "BTTFN rsp.session");
+static_assert(offsetof(struct bttfnRsp, caps)    == 31, "BTTFN rsp.caps");
+static_assert(offsetof(struct bttfnRsp, ssid)    == 41, "BTTFN rsp.ssid");
+static_assert(offsetof(struct bttfnRsp, csum)    == 47, "BTTFN rsp.csum");
+static_assert(offsetof(struct bttfnNot, p1)      ==  8, "BTTFN ntf.p1");
+static_assert(offsetof(struct bttfnNot, seq)     == 12, "BTTFN ntf.seq");
+static_assert(offsetof(struct bttfnNot, csum)    == 47, "BTTFN ntf.csum");
+
+#define BTTFN_PKT_INVALID   0
+#define BTTFN_PKT_NOT       1   // Notification from TCD
+#define BTTFN_PKT_RSP       2   // Response to our request
+
+/*
+ * BTTFN receive queues: Written by receive task (which
+ * validates and timestamps packets), read by main loop
+ */
+#define BTTFN_RXQ_LEN      16   // Power of 2
+#define BTTFN_RX_PRIO       1   // Receive task priority (above loop task)
+
+struct bttfnRxPkt {
+    unsigned long time;         // Time of arrival
+    uint32_t      srcIP;
+    int           kind;         // BTTFN_PKT_xx
+    uint8_t       buf[BTTF_PACKET_SIZE];
+};
+
+struct bttfnRxQueue {
+    struct bttfnRxPkt pkt[BTTFN_RXQ_LEN];
+    volatile uint8_t  head;
+    volatile uint8_t  tail;
+    volatile uint32_t dropped;
+};
+
+static struct bttfnRxQueue bttfnRxQ;
+static struct bttfnRxQueue bttfnMcRxQ;
+
 // Forward declarations ------
 
 static void timeTravel(bool TCDtriggered, uint16_t P0Dur, uint16_t P1Dur = 0);
 
 static void setTTOUT(uint8_t stat);
 
-static void execute_remote_command();
+static bool execute_remote_command();
+static uint32_t cmdq_peek();
+static void cmdq_pop();
 static void say_ip_address();
 
 static void startEmptyAlarm();
 static void stopEmptyAlarm();
 static bool checkGauges();
 
+static void startupDue(struct schedTimer *t, unsigned long now);
+static void startAlarmDue(struct schedTimer *t, unsigned long now);
+static void refillDue(struct schedTimer *t, unsigned long now);
+
 static void gauge_lights_on();
 static void gauge_lights_off();
 
@@ -415,13 +537,13 @@ static void sideSwitch_scan();
 static void sideSwitchLongPress();
 static void sideSwitchLongPressStop();
 #ifdef DG_HAVEDOORSWITCH
-static void doorSwitch_scan();
+static void doorSwitch_scan(bool handle);
+static void doorSwitch_sync();
 static void dsScan();
-static void doorSwitchLongPress();
-static void doorSwitchLongPressStop();
-static void door2SwitchLongPress();
-static void door2SwitchLongPressStop();
-static void play_door_snd(int doorNum, bool isOpen);
+static void dsHandle();
+static void doorSwitchChange(bool active, unsigned long edgeTime, void *arg);
+static bool play_door_snd(int doorNum, bool isOpen);
+static void doorSoundDue(struct schedTimer *t, unsigned long now);
 #endif
 static void ttkeyScan();
 static void TTKeyPressed();
@@ -439,6 +561,8 @@ static void ssEnd();
 static void ssRestartTimer();
 
 static void prepareTT();
+static unsigned long calcTTDrainDur(int perc, int empty, unsigned long P1Dur);
+static void startTTDrain();
 static void wakeup();
 
 static void volWasChanged();
@@ -474,6 +598,9 @@ void main_boot()
     pinMode(BACKLIGHTS_PIN, OUTPUT);
     
     gauge_lights_off();
+
+    // Start tick service (LED, input sampling)
+    tick_begin();
     
     // Set up "empty" LED
     emptyLED.begin(EMPTY_LED_PIN);
@@ -498,17 +625,16 @@ void main_boot2()
     
     // Init door switch(es)
     #ifdef DG_HAVEDOORSWITCH
+    // Door switches bypass the button state machine: Debounced
+    // changes are queued by the tick job and handled as soon as
+    // the main loop (or any wait loop) calls dsScan().
+    doorSwitch.attachChange(doorSwitchChange, (void *)1);
     doorSwitch.begin();
-    doorSwitch.setTiming(50, 10, 50);
-    doorSwitch.attachLongPressStart(doorSwitchLongPress);
-    doorSwitch.attachLongPressStop(doorSwitchLongPressStop);
     if(!dsTTout) {
+        door2Switch.attachChange(doorSwitchChange, (void *)2);
         door2Switch.begin();
-        door2Switch.setTiming(50, 10, 50);
-        door2Switch.attachLongPressStart(door2SwitchLongPress);
-        door2Switch.attachLongPressStop(door2SwitchLongPressStop);
     }
-    doorSwitch_scan();
+    doorSwitch_sync();
     #endif
 
     swInitNow = millis();
@@ -533,11 +659,20 @@ void main_setup()
     
     Serial.println("Dash Gauges version " DG_VERSION " " DG_VERSION_EXTRA);
 
+    sched_init(&startupTimer, startupDue);
+    sched_init(&startAlarmTimer, startAlarmDue);
+    sched_init(&refillTimer, refillDue);
+    #ifdef DG_HAVEDOORSWITCH
+    sched_init(&dsTimer, doorSoundDue, &dsOpen, 1);
+    sched_init(&d2sTimer, doorSoundDue, &d2sOpen, 2);
+    #endif
+
     if(gauges.supportVariablePercentage(0)) {
         left_gauge_idle = restrict_gauge_idle(atoi(settings.lIdle), 0, 100, DEF_L_GAUGE_IDLE);
         left_gauge_empty = restrict_gauge_empty(atoi(settings.lEmpty), 0, left_gauge_idle, DEF_L_GAUGE_EMPTY);
         if(left_gauge_empty >= left_gauge_idle) { left_gauge_idle = DEF_L_GAUGE_IDLE; left_gauge_empty = DEF_L_GAUGE_EMPTY; }
         TTdrPri = evalBool(settings.drPri);
+        gauges.setCalibration(0, settings.lCal);
     } else {
         left_gauge_idle = 100;
         left_gauge_empty = 0;
@@ -549,6 +684,7 @@ void main_setup()
         center_gauge_empty = restrict_gauge_empty(atoi(settings.cEmpty), 0, center_gauge_idle, DEF_C_GAUGE_EMPTY);
         if(center_gauge_empty >= center_gauge_idle) { center_gauge_idle = DEF_C_GAUGE_IDLE; center_gauge_empty = DEF_C_GAUGE_EMPTY; }
         TTdrPPo = evalBool(settings.drPPo);
+        gauges.setCalibration(1, settings.cCal);
     } else {
         center_gauge_idle = 100;
         center_gauge_empty = 0;
@@ -560,12 +696,16 @@ void main_setup()
         right_gauge_empty = restrict_gauge_empty(atoi(settings.rEmpty), 0, right_gauge_idle, DEF_R_GAUGE_EMPTY);
         if(right_gauge_empty >= right_gauge_idle) { right_gauge_idle = DEF_R_GAUGE_IDLE; right_gauge_empty = DEF_R_GAUGE_EMPTY; }
         TTdrRoe = evalBool(settings.drRoe);
+        gauges.setCalibration(2, settings.rCal);
     } else {
         right_gauge_idle = 100;
         right_gauge_empty = 0;
         TTdrRoe = true;
     }
 
+    // Needle inertia for analog gauges
+    gauges.setInertia(atoi(settings.inertia));
+
     // Thresholds for digital gauges
     gauges.setBinGaugeThreshold(0, atoi(settings.lThreshold));
     gauges.setBinGaugeThreshold(1, atoi(settings.cThreshold));
@@ -573,6 +713,9 @@ void main_setup()
 
     // Other options
     ssDelay = ssOrigDelay = atoi(settings.ssTimer) * 60 * 1000;    
+    if(*settings.elPat && !emptyLED.setBlinkPattern(settings.elPat)) {
+        Serial.println("Bad 'empty' LED pattern, using standard blink");
+    }
     useNM = evalBool(settings.useNM);
     useFPO = evalBool(settings.useFPO);
     bttfnTT = evalBool(settings.bttfnTT);
@@ -686,9 +829,7 @@ void main_setup()
     sideSwitch_scan();
     isSSwitchChange = false;
     #ifdef DG_HAVEDOORSWITCH
-    doorSwitch_scan();
-    isDSwitchChange = false;
-    isD2SwitchChange = false;
+    doorSwitch_sync();
     #endif
 
     #ifdef DG_DBG
@@ -713,7 +854,7 @@ void main_setup()
         // Play startup
         gauge_lights_on();
         startup = true;
-        startupNow = millis();
+        sched_start(&startupTimer, millis(), STARTUP_DELAY);
         
         ssRestartTimer();
 
@@ -724,9 +865,13 @@ void main_loop()
 {
     unsigned long now = millis();
 
-    // Execute scheduled digital gauge changes
+    // Move gauges
     gauges.loop();
 
+    // Run expired timers (startup, alarm, refill, door sounds,
+    // scheduled digital gauge changes)
+    sched_run(now);
+
     // Scan door switches
     #ifdef DG_HAVEDOORSWITCH
     dsScan();
@@ -794,7 +939,7 @@ void main_loop()
             gauge_lights_on();            
             
             startup = true;
-            startupNow = millis();
+            sched_start(&startupTimer, millis(), STARTUP_DELAY);
             
             // FIXME - anything else?
  
@@ -816,34 +961,17 @@ void main_loop()
     }
 
     // Timers
+    // (startup, startAlarm and refill are run by timers, see below)
     if(FPBUnitIsOn) {
-        // Turn display on after startup delay
-        if(startup && (millis() - startupNow >= STARTUP_DELAY)) {
-            gauges.on();
-            if(checkGauges()) {    // Check if empty, and trigger alarm if so
-                play_file("/startup.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
-            }
-            startup = false;
-        }
-        // Start alarm (after delay to give gauges time to go to 0)
-        if(startAlarm && (millis() - startAlarmNow >= ALARM_DELAY)) {
-            startEmptyAlarm();
-            startAlarm = false;
-        }
         // Initiate refill after audio has finished
         if(refillWA && (!playingEmpty || checkAudioDone())) {
             play_file("/refill.mp3", PA_INTRMUS|PA_ALLOWSD, 0.6f);
             refillWA = false;
             if(!ssActive) {
                 refill = true;
-                refillNow = millis();
+                sched_start(&refillTimer, millis(), REFILL_DELAY);
             }
         }
-        // Update gauges after refill (sound-sync'd)
-        if(refill && (millis() - refillNow >= REFILL_DELAY)) {
-            gauges.UpdateAll();
-            refill = false;
-        }
         if(!TTrunning && !startup && !startAlarm && !refill && !refillWA) {
             if(autoRefill && emptyAlarm && (millis() - emptyAlarmNow >= autoRefill)) {
                 refill_plutonium();
@@ -871,61 +999,7 @@ void main_loop()
 
     // Door switch/sound handling
     #ifdef DG_HAVEDOORSWITCH
-    now = millis();
-    if(dsTimer && now - dsNow >= dsADelay) {
-        // delay door sound by max 500ms, otherwise effect is lost and we skip it
-        if(now - dsNow <= dsADelay + 500) {
-            play_door_snd(1, dsOpen);
-        }
-        dsTimer = false;
-    }
-    if(d2sTimer && now - d2sNow >= d2sADelay) {
-        // delay door sound by max 500ms, otherwise effect is lost and we skip it
-        if(now - d2sNow <= d2sADelay + 500) {
-            play_door_snd(2, d2sOpen);
-        }
-        d2sTimer = false;
-    }
-    
-    if(dsPlay && isDSwitchChange) {
-        dsOpen = (isDSwitchPressed != dsCloseOnClose);
-        if(!dsPlayO || doorTCDFPO) {
-            unsigned long del = dsOpen ? dsDelay : dsDelayC;
-            if(!bttfn_send_door(dsOpen, 1, del)) {
-                if(!refillWA) {
-                    unsigned long timePassed = now - isDSwitchChangeNow;
-                    if(del && (del > timePassed + 100)) {
-                        dsTimer = true;
-                        dsADelay = del;
-                        dsNow = isDSwitchChangeNow;
-                    } else if(timePassed < 500) {
-                        play_door_snd(1, dsOpen);
-                    }
-                }
-            }
-        }
-        isDSwitchChange = false;
-    }
-    
-    if(dsPlay && isD2SwitchChange) {
-        d2sOpen = (isD2SwitchPressed != dsCloseOnClose);
-        if(!dsPlayO || doorTCDFPO) {
-            unsigned long del = d2sOpen ? dsDelay : dsDelayC;
-            if(!bttfn_send_door(d2sOpen, 2, del)) {
-                if(!refillWA) {
-                    unsigned long timePassed = now - isD2SwitchChangeNow;
-                    if(del && (del > timePassed + 100)) {
-                        d2sTimer = true;
-                        d2sADelay = del;
-                        d2sNow = isD2SwitchChangeNow;
-                    } else if(timePassed < 500) {
-                        play_door_snd(2, d2sOpen);
-                    }
-                }
-            }
-        }
-        isD2SwitchChange = false;
-    }
+    // (Switch changes are handled in dsScan())
     
     // Eval MQTT command
     if(!dsPlay && doPlayDoorSound) {
@@ -1066,7 +1140,8 @@ void main_loop()
 
                     TTP0 = false;
                     TTP1 = true;
-                    TTstart = TTfUpdLNow = TTfUpdCNow = TTfUpdRNow = now;
+                    TTstart = now;
+                    startTTDrain();
                     setTTOUT(HIGH);
 
                 }
@@ -1077,35 +1152,7 @@ void main_loop()
                     (!networkTCDTT && digitalRead(TT_IN_PIN)))               &&
                     (millis() - TTstart < P1_maxtimeout) ) {
 
-                    bool doUpd = false;
-                    
-                    if(TTdrPri && TTFIntL && (now - TTfUpdLNow >= TTFIntL)) {
-                        int t = gauges.getValuePercent(0);
-                        if(t >= left_gauge_empty + TTStepL) t -= TTStepL;
-                        else t = left_gauge_empty;
-                        gauges.setValuePercent(0, t);
-                        TTfUpdLNow = now;
-                        doUpd = true;
-                    }
-                    if(TTdrPPo && TTFIntC && (now - TTfUpdCNow >= TTFIntC)) {
-                        int t = gauges.getValuePercent(1);
-                        if(t >= center_gauge_empty + TTStepC) t -= TTStepC;
-                        else t = center_gauge_empty;
-                        gauges.setValuePercent(1, t);
-                        TTfUpdCNow = now;
-                        doUpd = true;
-                    }
-                    if(TTdrRoe && TTFIntR && (now - TTfUpdRNow >= TTFIntR)) {
-                        int t = gauges.getValuePercent(2);
-                        if(t >= right_gauge_empty + TTStepR) t -= TTStepR;
-                        else t = right_gauge_empty;
-                        gauges.setValuePercent(2, t);
-                        TTfUpdRNow = now;
-                        doUpd = true;
-                    }
-                    if(doUpd) {
-                        gauges.UpdateAll();
-                    }
+                    // Nothing; gauges are drained by motion engine
                     
                 } else {
 
@@ -1156,7 +1203,8 @@ void main_loop()
 
                     TTP0 = false;
                     TTP1 = true;
-                    TTstart = TTfUpdLNow = TTfUpdCNow = TTfUpdRNow = now;
+                    TTstart = now;
+                    startTTDrain();
                     setTTOUT(HIGH);
                     
                 }
@@ -1166,35 +1214,7 @@ void main_loop()
 
                 if(now - TTstart < P1_DUR) {
 
-                    bool doUpd = false;
-                    
-                    if(TTdrPri && TTFIntL && (now - TTfUpdLNow >= TTFIntL)) {
-                        int t = gauges.getValuePercent(0);
-                        if(t >= left_gauge_empty + TTStepL) t -= TTStepL;
-                        else t = left_gauge_empty;
-                        gauges.setValuePercent(0, t);
-                        TTfUpdLNow = now;
-                        doUpd = true;
-                    }
-                    if(TTdrPPo && TTFIntC && (now - TTfUpdCNow >= TTFIntC)) {
-                        int t = gauges.getValuePercent(1);
-                        if(t >= center_gauge_empty + TTStepC) t -= TTStepC;
-                        else t = center_gauge_empty;
-                        gauges.setValuePercent(1, t);
-                        TTfUpdCNow = now;
-                        doUpd = true;
-                    }
-                    if(TTdrRoe && TTFIntR && (now - TTfUpdRNow >= TTFIntR)) {
-                        int t = gauges.getValuePercent(2);
-                        if(t >= right_gauge_empty + TTStepR) t -= TTStepR;
-                        else t = right_gauge_empty;
-                        gauges.setValuePercent(2, t);
-                        TTfUpdRNow = now;
-                        doUpd = true;
-                    }
-                    if(doUpd) {
-                        gauges.UpdateAll();
-                    }
+                    // Nothing; gauges are drained by motion engine
                     
                 } else {
 
@@ -1247,8 +1267,13 @@ void main_loop()
     }
 
     // Execute remote commands from TCD or MQTT
+    // As many as possible within time budget; gating
+    // (TT, startup, refill etc) is checked per command,
+    // so a command starting a sequence ends the batch.
     if(FPBUnitIsOn) {
-        execute_remote_command();
+        unsigned long cmdNow = millis();
+        int t = CMDQ_LEN;
+        while(execute_remote_command() && --t && (millis() - cmdNow < CMD_BATCH_BUDGET)) {}
     }
 
     // Wake up on RotEnc/Remote speed changes; on GPS only if old speed was <=0
@@ -1353,7 +1378,7 @@ static void timeTravel(bool TCDtriggered, uint16_t P0Dur, uint16_t P1Dur)
         play_file("/travelstart.mp3", PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL, TT_SOUND_FACT);
     }
         
-    TTstart = TTfUpdNow = millis();
+    TTstart = millis();
     TTP0 = true;   // phase 0
     TTP1 = TTP2 = false;
 
@@ -1364,22 +1389,10 @@ static void timeTravel(bool TCDtriggered, uint16_t P0Dur, uint16_t P1Dur)
     }
     P1_maxtimeout = P1Dur + 3000;
     
-    TTStepL = TTStepC = TTStepR = 1;          // Stepping is 1
-    TTFIntL = gauges.getValuePercent(0);
-    if(TTFIntL < left_gauge_empty + (TTStepL * 2)) TTFIntL = 0;
-    else {
-        TTFIntL = P1Dur / (((TTFIntL - left_gauge_empty) / TTStepL) + 2);
-    }
-    TTFIntC = gauges.getValuePercent(1);
-    if(TTFIntC < center_gauge_empty + (TTStepC * 2)) TTFIntC = 0;
-    else {
-        TTFIntC = P1Dur / (((TTFIntC - center_gauge_empty) / TTStepC) + 2);
-    }
-    TTFIntR = gauges.getValuePercent(2);
-    if(TTFIntR < right_gauge_empty + (TTStepR * 2)) TTFIntR = 0;
-    else {
-        TTFIntR = P1Dur / (((TTFIntR - right_gauge_empty) / TTStepR) + 2);
-    }
+    // Drain durations: Reach "empty" a bit before end of P1
+    TTDurL = TTdrPri ? calcTTDrainDur(gauges.getValuePercent(0), left_gauge_empty, P1Dur) : 0;
+    TTDurC = TTdrPPo ? calcTTDrainDur(gauges.getValuePercent(1), center_gauge_empty, P1Dur) : 0;
+    TTDurR = TTdrRoe ? calcTTDrainDur(gauges.getValuePercent(2), right_gauge_empty, P1Dur) : 0;
     
     if(TCDtriggered) {    // TCD-triggered TT (GPIO, BTTFN, MQTT-pub) (synced with TCD)
         extTT = true;
@@ -1392,6 +1405,22 @@ static void timeTravel(bool TCDtriggered, uint16_t P0Dur, uint16_t P1Dur)
     }
 }
 
+static unsigned long calcTTDrainDur(int perc, int empty, unsigned long P1Dur)
+{
+    int steps = perc - empty;
+
+    if(steps < 2) return 0;
+    
+    return P1Dur * steps / (steps + 2);
+}
+
+static void startTTDrain()
+{
+    if(TTDurL) gauges.moveTo(0, left_gauge_empty, TTDurL, DGM_EASE_LINEAR);
+    if(TTDurC) gauges.moveTo(1, center_gauge_empty, TTDurC, DGM_EASE_LINEAR);
+    if(TTDurR) gauges.moveTo(2, right_gauge_empty, TTDurR, DGM_EASE_LINEAR);
+}
+
 static void prepareTT()
 {
     ssEnd();
@@ -1471,7 +1500,7 @@ void refill_plutonium()
 
     // Trigger timed needle-update
     refill = true;
-    refillNow = millis();
+    sched_start(&refillTimer, millis(), REFILL_DELAY);
 }
 
 void set_empty()
@@ -1499,18 +1528,57 @@ void set_empty()
     }
     
     startAlarm = true;
-    startAlarmNow = millis();
+    sched_start(&startAlarmTimer, millis(), ALARM_DELAY);
     
     emptyAlarm = true;  // Set this here already for checks elsewhere
     
     refill = refillWA = false;
     
     #ifdef DG_HAVEDOORSWITCH
-    dsTimer = false;
-    d2sTimer = false;
+    sched_stop(&dsTimer);
+    sched_stop(&d2sTimer);
     #endif
 }
 
+/*
+ * Timer callbacks
+ * The flags might have been cleared (ie the sequence cancelled) 
+ * since the timer was started.
+ */
+
+// Turn display on after startup delay
+static void startupDue(struct schedTimer *t, unsigned long now)
+{
+    if(!FPBUnitIsOn || !startup)
+        return;
+        
+    gauges.on();
+    if(checkGauges()) {    // Check if empty, and trigger alarm if so
+        play_file("/startup.mp3", PA_INTRMUS|PA_ALLOWSD, 1.0f);
+    }
+    startup = false;
+}
+
+// Start alarm (after delay to give gauges time to go to 0)
+static void startAlarmDue(struct schedTimer *t, unsigned long now)
+{
+    if(!FPBUnitIsOn || !startAlarm)
+        return;
+        
+    startEmptyAlarm();
+    startAlarm = false;
+}
+
+// Update gauges after refill (sound-sync'd)
+static void refillDue(struct schedTimer *t, unsigned long now)
+{
+    if(!FPBUnitIsOn || !refill)
+        return;
+        
+    gauges.UpdateAll();
+    refill = false;
+}
+
 static void setTTOUT(uint8_t stat)
 {
     if(dsTTout) {
@@ -1518,9 +1586,11 @@ static void setTTOUT(uint8_t stat)
     }
 }
 
-static void execute_remote_command()
+// Execute oldest queued command; returns false if
+// nothing was executed (queue empty, or busy)
+static bool execute_remote_command()
 {
-    uint32_t command = commandQueue[oCmdIdx];
+    uint32_t command = cmdq_peek();
     //bool pE = playingEmpty && !playingEmptyEnds;
     bool injected = false;
 
@@ -1530,12 +1600,20 @@ static void execute_remote_command()
     // No command execution during timed sequences
     // ssActive checked by individual command
 
+    #ifdef DG_DBG
+    {
+        static uint32_t lastDropped = 0;
+        if(cmdQDropped != lastDropped) {
+            Serial.printf("Command queue full, %u commands dropped\n", cmdQDropped - lastDropped);
+            lastDropped = cmdQDropped;
+        }
+    }
+    #endif
+
     if(!command || TTrunning || startup || startAlarm || refill || refillWA)
-        return;
+        return false;
 
-    commandQueue[oCmdIdx] = 0;
-    oCmdIdx++;
-    oCmdIdx &= 0x0f;
+    cmdq_pop();
 
     if(command & 0x80000000) {
         injected = true;
@@ -1546,7 +1624,7 @@ static void execute_remote_command()
         } else if(command >= 9000000 && command <= 9999999) {
             command -= 9000000;
         }
-        if(!command) return;
+        if(!command) return true;
     }
 
     if(command < 10) {                                // 900x
@@ -1738,10 +1816,18 @@ static void execute_remote_command()
             case 16:
                 {
                     int oldV = aud_state.curVolume;
-                    if(command == 15) {
-                        if(aud_state.curVolume < VOL_LEVELS - 1) aud_state.curVolume++;
-                    } else {
-                        if(aud_state.curVolume > 0) aud_state.curVolume--;
+                    // Collapse queued volume steps into one change
+                    for(;;) {
+                        if(command == 15) {
+                            if(aud_state.curVolume < VOL_LEVELS - 1) aud_state.curVolume++;
+                        } else {
+                            if(aud_state.curVolume > 0) aud_state.curVolume--;
+                        }
+                        command = cmdq_peek();
+                        if(command != 1015 && command != 1016)
+                            break;
+                        cmdq_pop();
+                        command -= 1000;
                     }
                     if(oldV != aud_state.curVolume) {
                         volWasChanged();
@@ -1795,6 +1881,8 @@ static void execute_remote_command()
         }
 
     }
+
+    return true;
 }
 
 static void say_ip_address()
@@ -1858,12 +1946,18 @@ bool switchMusicFolder(uint8_t nmf, bool isSetup)
             stopAudio();
         }
         if(haveSD) {
-            if(mp_checkForFolder(musFolderNum) == -1) {
+            int mfs = mp_checkForFolder(musFolderNum);
+            if(mfs == -1) {
                 if(!isSetup) flushDelayedSave();
                 showWaitSequence();
                 waitShown = true;
                 play_file("/renaming.mp3", PA_INTRMUS|PA_ALLOWSD);
                 waitAudioDone();
+            } else if(mfs == 1 && !mp_checkLibIndex(musFolderNum)) {
+                // Building the library index takes a while, too
+                if(!isSetup) flushDelayedSave();
+                showWaitSequence();
+                waitShown = true;
             }
         }
         if(!isSetup) {
@@ -1969,7 +2063,33 @@ static void sideSwitchLongPressStop()
 }
 
 #ifdef DG_HAVEDOORSWITCH
-static void play_door_snd(int doorNum, bool isOpen)
+static void dsLatRecord(uint16_t *hist, unsigned long lat)
+{
+    int i = 0;
+    
+    // Bucket i: < 2^(i+1) ms; last bucket: everything above
+    while(i < DS_LAT_BUCKETS - 1 && lat >= (2UL << i)) i++;
+    if(hist[i] < 0xffff) hist[i]++;
+}
+
+void getDoorLatStats(struct dsLatStats *st)
+{
+    *st = dsLat;
+}
+
+static void doorSoundDue(struct schedTimer *t, unsigned long now)
+{
+    // delay door sound by max 500ms, otherwise effect is lost and we skip it
+    if(now - t->due <= 500) {
+        if(play_door_snd(t->id, *(bool *)t->arg)) {
+            dsLatRecord(dsLat.snd, millis() - t->due);
+        }
+    } else {
+        dsLat.late++;
+    }
+}
+
+static bool play_door_snd(int doorNum, bool isOpen)
 {
     // Sounds for same door may interrupt themselves; if sound for
     // other door is to be played while first door's is running, we 
@@ -1981,44 +2101,126 @@ static void play_door_snd(int doorNum, bool isOpen)
             play_file(isOpen ? "/dooropen.mp3" : "/doorclose.mp3", PA_ALLOWSD|PA_DOOR, 1.0f);
             lastDoorSoundNow = now;
             lastDoorNum = doorNum;
+            return true;
         }
     }
+    return false;
 }
 
-static void dsScan()
+static void dsHandleDoor(int doorNum, bool isPressed, unsigned long changeNow, bool *isOpen, struct schedTimer *timer)
 {
-    // Use this after init
-    if(dsPlay) doorSwitch_scan();
+    unsigned long now = millis();
+    
+    *isOpen = (isPressed != dsCloseOnClose);
+    
+    if(!dsPlayO || doorTCDFPO) {
+        unsigned long del = *isOpen ? dsDelay : dsDelayC;
+        if(bttfn_send_door(*isOpen, doorNum, del)) {
+            dsLatRecord(dsLat.pkt, millis() - changeNow);
+        } else if(!refillWA) {
+            unsigned long timePassed = now - changeNow;
+            if(del && (del > timePassed + 100)) {
+                sched_start(timer, changeNow, del);
+            } else if(timePassed < 500) {
+                if(play_door_snd(doorNum, *isOpen)) {
+                    dsLatRecord(dsLat.snd, millis() - changeNow);
+                }
+            } else {
+                dsLat.late++;
+            }
+        }
+    }
 }
-static void doorSwitch_scan()
+
+static void dsHandle()
 {
-    // Don't use after init
-    doorSwitch.scan();
-    if(!dsTTout) door2Switch.scan();
+    if(isDSwitchChange) {
+        dsHandleDoor(1, isDSwitchPressed, isDSwitchChangeNow, &dsOpen, &dsTimer);
+        isDSwitchChange = false;
+    }
+    
+    if(isD2SwitchChange) {
+        dsHandleDoor(2, isD2SwitchPressed, isD2SwitchChangeNow, &d2sOpen, &d2sTimer);
+        isD2SwitchChange = false;
+    }
 }
-static void doorSwitchLongPress()
+
+static void dsScan()
 {
-    isDSwitchPressed = true;
-    isDSwitchChange = true;
-    isDSwitchChangeNow = millis();
+    // Use this after init
+    doorSwitch_scan(dsPlay);
 }
-static void doorSwitchLongPressStop()
+
+// Take events from queue; handle each one immediately
+// so that quick open/close sequences are not merged.
+static void doorSwitch_scan(bool handle)
 {
-    isDSwitchPressed = false;
-    isDSwitchChange = true;
-    isDSwitchChangeNow = millis();
+    uint8_t tail = dsEvTail;
+    uint8_t head = __atomic_load_n(&dsEvHead, __ATOMIC_ACQUIRE);
+
+    while(tail != head) {
+        struct dsEvent *e = &dsEvQ[tail];
+        if(e->door == 1) {
+            isDSwitchPressed = e->active;
+            isDSwitchChange = true;
+            isDSwitchChangeNow = e->time;
+        } else {
+            isD2SwitchPressed = e->active;
+            isD2SwitchChange = true;
+            isD2SwitchChangeNow = e->time;
+        }
+        tail = (tail + 1) & (DS_EVQ_LEN - 1);
+        __atomic_store_n(&dsEvTail, tail, __ATOMIC_RELEASE);
+        if(handle) dsHandle();
+    }
+
+    // Queue overflow: Resync with debounced levels
+    if(dsEvOverflow) {
+        dsEvOverflow = false;
+        if(doorSwitch.isActive() != isDSwitchPressed) {
+            isDSwitchPressed = !isDSwitchPressed;
+            isDSwitchChange = true;
+            isDSwitchChangeNow = millis();
+        }
+        if(!dsTTout && door2Switch.isActive() != isD2SwitchPressed) {
+            isD2SwitchPressed = !isD2SwitchPressed;
+            isD2SwitchChange = true;
+            isD2SwitchChangeNow = millis();
+        }
+        if(handle) dsHandle();
+    }
+
+    if(!handle) {
+        isDSwitchChange = isD2SwitchChange = false;
+    }
 }
-static void door2SwitchLongPress()
+
+// Discard queued events, take current levels
+static void doorSwitch_sync()
 {
-    isD2SwitchPressed = true;
-    isD2SwitchChange = true;
-    isD2SwitchChangeNow = millis();
+    __atomic_store_n(&dsEvTail, __atomic_load_n(&dsEvHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    dsEvOverflow = false;
+    isDSwitchPressed = doorSwitch.isActive();
+    isD2SwitchPressed = dsTTout ? false : door2Switch.isActive();
+    isDSwitchChange = isD2SwitchChange = false;
 }
-static void door2SwitchLongPressStop()
+
+// Change hook (tick job): Queue debounced door switch change
+static void doorSwitchChange(bool active, unsigned long edgeTime, void *arg)
 {
-    isD2SwitchPressed = false;
-    isD2SwitchChange = true;
-    isD2SwitchChangeNow = millis();
+    uint8_t head = dsEvHead;
+    uint8_t next = (head + 1) & (DS_EVQ_LEN - 1);
+
+    if(next == __atomic_load_n(&dsEvTail, __ATOMIC_ACQUIRE)) {
+        dsEvOverflow = true;
+        dsLat.dropped++;
+        return;
+    }
+
+    dsEvQ[head].time = edgeTime;
+    dsEvQ[head].door = (uint8_t)(intptr_t)arg;
+    dsEvQ[head].active = active;
+    __atomic_store_n(&dsEvHead, next, __ATOMIC_RELEASE);
 }
 #endif
 
@@ -2234,7 +2436,7 @@ static uint8_t restrict_gauge_empty(int val, int minimum, int maximum, uint8_t d
  * Basic Telematics Transmission Framework (BTTFN)
  */
 
-static bool check_packet(uint8_t *buf)
+static bool check_packet(const uint8_t *buf)
 {
     // Basic validity check
     if(memcmp(buf, BTTFUDPHD, 4))
@@ -2248,39 +2450,103 @@ static bool check_packet(uint8_t *buf)
     return (buf[BTTF_PACKET_SIZE - 1] == a);
 }
 
+// Validate and classify a received packet; on success,
+// the packet can be evaluated through the returned view
+static const union bttfnPacket *bttfn_parse(const uint8_t *buf, int len, int *kind)
+{
+    const union bttfnPacket *p = (const union bttfnPacket *)buf;
+    
+    *kind = BTTFN_PKT_INVALID;
+
+    if(len < BTTF_PACKET_SIZE || !check_packet(buf))
+        return NULL;
+
+    if((p->rsp.ver & 0x4f) == (BTTFN_VERSION | 0x40)) {
+        *kind = BTTFN_PKT_NOT;
+    } else if((p->rsp.ver & 0x8f) == (BTTFN_VERSION | 0x80)) {
+        *kind = BTTFN_PKT_RSP;
+    } else {
+        return NULL;
+    }
+
+    return p;
+}
+
 void addCmdQueue(uint32_t command)
 {
+    struct cmdSlot *slot;
+    uint32_t pos, lap;
+    int32_t d;
+    
     if(!command) return;
 
-    commandQueue[iCmdIdx] = command;
-    iCmdIdx++;
-    iCmdIdx &= 0x0f;
+    pos = __atomic_load_n(&cmdQTail, __ATOMIC_RELAXED);
+    
+    for(;;) {
+        slot = &cmdQ[pos & (CMDQ_LEN - 1)];
+        lap = pos & ~(CMDQ_LEN - 1);
+        d = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - lap);
+        if(!d) {
+            // Slot free: Claim it (on failure, pos is reloaded)
+            if(__atomic_compare_exchange_n(&cmdQTail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if(d < 0) {
+            // Slot not yet consumed: Queue full, drop command
+            __atomic_add_fetch(&cmdQDropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            // Slot claimed by another producer
+            pos = __atomic_load_n(&cmdQTail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->cmd = command;
+    __atomic_store_n(&slot->seq, lap + 1, __ATOMIC_RELEASE);
+}
+
+// Returns oldest command, or 0 if queue is empty
+static uint32_t cmdq_peek()
+{
+    struct cmdSlot *slot = &cmdQ[cmdQHead & (CMDQ_LEN - 1)];
+
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (cmdQHead & ~(CMDQ_LEN - 1)) + 1)
+        return 0;
+
+    return slot->cmd;
+}
+
+static void cmdq_pop()
+{
+    struct cmdSlot *slot = &cmdQ[cmdQHead & (CMDQ_LEN - 1)];
+
+    __atomic_store_n(&slot->seq, (cmdQHead & ~(CMDQ_LEN - 1)) + CMDQ_LEN, __ATOMIC_RELEASE);
+    cmdQHead++;
 }
 
-static void bttfn_eval_response(uint8_t *buf, bool checkCaps)
+static void bttfn_eval_response(const struct bttfnRsp *rsp, bool checkCaps)
 {
-    if(checkCaps && (buf[5] & 0x40)) {
+    if(checkCaps && (rsp->flags & 0x40)) {
         bttfnReqStatus &= ~0x40;     // Do no longer poll capabilities
-        if(buf[31] & 0x01) {
+        if(rsp->caps & 0x01) {
             bttfnReqStatus &= ~0x02; // Do no longer poll speed, comes over multicast
         }
-        if(buf[31] & 0x10) {
+        if(rsp->caps & 0x10) {
             TCDSupportsNOTData = true;
-            TCDSupportsSSID = !!(buf[31] & 0x40);
+            TCDSupportsSSID = !!(rsp->caps & 0x40);
         }
-        TCDSupportsCMDDOOR = !!(buf[31] & 0x20);
+        TCDSupportsCMDDOOR = !!(rsp->caps & 0x20);
     }
     
-    if(buf[5] & 0x02) {
-        gpsSpeed = (int16_t)(buf[18] | (buf[19] << 8));
+    if(rsp->flags & 0x02) {
+        gpsSpeed = rsp->speed;
         if(gpsSpeed > 88) gpsSpeed = 88;
-        spdIsRotEnc = !!(buf[26] & (0x80|0x20));    // Speed is from RotEnc or Remote
+        spdIsRotEnc = !!(rsp->status & (0x80|0x20));    // Speed is from RotEnc or Remote
     }
 
-    if(buf[5] & 0x10) {
-        tcdNM  = !!(buf[26] & 0x01);
-        tcdFPO = doorTCDFPO = !!(buf[26] & 0x02);   // 1 means fake power off
-        tcdIsBusy = !!(buf[26] & 0x10);
+    if(rsp->flags & 0x10) {
+        tcdNM  = !!(rsp->status & 0x01);
+        tcdFPO = doorTCDFPO = !!(rsp->status & 0x02);   // 1 means fake power off
+        tcdIsBusy = !!(rsp->status & 0x10);
     } else {
         tcdNM = false;
         tcdFPO = false;
@@ -2289,13 +2555,28 @@ static void bttfn_eval_response(uint8_t *buf, bool checkCaps)
 
     if(!bttfnHaveTCDSSID && !checkCaps && TCDSupportsSSID) {
         bttfnHaveTCDSSID = 1;
-        memcpy((void *)TCDSSID, (void *)&buf[41], 6);
-        TCDSSID[6] = buf[18];
-        TCDpwMarker = buf[19] & 0x01;
+        memcpy((void *)TCDSSID, (const void *)rsp->ssid, 6);
+        TCDSSID[6] = rsp->ssid7;
+        TCDpwMarker = rsp->pwMark & 0x01;
     }
 }
 
-static void handle_tcd_notification(uint8_t *buf)
+// Sequence check: Accept newer packets and restarts (1). Drop
+// duplicates and late (reordered) ones without moving our counter
+// back. If a packet is far older, the TCD has restarted: Resync.
+static bool bttfn_seq_ok(uint32_t *last, uint32_t seq)
+{
+    int32_t d = (int32_t)(seq - *last);
+
+    if(d > 0 || seq == 1 || d < -BTTFN_SEQ_WINDOW) {
+        *last = seq;
+        return true;
+    }
+
+    return false;
+}
+
+static void handle_tcd_notification(const union bttfnPacket *p)
 {
     uint32_t seqCnt;
 
@@ -2305,38 +2586,37 @@ static void handle_tcd_notification(uint8_t *buf)
     // Do not stuff that messes with display, input,
     // etc.
 
-    if(buf[5] & BTTFN_NOT_DATA) {
+    if(p->ntf.type & BTTFN_NOT_DATA) {
         if(TCDSupportsNOTData) {
             bttfnDataNotEnabled = true;
             bttfnLastNotData = millis();
-            seqCnt = GET32(buf, 27);
+            seqCnt = p->rsp.session;
             if(bttfnSessionID && (bttfnSessionID != seqCnt)) {
                 lastBTTFNKA = bttfnLastNotData - BTTFN_KA_INTERVAL + (BTTFN_KA_OFFSET*1000);
                 bttfnTCDDataSeqCnt = 1;
                 bttfnHaveTCDSSID = 0;
             }
             bttfnSessionID = seqCnt;
-            seqCnt = GET32(buf, 6);
-            if(seqCnt > bttfnTCDDataSeqCnt || seqCnt == 1) {
+            seqCnt = p->rsp.id;
+            if(bttfn_seq_ok(&bttfnTCDDataSeqCnt, seqCnt)) {
                 #ifdef DG_DBG_NET
                 Serial.println("Valid NOT_DATA packet received");
                 #endif
-                bttfn_eval_response(buf, false);
+                bttfn_eval_response(&p->rsp, false);
             } else {
                 #ifdef DG_DBG_NET
                 Serial.printf("Out-of-sequence NOT_DATA packet received %d %d\n", seqCnt, bttfnTCDDataSeqCnt);
                 #endif
             }
-            bttfnTCDDataSeqCnt = seqCnt;
         }
         return;
     }
     
-    switch(buf[5]) {
+    switch(p->ntf.type) {
     case BTTFN_NOT_SPD:
-        seqCnt = GET32(buf, 12);
-        if(seqCnt > bttfnTCDSeqCnt || seqCnt == 1) {
-            switch(buf[8] | (buf[9] << 8)) {
+        seqCnt = p->ntf.seq;
+        if(bttfn_seq_ok(&bttfnTCDSeqCnt, seqCnt)) {
+            switch(p->ntf.p1) {
             case BTTFN_SSRC_GPS:
                 spdIsRotEnc = false;
                 break;
@@ -2350,14 +2630,13 @@ static void handle_tcd_notification(uint8_t *buf)
             default:
                 spdIsRotEnc = true;
             }
-            gpsSpeed = (int16_t)(buf[6] | (buf[7] << 8));
+            gpsSpeed = (int16_t)p->ntf.p0;
             if(gpsSpeed > 88) gpsSpeed = 88;
         } else {
             #ifdef DG_DBG_NET
             Serial.printf("Out-of-sequence packet received from TCD %d %d\n", seqCnt, bttfnTCDSeqCnt);
             #endif
         }
-        bttfnTCDSeqCnt = seqCnt;
         break;
     case BTTFN_NOT_PREPARE:
         // Prepare for TT. Comes at some undefined point,
@@ -2367,6 +2646,8 @@ static void handle_tcd_notification(uint8_t *buf)
         // We don't ignore this if TCD is connected by wire,
         // because this signal does not come via wire.
         doPrepareTT = true;
+        // Poll faster for a while
+        BTTFNFastPollNow = millisNonZero();
         break;
     case BTTFN_NOT_TT:
         // Trigger Time Travel (if not running already)
@@ -2376,8 +2657,13 @@ static void handle_tcd_notification(uint8_t *buf)
             networkTCDTT = true;
             networkReentry = false;
             networkAbort = false;
-            networkLead = buf[6] | (buf[7] << 8);
-            networkP1 = buf[8] | (buf[9] << 8);
+            networkLead = p->ntf.p0;
+            networkP1 = p->ntf.p1;
+            // Subtract time packet spent in queue
+            {
+                unsigned long late = millis() - bttfnPktTime;
+                networkLead = (late < networkLead) ? networkLead - late : 0;
+            }
         }
         break;
     case BTTFN_NOT_REENTRY:
@@ -2404,7 +2690,7 @@ static void handle_tcd_notification(uint8_t *buf)
         break;
     case BTTFN_NOT_PCG_CMD:
         if(!dgBusy) {
-            addCmdQueue(GET32(buf, 6));
+            addCmdQueue(p->ntf.cmd);
         }
         break;
     case BTTFN_NOT_WAKEUP:
@@ -2412,8 +2698,8 @@ static void handle_tcd_notification(uint8_t *buf)
         break;
     case BTTFN_NOT_INFO:
         {
-            uint16_t tcdi1 = buf[6] | (buf[7] << 8);
-            uint16_t tcdi2 = buf[8] | (buf[9] << 8);
+            uint16_t tcdi1 = p->ntf.p0;
+            uint16_t tcdi2 = p->ntf.p1;
             if(tcdi1 & BTTFN_TCDI1_EXT) {
                 tcdNM  = !!(tcdi1 & BTTFN_TCDI1_NM);
                 tcdFPO = !!(tcdi1 & BTTFN_TCDI1_OFF);
@@ -2424,99 +2710,209 @@ static void handle_tcd_notification(uint8_t *buf)
     }
 }
 
+// Receive one packet from socket into queue (receive task,
+// or main loop if we have no task). Returns false if no packet
+// was pending.
+static bool bttfn_rx(int sock, struct bttfnRxQueue *q)
+{
+    static uint8_t dummy[BTTF_PACKET_SIZE];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    uint8_t head = q->head;
+    uint8_t next = (head + 1) & (BTTFN_RXQ_LEN - 1);
+    bool full = (next == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE));
+    struct bttfnRxPkt *pkt = &q->pkt[head];
+    uint8_t *buf = full ? dummy : pkt->buf;
+    int len;
+
+    // Read even if queue is full to clear the socket
+    len = recvfrom(sock, buf, BTTF_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen);
+    if(len < 0)
+        return false;
+
+    if(full) {
+        __atomic_add_fetch(&q->dropped, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    
+    pkt->time = millis();
+
+    // Drop invalid packets right here
+    if(!bttfn_parse(buf, len, &pkt->kind))
+        return true;
+
+    pkt->srcIP = from.sin_addr.s_addr;
+    __atomic_store_n(&q->head, next, __ATOMIC_RELEASE);
+    
+    return true;
+}
+
+static void bttfn_rxTask(void *arg)
+{
+    fd_set rfds;
+    struct timeval tv;
+    int maxfd = ((bttfnSock > bttfnMcSock) ? bttfnSock : bttfnMcSock) + 1;
+
+    for(;;) {
+        FD_ZERO(&rfds);
+        FD_SET(bttfnSock, &rfds);
+        if(bttfnMcSock >= 0) FD_SET(bttfnMcSock, &rfds);
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        
+        int r = select(maxfd, &rfds, NULL, NULL, &tv);
+        if(r < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        if(!r)
+            continue;
+        
+        if(FD_ISSET(bttfnSock, &rfds)) {
+            while(bttfn_rx(bttfnSock, &bttfnRxQ)) {}
+        }
+        if(bttfnMcSock >= 0 && FD_ISSET(bttfnMcSock, &rfds)) {
+            while(bttfn_rx(bttfnMcSock, &bttfnMcRxQ)) {}
+        }
+    }
+}
+
+static struct bttfnRxPkt *bttfn_rx_peek(int sock, struct bttfnRxQueue *q)
+{
+    uint8_t tail = q->tail;
+    
+    if(sock < 0)
+        return NULL;
+
+    // No receive task: Poll socket
+    if(!bttfnRxTask) {
+        while(tail == q->head && bttfn_rx(sock, q)) {}
+    }
+    
+    if(tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &q->pkt[tail];
+}
+
+static void bttfn_rx_pop(struct bttfnRxQueue *q)
+{
+    __atomic_store_n(&q->tail, (q->tail + 1) & (BTTFN_RXQ_LEN - 1), __ATOMIC_RELEASE);
+}
+
 // Check for pending MC packet and parse it
 static bool bttfn_checkmc()
 {
-    int psize = dgMcUDP->parsePacket();
+    struct bttfnRxPkt *rx = bttfn_rx_peek(bttfnMcSock, &bttfnMcRxQ);
 
-    if(!psize)
+    if(!rx)
         return false;
 
     // This returns true as long as a packet was received
-    // regardless whether it was for us or not. Point is
-    // to clear the receive buffer.
-    
-    dgMcUDP->read(BTTFMCBuf, BTTF_PACKET_SIZE);
+    // regardless whether it was for us or not.
 
     #ifdef DG_DBG_NET
-    Serial.printf("Received multicast packet from %s\n", dgMcUDP->remoteIP().toString());
+    Serial.printf("Received multicast packet from %s\n", IPAddress(rx->srcIP).toString());
     #endif
 
-    if(haveTCDIP) {
-        if(bttfnTcdIP != dgMcUDP->remoteIP())
-            return true;
-    } else {
-        // Do not use tcdHostNameHash; let DISCOVER do its work
-        // and wait for a result.
-        return true;
+    // Without TCD IP: Do not use tcdHostNameHash; let 
+    // DISCOVER do its work and wait for a result.
+    if(haveTCDIP && ((uint32_t)bttfnTcdIP == rx->srcIP)) {
+
+        if(rx->kind == BTTFN_PKT_NOT) {
+            
+            // A notification from the TCD
+            bttfnPktTime = rx->time;
+            handle_tcd_notification((const union bttfnPacket *)rx->buf);
+            
+        }
     }
 
-    if(!check_packet(BTTFMCBuf))
-        return true;
+    bttfn_rx_pop(&bttfnMcRxQ);
+
+    return true;
+}
 
-    if((BTTFMCBuf[4] & 0x4f) == (BTTFN_VERSION | 0x40)) {
+// Track RTT (smoothed, and its variation), derive timeout
+static void bttfn_rtt_update(long rtt)
+{
+    long err;
 
-        // A notification from the TCD
-        handle_tcd_notification(BTTFMCBuf);
+    // Packet might be timestamped before we took send time
+    if(rtt < 0) rtt = 0;
     
+    if(!BTTFNHaveRTT) {
+        BTTFNsRTT = rtt << 3;
+        BTTFNRTTVar = rtt << 1;
+        BTTFNHaveRTT = true;
+    } else {
+        err = rtt - (long)(BTTFNsRTT >> 3);
+        BTTFNsRTT += err;
+        if(err < 0) err = -err;
+        BTTFNRTTVar += err - (BTTFNRTTVar >> 2);
     }
 
-    return true;
+    BTTFNRespTO = (BTTFNsRTT >> 3) + BTTFNRTTVar;
+    if(BTTFNRespTO < BTTFN_RESPONSE_TO_MIN) BTTFNRespTO = BTTFN_RESPONSE_TO_MIN;
+    else if(BTTFNRespTO > BTTFN_RESPONSE_TO) BTTFNRespTO = BTTFN_RESPONSE_TO;
 }
 
-// Check for pending packet and parse it
-static void BTTFNCheckPacket()
+// Double poll interval (up to max), with +/- 25% jitter
+// so that multiple props don't poll in lockstep
+static void bttfn_backoff()
 {
-    unsigned long mymillis = millisNonZero();
+    unsigned long pi = BTTFN_POLL_INT;
+    int i = BTTFNfailCount - BTTFN_RETRIES;
+
+    while(i-- > 0 && pi < BTTFN_POLL_INT_MAX) pi <<= 1;
+    if(pi > BTTFN_POLL_INT_MAX) pi = BTTFN_POLL_INT_MAX;
+
+    BTTFNPollInt = pi - (pi / 4) + (esp_random() % (pi / 2));
     
-    int psize = dgUDP->parsePacket();
-    if(!psize) {
-        if(!bttfnDataNotEnabled && BTTFNPacketDue) {
-            if((mymillis - BTTFNTSRQAge) > BTTFN_RESPONSE_TO) {
-                // Packet timed out
-                BTTFNPacketDue = false;
-                // Immediately trigger new request for
-                // the first 10 timeouts, after that
-                // the new request is only triggered
-                // in greater intervals via bttfn_loop().
-                if(haveTCDIP && BTTFNfailCount < 10) {
-                    BTTFNfailCount++;
-                    BTTFNUpdateNow = 0;
-                }
-            }
+    // No fast polling while TCD doesn't respond
+    BTTFNFastPollNow = 0;
+}
+
+static unsigned long bttfn_poll_int()
+{
+    if(BTTFNFastPollNow) {
+        if(millis() - BTTFNFastPollNow < BTTFN_POLL_FAST_DUR) {
+            return BTTFN_POLL_INT_FAST;
         }
-        return;
+        BTTFNFastPollNow = 0;
     }
-    
-    dgUDP->read(BTTFUDPBuf, BTTF_PACKET_SIZE);
+    return BTTFNPollInt;
+}
 
-    if(!check_packet(BTTFUDPBuf))
-        return;
+// Evaluate received unicast packet
+static void BTTFNHandlePacket(const struct bttfnRxPkt *rx, unsigned long mymillis)
+{
+    const union bttfnPacket *p = (const union bttfnPacket *)rx->buf;
 
-    if((BTTFUDPBuf[4] & 0x4f) == (BTTFN_VERSION | 0x40)) {
+    if(rx->kind == BTTFN_PKT_NOT) {
 
         // A notification from the TCD
-        handle_tcd_notification(BTTFUDPBuf);
+        bttfnPktTime = rx->time;
+        handle_tcd_notification(p);
 
     } else {
 
         // (Possibly) a response packet
     
-        if(GET32(BTTFUDPBuf, 6) != BTTFUDPID)
-            return;
-    
-        // Response marker missing or wrong version, bail
-        if((BTTFUDPBuf[4] & 0x8f) != (BTTFN_VERSION | 0x80))
+        if(p->rsp.id != BTTFUDPID)
             return;
 
+        bttfn_rtt_update((long)(rx->time - BTTFNTSRQAge));
+
         BTTFNfailCount = 0;
+        BTTFNPollInt = BTTFN_POLL_INT;
     
         // If it's our expected packet, no other is due for now
         BTTFNPacketDue = false;
 
-        if(BTTFUDPBuf[5] & 0x80) {
+        if(p->rsp.flags & 0x80) {
             if(!haveTCDIP) {
-                bttfnTcdIP = dgUDP->remoteIP();
+                bttfnTcdIP = rx->srcIP;
                 haveTCDIP = true;
                 #ifdef DG_DBG_NET
                 Serial.printf("Discovered TCD IP %d.%d.%d.%d\n", bttfnTcdIP[0], bttfnTcdIP[1], bttfnTcdIP[2], bttfnTcdIP[3]);
@@ -2532,7 +2928,56 @@ static void BTTFNCheckPacket()
         // baseline for KEEP_ALIVE (lastBTTFNKA)
         lastBTTFNpacket = lastBTTFNKA = mymillis;
 
-        bttfn_eval_response(BTTFUDPBuf, true);
+        bttfn_eval_response(&p->rsp, true);
+    }
+}
+
+// Check for pending packet and parse it
+// Returns true if a packet was read, regardless of
+// whether it was for us.
+static bool BTTFNReadPacket(unsigned long mymillis)
+{
+    struct bttfnRxPkt *rx = bttfn_rx_peek(bttfnSock, &bttfnRxQ);
+
+    if(!rx)
+        return false;
+
+    BTTFNHandlePacket(rx, mymillis);
+
+    bttfn_rx_pop(&bttfnRxQ);
+
+    return true;
+}
+
+// Read all pending packets (within limits), so that bursts
+// of notifications are not stretched over several loops
+static void BTTFNCheckPacket()
+{
+    unsigned long mymillis = millisNonZero();
+    int t = BTTFN_DRAIN_MAX;
+
+    if(BTTFNReadPacket(mymillis)) {
+        while(--t && (millis() - mymillis < BTTFN_DRAIN_BUDGET)) {
+            if(!BTTFNReadPacket(mymillis))
+                break;
+        }
+        return;
+    }
+    
+    if(!bttfnDataNotEnabled && BTTFNPacketDue) {
+        if((mymillis - BTTFNTSRQAge) > BTTFNRespTO) {
+            // Packet timed out
+            BTTFNPacketDue = false;
+            if(BTTFNfailCount < 255) BTTFNfailCount++;
+            if(BTTFNfailCount <= BTTFN_RETRIES) {
+                // Immediately trigger new request for
+                // the first few timeouts
+                if(haveTCDIP) BTTFNUpdateNow = 0;
+            } else {
+                // After that, back off
+                bttfn_backoff();
+            }
+        }
     }
 }
 
@@ -2567,16 +3012,22 @@ static void BTTFNDispatch()
     }
     BTTFUDPBuf[BTTF_PACKET_SIZE - 1] = a;
 
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+
     if(haveTCDIP) {
-        dgUDP->beginPacket(bttfnTcdIP, BTTF_DEFAULT_LOCAL_PORT);
+        to.sin_addr.s_addr = (uint32_t)bttfnTcdIP;
+        to.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT);
     } else {
         #ifdef DG_DBG_NET
         Serial.printf("Sending multicast (hostname hash %x)\n", tcdHostNameHash);
         #endif
-        dgUDP->beginPacket(bttfnMcIP, BTTF_DEFAULT_LOCAL_PORT + 1);
+        to.sin_addr.s_addr = (uint32_t)bttfnMcIP;
+        to.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT + 1);
     }
-    dgUDP->write(BTTFUDPBuf, BTTF_PACKET_SIZE);
-    dgUDP->endPacket();
+    
+    sendto(bttfnSock, BTTFUDPBuf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&to, sizeof(to));
 }
 
 // Send a new data request
@@ -2702,6 +3153,42 @@ static bool bttfn_send_door(bool doorOpen, int doorNum, unsigned long del)
 }
 #endif
 
+static int bttfn_socket(uint16_t port, bool mc)
+{
+    struct sockaddr_in addr;
+    int yes = 1;
+    int sock;
+
+    if((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+        return -1;
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    
+    if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    if(mc) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = (uint32_t)bttfnMcIP;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if(setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            close(sock);
+            return -1;
+        }
+    }
+
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+
+    return sock;
+}
+
 static void bttfn_setup()
 {
     useBTTFN = false;
@@ -2720,15 +3207,29 @@ static void bttfn_setup()
         bttfnTcdIP.fromString(settings.tcdIP);
     }
     
-    dgUDP = &bttfUDP;
-    dgUDP->begin(BTTF_DEFAULT_LOCAL_PORT);
+    if((bttfnSock = bttfn_socket(BTTF_DEFAULT_LOCAL_PORT, false)) < 0) {
+        #ifdef DG_DBG_NET
+        Serial.println("Failed to create BTTFN socket");
+        #endif
+        return;
+    }
+    bttfnMcSock = bttfn_socket(BTTF_DEFAULT_LOCAL_PORT + 2, true);
 
-    dgMcUDP = &bttfMcUDP;
-    dgMcUDP->beginMulticast(bttfnMcIP, BTTF_DEFAULT_LOCAL_PORT + 2);
+    // Receive in separate task; if this fails,
+    // sockets are polled from main loop.
+    if(xTaskCreatePinnedToCore(bttfn_rxTask, "bttfnRx", 3072, NULL, 
+                               uxTaskPriorityGet(NULL) + BTTFN_RX_PRIO, &bttfnRxTask, 
+                               xPortGetCoreID() ^ 1) != pdPASS) {
+        bttfnRxTask = NULL;
+        #ifdef DG_DBG_NET
+        Serial.println("Failed to create BTTFN receive task");
+        #endif
+    }
     
     BTTFNPreparePacketTemplate();
     
     BTTFNfailCount = 0;
+    BTTFNPollInt = BTTFN_POLL_INT;
     useBTTFN = true;
 }
 
@@ -2771,10 +3272,13 @@ void bttfn_loop()
         }
     } else if(!BTTFNPacketDue) {
         // If WiFi status changed, trigger immediately
+        // and start over with normal interval
         if(!BTTFNWiFiUp && (WiFi.status() == WL_CONNECTED)) {
             BTTFNUpdateNow = 0;
+            BTTFNfailCount = 0;
+            BTTFNPollInt = BTTFN_POLL_INT;
         }
-        if((!BTTFNUpdateNow) || (millis() - BTTFNUpdateNow > BTTFN_POLL_INT)) {
+        if((!BTTFNUpdateNow) || (millis() - BTTFNUpdateNow > bttfn_poll_int())) {
             BTTFNSendRequest();
         }
     }
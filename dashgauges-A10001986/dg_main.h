@@ -83,6 +83,17 @@ void showMPRPrecDone(unsigned int perc);
 
 void addCmdQueue(uint32_t command);
 
+#ifdef DG_HAVEDOORSWITCH
+#define DS_LAT_BUCKETS 10
+struct dsLatStats {
+    uint16_t snd[DS_LAT_BUCKETS];   // Switch edge to door sound; bucket i: < 2^(i+1) ms
+    uint16_t pkt[DS_LAT_BUCKETS];   // Switch edge to BTTFN door command
+    uint16_t late;                  // Sounds skipped for being late
+    uint16_t dropped;               // Events lost (queue full)
+};
+void getDoorLatStats(struct dsLatStats *st);
+#endif
+
 void bttfn_loop();
 
 extern unsigned long powerupMillis;
@@ -0,0 +1,275 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Timer scheduler
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ * 
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "dg_global.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "dg_sched.h"
+
+static struct schedTimer *heap[SCHED_MAX_TIMERS];
+static int heapSize = 0;
+
+// "a is due before b", wraparound-safe. millis() is 32 bits wide,
+// so the difference is taken in 32 bits, even where long is wider.
+#define SCHED_DIFF(a, b)   ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+#define SCHED_BEFORE(a, b) (SCHED_DIFF((a)->due, (b)->due) < 0)
+
+static void heap_set(int i, struct schedTimer *t)
+{
+    heap[i] = t;
+    t->hidx = i;
+}
+
+static void heap_up(int i)
+{
+    struct schedTimer *t = heap[i];
+
+    while(i > 0) {
+        int p = (i - 1) >> 1;
+        if(!SCHED_BEFORE(t, heap[p]))
+            break;
+        heap_set(i, heap[p]);
+        i = p;
+    }
+    heap_set(i, t);
+}
+
+static void heap_down(int i)
+{
+    struct schedTimer *t = heap[i];
+
+    for(;;) {
+        int c = (i << 1) + 1;
+        if(c >= heapSize)
+            break;
+        if(c + 1 < heapSize && SCHED_BEFORE(heap[c + 1], heap[c]))
+            c++;
+        if(!SCHED_BEFORE(heap[c], t))
+            break;
+        heap_set(i, heap[c]);
+        i = c;
+    }
+    heap_set(i, t);
+}
+
+static void heap_remove(int i)
+{
+    heap[i]->hidx = -1;
+    if(i != --heapSize) {
+        heap_set(i, heap[heapSize]);
+        heap_down(i);
+        heap_up(i);
+    }
+}
+
+void sched_init(struct schedTimer *t, schedCB cb, void *arg, int id)
+{
+    t->due = 0;
+    t->cb = cb;
+    t->arg = arg;
+    t->id = id;
+    t->hidx = -1;
+}
+
+/*
+ * (Re)arm a timer to expire "delay" ms after "start".
+ * "start" may lie in the past.
+ */
+bool sched_start(struct schedTimer *t, unsigned long start, unsigned long delay)
+{
+    if(t->hidx >= 0) {
+        heap_remove(t->hidx);
+    } else if(heapSize >= SCHED_MAX_TIMERS) {
+        #ifdef DG_DBG
+        Serial.println("sched_start: Too many timers");
+        #endif
+        return false;
+    }
+    
+    t->due = start + delay;
+    heap_set(heapSize++, t);
+    heap_up(heapSize - 1);
+
+    return true;
+}
+
+void sched_stop(struct schedTimer *t)
+{
+    if(t->hidx >= 0) {
+        heap_remove(t->hidx);
+    }
+}
+
+bool sched_armed(const struct schedTimer *t)
+{
+    return (t->hidx >= 0);
+}
+
+/*
+ * Run callbacks of all expired timers. A timer is disarmed 
+ * before its callback is called, so the callback may re-arm it.
+ */
+void sched_run(unsigned long now)
+{
+    while(heapSize && SCHED_DIFF(now, heap[0]->due) >= 0) {
+        struct schedTimer *t = heap[0];
+        heap_remove(0);
+        t->cb(t, now);
+    }
+}
+
+/*
+ * Tick service
+ */
+
+typedef struct {
+    tickJobFunc fn;
+    void        *arg;
+    uint16_t    period;
+    uint16_t    cnt;
+} TickJob;
+
+static TickJob            tickJobs[TICK_MAX_JOBS];
+static volatile int       tickNumJobs = 0;
+static volatile uint16_t  tickMs = 0;       // Current base tick; 0 = not running
+static esp_timer_handle_t tickTimer = NULL;
+
+static uint16_t gcd(uint16_t a, uint16_t b)
+{
+    while(b) {
+        uint16_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void tick_cb(void *arg)
+{
+    int num = __atomic_load_n(&tickNumJobs, __ATOMIC_ACQUIRE);
+    uint16_t ms = __atomic_load_n(&tickMs, __ATOMIC_RELAXED);
+
+    // Periods and counters are in ms; all periods are multiples
+    // of tickMs (old and new), so no job drifts if it changes.
+    for(int i = 0; i < num; i++) {
+        TickJob *job = &tickJobs[i];
+        job->cnt += ms;
+        if(job->cnt >= job->period) {
+            job->cnt = 0;
+            job->fn(job->arg);
+        }
+    }
+}
+
+bool tick_begin()
+{
+    esp_timer_create_args_t args = {
+        .callback = &tick_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "dgtick",
+        .skip_unhandled_events = true
+    };
+
+    if(tickTimer)
+        return true;
+
+    if(esp_timer_create(&args, &tickTimer) != ESP_OK) {
+        Serial.println("Failed to create tick timer");
+        tickTimer = NULL;
+        return false;
+    }
+
+    // Timer is started when the first job is added
+
+    return true;
+}
+
+/*
+ * Add a periodic job. Jobs cannot be removed. 
+ * Must only be called from the main loop task.
+ */
+bool tick_addJob(tickJobFunc fn, void *arg, uint16_t periodMs)
+{
+    int num = tickNumJobs;
+    uint16_t ms;
+    
+    if(!tickTimer)
+        return false;
+    
+    if(num >= TICK_MAX_JOBS) {
+        Serial.println("tick_addJob: Too many jobs");
+        return false;
+    }
+
+    tickJobs[num].fn = fn;
+    tickJobs[num].arg = arg;
+    tickJobs[num].period = periodMs ? periodMs : 1;
+    tickJobs[num].cnt = 0;
+
+    // Publish job only after it is complete
+    __atomic_store_n(&tickNumJobs, num + 1, __ATOMIC_RELEASE);
+
+    // Restart timer if base tick changes
+    ms = gcd(tickMs, tickJobs[num].period);
+    if(ms != tickMs) {
+        if(tickMs) esp_timer_stop(tickTimer);
+        __atomic_store_n(&tickMs, ms, __ATOMIC_RELAXED);
+        esp_timer_start_periodic(tickTimer, (uint64_t)ms * 1000);
+    }
+
+    return true;
+}
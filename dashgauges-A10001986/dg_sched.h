@@ -0,0 +1,104 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Timer scheduler, tick service
+ *
+ * -------------------------------------------------------------------
+ * License: Modified MIT NON-AI
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ * 
+ * Links inside the Software pointing to the original source must not 
+ * be changed or removed.
+ *
+ * In addition, the following restrictions apply:
+ * 
+ * 1. The Software and any modifications made to it may not be used 
+ * for the purpose of training or improving machine learning algorithms, 
+ * including but not limited to artificial intelligence, natural 
+ * language processing, or data mining. This condition applies to any 
+ * derivatives, modifications, or updates based on the Software code. 
+ * Any usage of the Software in an AI-training dataset is considered a 
+ * breach of this License.
+ *
+ * 2. The Software may not be included in any dataset used for 
+ * training or improving machine learning algorithms, including but 
+ * not limited to artificial intelligence, natural language processing, 
+ * or data mining.
+ *
+ * 3. Any person or organization found to be in violation of these 
+ * restrictions will be subject to legal action and may be held liable 
+ * for any damages resulting from such use.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _DG_SCHED_H
+#define _DG_SCHED_H
+
+/*
+ * One-shot timers, kept in a min-heap ordered by due time. 
+ * sched_run() only needs to look at the top of the heap, so 
+ * idle loops cost one comparison. Due times are compared using 
+ * signed differences, which makes them immune to the millis() 
+ * wraparound after 49.7 days, as long as no delay exceeds 24 days.
+ * 
+ * Only to be used from the main loop task.
+ */
+
+#define SCHED_MAX_TIMERS  12
+
+struct schedTimer;
+
+typedef void (*schedCB)(struct schedTimer *t, unsigned long now);
+
+struct schedTimer {
+    unsigned long due;
+    schedCB       cb;
+    void          *arg;
+    int           id;
+    int8_t        hidx;     // Index in heap, -1 if not armed
+};
+
+void sched_init(struct schedTimer *t, schedCB cb, void *arg = NULL, int id = 0);
+bool sched_start(struct schedTimer *t, unsigned long start, unsigned long delay);
+void sched_stop(struct schedTimer *t);
+bool sched_armed(const struct schedTimer *t);
+void sched_run(unsigned long now);
+
+/*
+ * Tick service: Runs periodic jobs from one esp_timer. Jobs are 
+ * called in the context of the esp_timer task (NOT the main loop), 
+ * with deterministic periods regardless of how long the main loop 
+ * takes. Jobs must be short, and must not block.
+ * The timer runs at the greatest common divisor of all job periods,
+ * so it never fires without a job being due.
+ */
+
+#define TICK_MAX_JOBS     6
+
+typedef void (*tickJobFunc)(void *arg);
+
+bool tick_begin();
+bool tick_addJob(tickJobFunc fn, void *arg, uint16_t periodMs);
+
+#endif
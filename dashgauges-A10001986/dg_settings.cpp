@@ -81,7 +81,7 @@
 
 // Size of main config JSON
 // Needs to be adapted when config grows
-#define JSON_SIZE 2500
+#define JSON_SIZE 2950
 #if ARDUINOJSON_VERSION_MAJOR >= 7
 #error "ArduinoJSON v7 not supported"
 #define DECLARE_S_JSON(x,n) JsonDocument n;
@@ -140,6 +140,7 @@ static const char *cfgName    = "/dgconfig.json";   // Main config (flash)
 static const char *ipCfgName  = "/dgipcfg";         // IP config (flash)
 static const char *secCfgName = "/dg2cfg";          // Secondary settings (flash/SD)
 static const char *terCfgName = "/dg3cfg";          // Tertiary settings (SD)
+static const char *gaTypesName = "/dggauges.json";   // User-defined gauge types (SD)
 
 #ifdef SETTINGS_TRANSITION_2
 static const char *obsFiles[] = {
@@ -189,6 +190,7 @@ static bool checkValidNumParmF(char *text, float lowerLim, float upperLim, float
 
 static void loadUpdAvail();
 static void loadCarMode();
+static void loadGaugeTypes();
 
 static bool copy_audio_files(bool& delIDfile);
 static void cfc(File& sfile, bool doCopy, int& haveErr, int& haveWriteErr);
@@ -315,6 +317,8 @@ void settings_setup()
     if(haveSD) {
         
         firmware_update();
+
+        loadGaugeTypes();
         
         if(SD.exists("/DG_FLASH_RO") || !haveFS) {
             bool writedefault2 = false;
@@ -464,6 +468,92 @@ void settings_setup()
     }
 }
 
+/*
+ * Load user-defined gauge types from SD
+ * 
+ * Format:
+ * { 
+ *   "small": [ 
+ *      { "id": 20, "name": "My gauge (0-1V)", "type": "analog", "maxV": 2000, "vRef": 2048 },
+ *      { "id": 21, "name": "My relay gauge", "type": "digital", "gpio": 12 }
+ *   ],
+ *   "large": [ ... ]
+ * }
+ * "small" types are for "Primary" and "Percent Power", "large" for
+ * "Roentgens". id must be 1-99 and unique within the list, including
+ * built-in types. type is "analog", "digital" or "pwm". maxV is 0-4095 
+ * (of vRef), vRef is 2048, 4096 (internal reference with gain 1 or 2) or 
+ * 5000 (Vcc). "digital" and "pwm" need "gpio"; "pwm" also takes "freq" 
+ * (Hz, default 5000) and "maxDuty" (0-1023, default 1023).
+ */
+static void loadGaugeTypes()
+{
+    const char *funcName = "loadGaugeTypes";
+    static const char *lists[2] = { "small", "large" };
+    
+    if(!SD.exists(gaTypesName))
+        return;
+
+    File gtFile = SD.open(gaTypesName, "r");
+    if(!gtFile)
+        return;
+
+    DECLARE_D_JSON(4096,json);
+    
+    DeserializationError error = readJSONCfgFile(json, gtFile);
+    gtFile.close();
+    
+    if(error) {
+        Serial.printf("%s: Failed to parse %s\n", funcName, gaTypesName);
+        return;
+    }
+
+    for(int l = 0; l < 2; l++) {
+        JsonArray arr = json[lists[l]];
+        for(JsonObject gt : arr) {
+            const char *type = gt["type"] | "analog";
+            struct ga_types gat = { 0 };
+            int maxV = gt["maxV"] | 0;
+            int gpio = gt["gpio"] | 255;
+            int freq = gt["freq"] | 5000;
+            int maxDuty = gt["maxDuty"] | PWM_MAX_DUTY;
+
+            gat.id = gt["id"] | 0;
+            gat.name = gt["name"] | "";
+            gat.connectionType = DGD_TYPE_MCP4728;
+            gat.aga.VRefGain = MCP4728_VREF_INT|MCP4728_GAIN_LOW;
+            
+            if(!strcmp(type, "digital")) {
+                gat.connectionType = DGD_TYPE_DIGITAL;
+            } else if(!strcmp(type, "pwm")) {
+                gat.connectionType = DGD_TYPE_PWM;
+            } else if(strcmp(type, "analog")) {
+                gat.connectionType = DGD_TYPE_NONE;   // rejected below
+            }
+            if(maxV < 0 || maxV > 4095 || gpio < 0 || gpio > 255 ||
+               freq < 0 || freq > 65535 || maxDuty < 0 || maxDuty > 65535) {
+                gat.connectionType = DGD_TYPE_NONE;
+            }
+            gat.aga.maxV = maxV;
+            gat.dga.gpioPin = gpio;
+            gat.pga.freq = freq;
+            gat.pga.maxDuty = maxDuty;
+            switch(gt["vRef"] | 2048) {
+            case 4096:
+                gat.aga.VRefGain = MCP4728_VREF_INT|MCP4728_GAIN_HIGH;
+                break;
+            case 5000:
+                gat.aga.VRefGain = MCP4728_VREF_EXT;
+                break;
+            }
+            
+            if(!gauges.addGaugeType(!l, &gat)) {
+                Serial.printf("%s: Bad or duplicate gauge type %d in list '%s'\n", funcName, gat.id, lists[l]);
+            }
+        }
+    }
+}
+
 void unmount_fs()
 {
     if(haveFS) {
@@ -557,6 +647,7 @@ static bool read_settings(File configFile, int cfgReadCount)
         wd |= CopyCheckValidNumParm(json["aMut"], settings.autoMute, sizeof(settings.autoMute), 0, 360, DEF_AUTO_MUTE);
         wd |= CopyCheckValidNumParm(json["playALsnd"], settings.playALsnd, sizeof(settings.playALsnd), 0, 1, DEF_PLAY_ALM_SND);
         wd |= CopyCheckValidNumParm(json["ssTimer"], settings.ssTimer, sizeof(settings.ssTimer), 0, 999, DEF_SS_TIMER);
+        wd |= CopyTextParm(json["elPat"], settings.elPat, sizeof(settings.elPat));
 
         wd |= CopyCheckValidNumParm(json["lIdle"], settings.lIdle, sizeof(settings.lIdle), 0, 100, DEF_L_GAUGE_IDLE);
         wd |= CopyCheckValidNumParm(json["cIdle"], settings.cIdle, sizeof(settings.cIdle), 0, 100, DEF_C_GAUGE_IDLE);
@@ -564,10 +655,14 @@ static bool read_settings(File configFile, int cfgReadCount)
         wd |= CopyCheckValidNumParm(json["lEmpty"], settings.lEmpty, sizeof(settings.lEmpty), 0, 100, DEF_L_GAUGE_EMPTY);
         wd |= CopyCheckValidNumParm(json["cEmpty"], settings.cEmpty, sizeof(settings.cEmpty), 0, 100, DEF_C_GAUGE_EMPTY);
         wd |= CopyCheckValidNumParm(json["rEmpty"], settings.rEmpty, sizeof(settings.rEmpty), 0, 100, DEF_R_GAUGE_EMPTY);
+        wd |= CopyTextParm(json["lCal"], settings.lCal, sizeof(settings.lCal));
+        wd |= CopyTextParm(json["cCal"], settings.cCal, sizeof(settings.cCal));
+        wd |= CopyTextParm(json["rCal"], settings.rCal, sizeof(settings.rCal));
 
         wd |= CopyCheckValidNumParm(json["drPri"], settings.drPri, sizeof(settings.drPri), 0, 1, DEF_DR_PRI);
         wd |= CopyCheckValidNumParm(json["drPPo"], settings.drPPo, sizeof(settings.drPPo), 0, 1, DEF_DR_PPO);
         wd |= CopyCheckValidNumParm(json["drRoe"], settings.drRoe, sizeof(settings.drRoe), 0, 1, DEF_DR_ROE);
+        wd |= CopyCheckValidNumParm(json["inertia"], settings.inertia, sizeof(settings.inertia), 0, 500, DEF_INERTIA);
 
         wd |= CopyCheckValidNumParm(json["lTh"], settings.lThreshold, sizeof(settings.lThreshold), 0, 99, 0);
         wd |= CopyCheckValidNumParm(json["cTh"], settings.cThreshold, sizeof(settings.cThreshold), 0, 99, 0);
@@ -600,9 +695,10 @@ static bool read_settings(File configFile, int cfgReadCount)
         wd |= CopyCheckValidNumParm(json["dsTTO"], settings.dsTTout, sizeof(settings.dsTTout), 0, 1, DEF_DS_TTOUT);
         #endif
 
-        wd |= CopyCheckValidNumParm(json["gaugeIDA"], settings.gaugeIDA, sizeof(settings.gaugeIDA), 0, gauges.max_id_small, DEF_GAUGE_TYPE);
-        wd |= CopyCheckValidNumParm(json["gaugeIDB"], settings.gaugeIDB, sizeof(settings.gaugeIDB), 0, gauges.max_id_small, DEF_GAUGE_TYPE);
-        wd |= CopyCheckValidNumParm(json["gaugeIDC"], settings.gaugeIDC, sizeof(settings.gaugeIDC), 0, gauges.max_id_large, DEF_GAUGE_TYPE);
+        // User-defined gauge types are not loaded yet, check against max possible id
+        wd |= CopyCheckValidNumParm(json["gaugeIDA"], settings.gaugeIDA, sizeof(settings.gaugeIDA), 0, GA_MAX_ID, DEF_GAUGE_TYPE);
+        wd |= CopyCheckValidNumParm(json["gaugeIDB"], settings.gaugeIDB, sizeof(settings.gaugeIDB), 0, GA_MAX_ID, DEF_GAUGE_TYPE);
+        wd |= CopyCheckValidNumParm(json["gaugeIDC"], settings.gaugeIDC, sizeof(settings.gaugeIDC), 0, GA_MAX_ID, DEF_GAUGE_TYPE);
 
         #ifdef DG_HAVEMQTT
         wd |= CopyCheckValidNumParm(json["useMQTT"], settings.useMQTT, sizeof(settings.useMQTT), 0, 1, 0);
@@ -658,6 +754,7 @@ void write_settings()
     json["aMut"] = (const char *)settings.autoMute;
     json["playALsnd"] = (const char *)settings.playALsnd;
     json["ssTimer"] = (const char *)settings.ssTimer;
+    json["elPat"] = (const char *)settings.elPat;
 
     json["lIdle"] = (const char *)settings.lIdle;
     json["cIdle"] = (const char *)settings.cIdle;
@@ -665,9 +762,13 @@ void write_settings()
     json["lEmpty"] = (const char *)settings.lEmpty;
     json["cEmpty"] = (const char *)settings.cEmpty;
     json["rEmpty"] = (const char *)settings.rEmpty;
+    json["lCal"] = (const char *)settings.lCal;
+    json["cCal"] = (const char *)settings.cCal;
+    json["rCal"] = (const char *)settings.rCal;
     json["drPri"] =  (const char *)settings.drPri;
     json["drPPo"] =  (const char *)settings.drPPo;
     json["drRoe"] =  (const char *)settings.drRoe;
+    json["inertia"] = (const char *)settings.inertia;
 
     json["lTh"] = (const char *)settings.lThreshold;
     json["cTh"] = (const char *)settings.cThreshold;
@@ -139,6 +139,7 @@ void   freeUploadFileNames();
 #define DEF_DR_PRI          1     // 0: Meter jumps to zero after TT; 1: slowly drain during TT
 #define DEF_DR_PPO          1     // 0: Meter jumps to zero after TT; 1: slowly drain during TT
 #define DEF_DR_ROE          1     // 0: Meter jumps to zero after TT; 1: slowly drain during TT
+#define DEF_INERTIA         80    // Needle inertia of analog gauges (ms); 0=off
 
 #define DEF_TCD_IP          ""    // TCD hostname (or ip address) for BTTFN
 #define DEF_USE_GPSS        0     // 0: Ignore GPS speed; 1: Use it for chase speed
@@ -180,6 +181,7 @@ struct Settings {
     char autoMute[4]        = MS(DEF_AUTO_MUTE);
     char playALsnd[2]       = MS(DEF_PLAY_ALM_SND);
     char ssTimer[4]         = MS(DEF_SS_TIMER);
+    char elPat[64]          = "";
 
     char lIdle[4]           = MS(DEF_L_GAUGE_IDLE);
     char cIdle[4]           = MS(DEF_C_GAUGE_IDLE);
@@ -187,9 +189,13 @@ struct Settings {
     char lEmpty[4]          = MS(DEF_L_GAUGE_EMPTY);
     char cEmpty[4]          = MS(DEF_C_GAUGE_EMPTY);
     char rEmpty[4]          = MS(DEF_R_GAUGE_EMPTY);
+    char lCal[64]           = "";
+    char cCal[64]           = "";
+    char rCal[64]           = "";
     char drPri[2]           = MS(DEF_DR_PRI);
     char drPPo[2]           = MS(DEF_DR_PPO);
     char drRoe[2]           = MS(DEF_DR_ROE);
+    char inertia[4]         = MS(DEF_INERTIA);
 
     char lThreshold[4]      = "0";
     char cThreshold[4]      = "0";
@@ -283,6 +283,7 @@ WiFiManagerParameter custom_aRef("aRef", "Auto-refill timer (1-360[seconds]; 0=n
 WiFiManagerParameter custom_aMut("aMut", "Mute 'empty' alarm timer (1-360[seconds]; 0=never)", settings.autoMute, 3, "type='number' min='0' max='360' autocomplete='off'");
 WiFiManagerParameter custom_playALSnd("plyALS", "Play TCD-alarm sound", settings.playALsnd, "title='Check to have the device play a sound when the TCD alarm sounds.' class='mt5 mb10'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
 WiFiManagerParameter custom_ssDelay("ssDel", "Screen saver timer (1-999[minutes]; 0=off)", settings.ssTimer, 3, "type='number' min='0' max='999' autocomplete='off'");
+WiFiManagerParameter custom_elPat("elPat", "'Empty' LED pattern (level[%]:time[10ms],...; empty=standard)", settings.elPat, 63, "pattern='[0-9:,rR ]*' placeholder='Example: r100:40,r0:40' autocomplete='off'");
 
 WiFiManagerParameter custom_sectstart_ag("Analog gauges setup", WFM_SECTS|WFM_HL);
 WiFiManagerParameter custom_lIdle("lIdle", "'Primary' full percentage (1-100; 0=use default)", settings.lIdle, 3, "type='number' min='0' max='100' autocomplete='off'");
@@ -291,9 +292,13 @@ WiFiManagerParameter custom_rIdle("rIdle", "'Roentgens' full percentage (1-100;
 WiFiManagerParameter custom_lEmpty("lEmpty", "'Primary' empty percentage (0-100)", settings.lEmpty, 3, "type='number' min='0' max='100' autocomplete='off'");
 WiFiManagerParameter custom_cEmpty("cEmpty", "'Percent Power' empty percentage (0-100)", settings.cEmpty, 3, "type='number' min='0' max='100' autocomplete='off'");
 WiFiManagerParameter custom_rEmpty("rEmpty", "'Roentgens' empty percentage (0-100)", settings.rEmpty, 3, "type='number' min='0' max='100' autocomplete='off'");
+WiFiManagerParameter custom_lCal("lCal", "'Primary' calibration (scale:voltage[%],...; empty=linear)", settings.lCal, 63, "pattern='[0-9:, ]*' placeholder='Example: 25:15,50:40,75:70' autocomplete='off'");
+WiFiManagerParameter custom_cCal("cCal", "'Percent Power' calibration (scale:voltage[%],...; empty=linear)", settings.cCal, 63, "pattern='[0-9:, ]*' placeholder='Example: 25:15,50:40,75:70' autocomplete='off'");
+WiFiManagerParameter custom_rCal("rCal", "'Roentgens' calibration (scale:voltage[%],...; empty=linear)", settings.rCal, 63, "pattern='[0-9:, ]*' placeholder='Example: 25:15,50:40,75:70' autocomplete='off'");
 WiFiManagerParameter custom_drPri("drPri", "Slowly drain Primary during TT", settings.drPri, "title='Check to to slowly drain meter during time travel.' class='mt5' style='margin-bottom:15px;'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
 WiFiManagerParameter custom_drPPo("drPPo", "Slowly drain Percent Power during TT", settings.drPPo, "title='Check to to slowly drain meter during time travel.' class='mt5' style='margin-bottom:15px;'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
-WiFiManagerParameter custom_drRoe("drRoe", "Slowly drain Roentgens during TT", settings.drRoe, "title='Check to to slowly drain meter during time travel.' class='mt5'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
+WiFiManagerParameter custom_drRoe("drRoe", "Slowly drain Roentgens during TT", settings.drRoe, "title='Check to to slowly drain meter during time travel.' class='mt5' style='margin-bottom:15px;'", WFM_LABEL_AFTER|WFM_IS_CHKBOX);
+WiFiManagerParameter custom_inertia("inertia", "Needle inertia (0-500[ms]; 0=off)", settings.inertia, 3, "type='number' min='0' max='500' autocomplete='off'");
 
 WiFiManagerParameter custom_sectstart_dg("Digital/Legacy gauges setup", WFM_SECTS|WFM_HL);
 WiFiManagerParameter custom_lTh("lTh", "'Primary' empty threshold (0-99)", settings.lThreshold, 2, "type='number' min='0' max='99' autocomplete='off'");
@@ -483,6 +488,10 @@ static bool mqttReconnect(bool force = false);
 static void mqttLooper();
 static void mqttCallback(char *topic, byte *payload, unsigned int length);
 static void mqttSubscribe();
+static void mqttPubI2CStatus();
+#ifdef DG_HAVEDOORSWITCH
+static void mqttPubDoorStatus();
+#endif
 #endif
 
 /*
@@ -525,21 +534,26 @@ void wifi_setup()
 
       &custom_hsel,
       
-      &custom_aRef,           // 4
+      &custom_aRef,           // 5
       &custom_aMut,
       &custom_playALSnd,
       &custom_ssDelay,
+      &custom_elPat,
   
-      &custom_sectstart_ag,   // 10
+      &custom_sectstart_ag,   // 14
       &custom_lIdle,
       &custom_lEmpty,
+      &custom_lCal,
       &custom_drPri,
       &custom_cIdle,
       &custom_cEmpty,
+      &custom_cCal,
       &custom_drPPo,
       &custom_rIdle,
       &custom_rEmpty,
+      &custom_rCal,
       &custom_drRoe,
+      &custom_inertia,
   
       &custom_sectstart_dg,   // 5
       &custom_lTh,
@@ -1014,6 +1028,7 @@ void wifi_loop()
             mystrcpy(settings.autoMute, &custom_aMut);
             evalCB(settings.playALsnd, &custom_playALSnd);
             mystrcpy(settings.ssTimer, &custom_ssDelay);
+            strcpytrim(settings.elPat, custom_elPat.getValue());
 
             mystrcpy(settings.lIdle, &custom_lIdle);
             mystrcpy(settings.cIdle, &custom_cIdle);
@@ -1021,9 +1036,13 @@ void wifi_loop()
             mystrcpy(settings.lEmpty, &custom_lEmpty);
             mystrcpy(settings.cEmpty, &custom_cEmpty);
             mystrcpy(settings.rEmpty, &custom_rEmpty);
+            strcpytrim(settings.lCal, custom_lCal.getValue());
+            strcpytrim(settings.cCal, custom_cCal.getValue());
+            strcpytrim(settings.rCal, custom_rCal.getValue());
             evalCB(settings.drPri, &custom_drPri);
             evalCB(settings.drPPo, &custom_drPPo);
             evalCB(settings.drRoe, &custom_drRoe);
+            mystrcpy(settings.inertia, &custom_inertia);
 
             mystrcpy(settings.lThreshold, &custom_lTh);
             mystrcpy(settings.cThreshold, &custom_cTh);
@@ -1675,6 +1694,7 @@ static void updateConfigPortalValues()
     custom_aMut.setValue(settings.autoMute);
     setCBVal(&custom_playALSnd, settings.playALsnd);
     custom_ssDelay.setValue(settings.ssTimer);
+    custom_elPat.setValue(settings.elPat);
 
     custom_lIdle.setValue(settings.lIdle);
     custom_cIdle.setValue(settings.cIdle);
@@ -1682,9 +1702,13 @@ static void updateConfigPortalValues()
     custom_lEmpty.setValue(settings.lEmpty);
     custom_cEmpty.setValue(settings.cEmpty);
     custom_rEmpty.setValue(settings.rEmpty);
+    custom_lCal.setValue(settings.lCal);
+    custom_cCal.setValue(settings.cCal);
+    custom_rCal.setValue(settings.rCal);
     setCBVal(&custom_drPri, settings.drPri);
     setCBVal(&custom_drPPo, settings.drPPo);
     setCBVal(&custom_drRoe, settings.drRoe);
+    custom_inertia.setValue(settings.inertia);
 
     custom_lTh.setValue(settings.lThreshold);
     custom_cTh.setValue(settings.cThreshold);
@@ -2726,6 +2750,8 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
       "\x01" "VOLUME_DOWN",      // 16
       "\x01" "VOLUME_SET_",      // 17  VOLUME_SET_0..VOLUME_SET_100
       "\xc1" "MP_REQSTATUS",     // 18  executed even while off or busy
+      "\xc1" "I2C_REQSTATUS",    // 19  executed even while off or busy
+      "\xc1" "DOOR_REQSTATUS",   // 20  executed even while off or busy
       NULL
     };
     static const char *cmdList2[] = {
@@ -2890,6 +2916,14 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
         case 18:
             mp_sendStatus(1);
             break;
+        case 19:
+            mqttPubI2CStatus();
+            break;
+        case 20:
+            #ifdef DG_HAVEDOORSWITCH
+            mqttPubDoorStatus();
+            #endif
+            break;
         default:
             addCmdQueue(1000 + i);
         }            
@@ -3018,4 +3052,47 @@ bool mqttPublish(const char *topic, const char *pl, unsigned int len)
     return true;
 }           
 
+static void mqttPubI2CStatus()
+{
+    struct dgI2CStats st;
+    char msg[160];
+    
+    gauges.getI2CStats(&st);
+    
+    sprintf(msg, "{\"F\":\"%u\",\"J\":\"%u\",\"E\":\"%u\",\"N\":\"%u\",\"T\":\"%u\",\"D\":\"%u\"}",
+        (unsigned int)(st.clock / 1000),
+        (unsigned int)st.jobs, 
+        (unsigned int)st.errors, 
+        (unsigned int)st.nacks, 
+        (unsigned int)st.timeouts, 
+        (unsigned int)st.dropped);
+        
+    mqttPublish("bttf/dg/i2cstatus", msg, strlen(msg) + 1);
+}
+
+#ifdef DG_HAVEDOORSWITCH
+static void mqttPubDoorStatus()
+{
+    struct dsLatStats st;
+    char msg[256];
+    char *p = msg;
+    
+    getDoorLatStats(&st);
+
+    p += sprintf(p, "{\"S\":\"");
+    for(int i = 0; i < DS_LAT_BUCKETS; i++) {
+        p += sprintf(p, i ? ",%u" : "%u", (unsigned int)st.snd[i]);
+    }
+    p += sprintf(p, "\",\"P\":\"");
+    for(int i = 0; i < DS_LAT_BUCKETS; i++) {
+        p += sprintf(p, i ? ",%u" : "%u", (unsigned int)st.pkt[i]);
+    }
+    sprintf(p, "\",\"L\":\"%u\",\"D\":\"%u\"}",
+        (unsigned int)st.late, 
+        (unsigned int)st.dropped);
+        
+    mqttPublish("bttf/dg/doorstatus", msg, strlen(msg) + 1);
+}
+#endif
+
 #endif
@@ -106,6 +106,24 @@
  * Control Board, only one GPIO pin is reserved for digital gauges, so they all use
  * the same. Custom variations of that board could allow different ones.
  * 
+ * DGD_TYPE_PWM:
+ * 
+ * This defines a gauge driven by a PWM signal on a GPIO pin, generated by the 
+ * ESP32's LEDC peripheral. Like analog gauges, PWM gauges can show arbitrary 
+ * percentages. This is meant for low-voltage meters without relay; the meter 
+ * is either driven directly (a moving-coil meter averages the signal by itself
+ * at frequencies above a few hundred Hz), or through an RC low-pass filter
+ * (whose time constant should be well above 1/freq; eg. 10k/10uF at 5kHz).
+ * NEVER use this type with a relay-switched gauge.
+ * 
+ * PWM gauges use the GPIO pin from the second struct (as digital gauges), and
+ * are further configured in the third struct:
+ * 
+ * freq: PWM frequency in Hz (100-40000)
+ * 
+ * maxDuty: The maximum duty cycle ever output, in 1/1023s. 1023 means 100% 
+ * (ie. the pin's full voltage, 3.3V, or the 12V on DIGITAL_GAUGE_PIN).
+ * 
  * For digital gauges, there is a "Threshold" setting in the Config Portal.
  * This defines the "virtual percentage" (0% being the left end of the scale, 100% 
  * being the right end of the scale) at which the gauge should switch from "full" 
@@ -142,7 +160,12 @@ static const struct ga_types gaugeTypesSmall[] = {
     // Board, the output voltage is 12V, but can be adjusted by putting a resistor
     // instead of a bridge at DIG1 (for "Percent Power") or DIG2 (for "Primary").
     { 2, "Digital / Legacy (0/12V)", DGD_TYPE_DIGITAL, 
-      {}, { DIGITAL_GAUGE_PIN } }
+      {}, { DIGITAL_GAUGE_PIN } },
+
+    // Type 6: PWM, 0-12V, on DIGITAL_GAUGE_PIN. For meters connected to the
+    // digital gauge output WITHOUT relay.
+    { 6, "PWM on Digital output (0-12V; no relay!)", DGD_TYPE_PWM,
+      {}, { DIGITAL_GAUGE_PIN }, { 5000, PWM_MAX_DUTY } }
 };
 
 static const struct ga_types gaugeTypesLarge[] = {
@@ -172,7 +195,12 @@ static const struct ga_types gaugeTypesLarge[] = {
     // instead of a bridge at DIG5. A digital "Roentgens" meter must be connected to the 
     // "Digital Roentgens" connector, pins 1 (+) and 2 (-).
     { 3, "Digital / Legacy (0/12V)", DGD_TYPE_DIGITAL,
-      {}, { DIGITAL_GAUGE_PIN } }
+      {}, { DIGITAL_GAUGE_PIN } },
+
+    // Type 8: PWM, 0-12V, on DIGITAL_GAUGE_PIN. For meters connected to the
+    // "Digital Roentgens" connector WITHOUT relay.
+    { 8, "PWM on Digital output (0-12V; no relay!)", DGD_TYPE_PWM,
+      {}, { DIGITAL_GAUGE_PIN }, { 5000, PWM_MAX_DUTY } }
 
     /*
     // Example:
@@ -190,103 +218,248 @@ static const struct ga_types gaugeTypesLarge[] = {
  * Empty LED class
  */
 
-// Timer interrupt
-#define TMR_TIME      0.01    // 0.01s = 10ms
-#define TMR_PRESCALE  80
-#define TMR_TICKS     (uint64_t)(((double)TMR_TIME * 80000000.0) / (double)TMR_PRESCALE)
-#define TME_TIMEUS    (TMR_TIME * 1000000)
+// Tick job period
+#define EL_TICK_MS    10
 
-static volatile int      _pin = 0;
-static volatile int32_t  _ticks = 0;
-static volatile bool     _critical = false;
-static volatile bool     _blinkEnable = false;
-static volatile bool     _blinkWasOff = false;
-static volatile bool     _emptyLED = false;
-static volatile int16_t  _tick_interval = 400; // random, will be overwritten
-static volatile uint16_t _blinkDelay = 0;
+/*
+ * Sequences are small bytecode programs, run by the tick job
+ * at 10ms per tick:
+ * 
+ * ELOP_LVL  level ticks    Set brightness (0-255) for "ticks" ticks
+ * ELOP_RAMP level ticks    Fade from current brightness to "level" 
+ *                          within "ticks" ticks
+ * ELOP_LOOP count target   Jump back to "target" (byte offset) "count" 
+ *                          times, then continue. Loops cannot be nested.
+ * ELOP_JUMP target         Jump to "target"
+ * ELOP_END                 End of sequence (LED off)
+ * 
+ * Sequences without ELOP_END repeat until stopped.
+ */
+#define ELOP_END    0
+#define ELOP_LVL    1
+#define ELOP_RAMP   2
+#define ELOP_LOOP   3
+#define ELOP_JUMP   4
 
-#define SS_ONESHOT 0xfe
-#define SS_LOOP    0
-#define SS_END     0xff
-static volatile bool     _specialsig = false;
-static volatile bool     _wasSpecial = false;
-static volatile bool     _specialOS = false;
-static volatile uint8_t  _specialsignum = 0;
-static volatile uint8_t  _specialidx = 0;
-static volatile int16_t  _specialticks = 0;
+#define EL_ON(t)    ELOP_LVL, 255, (t)
+#define EL_OFF(t)   ELOP_LVL, 0, (t)
+
+#define EL_MAX_FETCH 8        // Max non-timed ops per tick (catches empty jump loops)
 
-static const DRAM_ATTR uint8_t _specialArray[DGSEQ_MAX][64] = {
+static const DRAM_ATTR uint8_t _specialArray[DGSEQ_MAX][32] = {
     {                                               // 1: Please update sound-pack ("SOS")
-      SS_ONESHOT,
-      1, 15, 0, 15, 1, 15, 0, 15, 1, 15, 0, 15,
-      1, 40, 0, 40, 1, 40, 0, 40, 1, 40, 0, 40,
-      1, 15, 0, 15, 1, 15, 0, 15, 1, 15, 0, 15,
-      SS_END
+      EL_ON(15), EL_OFF(15), ELOP_LOOP, 2, 0,       //  0
+      EL_ON(40), EL_OFF(40), ELOP_LOOP, 2, 9,       //  9
+      EL_ON(15), EL_OFF(15), ELOP_LOOP, 2, 18,      // 18
+      ELOP_END
     },
     {                                               // 2: Wait
-      SS_LOOP,
-      1, 50, 0, 50,
-      SS_END
+      EL_ON(50), EL_OFF(50), 
+      ELOP_JUMP, 0
     },
     {                                               // 3: Alarm (BTTFN/MQTT)
-      SS_ONESHOT,
-      1, 100, 0, 50, 1, 100, 0, 50,
-      1, 100, 0, 50, 1, 100, 0, 50,
-      SS_END
+      EL_ON(100), EL_OFF(50), ELOP_LOOP, 3, 0,
+      ELOP_END
     },
     {                                               // 4: Error when copying sound-pack
-      SS_LOOP,
-      1, 20, 0, 20, 1, 20, 0, 100,
-      SS_END
+      EL_ON(20), EL_OFF(20), EL_ON(20), EL_OFF(100),
+      ELOP_JUMP, 0
     },
     {                                               // 5: Update available
-      SS_ONESHOT,
-      1, 10, 0, 10, 1, 10, 0, 10, 1, 10, 0, 10,
-      1, 10, 0, 10, 1, 10, 0, 10, 1, 10, 0, 10,
-      SS_END
+      EL_ON(10), EL_OFF(10), ELOP_LOOP, 5, 0,
+      ELOP_END
     },
 };
 
-// ISR: "Empty" LED blinking
+typedef struct {
+    const uint8_t *prog;
+    uint8_t pc;
+    uint8_t hold;               // Ticks left in current step
+    uint8_t level;              // Current brightness
+    uint8_t from, to, len;      // Current step
+    uint8_t loopCnt;
+    bool    isRamp;
+    bool    inLoop;
+    bool    running;
+} ELVM;
 
-static void IRAM_ATTR _el_on()
+/*
+ * Control block, written by the main loop, read by the tick job 
+ * (which runs in another task, possibly on the other core). The 
+ * main loop fills the inactive buffer and then increments the 
+ * sequence counter, whose LSB selects the active buffer. The tick
+ * job re-reads the counter after copying, and retries if it 
+ * changed meanwhile. Changes are detected through the generation 
+ * counters.
+ */
+typedef struct {
+    const uint8_t *seq;         // Special sequence, NULL if none
+    const uint8_t *blinkProg;   // Blink pattern, NULL for standard blink
+    uint8_t       seqGen;
+    uint8_t       blinkGen;
+    bool          blinkEnable;
+    uint16_t      blinkDelay;
+    int16_t       tickInterval;
+} ELCtrl;
+
+static ELCtrl            _elShadow = { NULL, NULL, 0, 0, false, 0, 400 };
+static ELCtrl            _elCtrl[2] = { _elShadow, _elShadow };
+static volatile uint32_t _elCtrlSeq = 0;
+static volatile uint8_t  _elSeqDoneGen = 0;
+static volatile uint8_t  _elBlinkAckGen = 0;
+
+// User-defined blink pattern (double-buffered)
+static uint8_t           _elUserProg[2][EL_MAX_PROG];
+
+// Tick job state
+static volatile int      _pin = 0;
+static volatile bool     _elPWM = false;
+static volatile int16_t  _elLevel = -1;
+static volatile int32_t  _ticks = 0;
+static volatile bool     _blinkEnable = false;
+static volatile bool     _blinkWasOff = false;
+static volatile bool     _emptyLED = false;
+static volatile int16_t  _tick_interval = 400; // random, will be overwritten
+static volatile uint16_t _blinkDelay = 0;
+static volatile bool     _specialsig = false;
+static volatile bool     _wasSpecial = false;
+static uint8_t           _elSeqGen = 0;
+static uint8_t           _elBlinkGen = 0;
+static ELVM              _specVM;
+static ELVM              _blinkVM;
+
+// Tick job: "Empty" LED blinking
+
+static void _el_set(uint8_t level)
+{
+    if(_elLevel == level)
+        return;
+    _elLevel = level;
+    if(_elPWM) {
+        ledcWrite(EL_PWM_CHANNEL, level);   // 255 = fully on
+    } else {
+        digitalWrite(_pin, level ? HIGH : LOW);
+    }
+}
+
+static void _el_on()
+{
+    _el_set(255);
+}
+
+static void _el_off()
 {
-    digitalWrite(_pin, HIGH);
+    _el_set(0);
 }
 
-static void IRAM_ATTR _el_off()
+static void el_vmStart(ELVM *vm, const uint8_t *prog)
 {
-    digitalWrite(_pin, LOW);
+    vm->prog = prog;
+    vm->pc = 0;
+    vm->hold = 0;
+    vm->level = 0;
+    vm->inLoop = false;
+    vm->running = (prog != NULL);
 }
 
-static void IRAM_ATTR ISR_DG_Empty()
-{       
-    if(_critical)
+static void el_vmTick(ELVM *vm)
+{
+    if(!vm->running)
         return;
+        
+    if(!vm->hold) {
+        for(int i = 0; ; i++) {
+            const uint8_t *op = vm->prog + vm->pc;
+            if(i >= EL_MAX_FETCH) {
+                vm->running = false;
+                return;
+            }
+            switch(op[0]) {
+            case ELOP_LVL:
+            case ELOP_RAMP:
+                vm->isRamp = (op[0] == ELOP_RAMP);
+                vm->from = vm->level;
+                vm->to = op[1];
+                vm->len = vm->hold = op[2] ? op[2] : 1;
+                vm->pc += 3;
+                break;
+            case ELOP_LOOP:
+                if(!vm->inLoop) {
+                    vm->loopCnt = op[1];
+                    vm->inLoop = true;
+                }
+                if(vm->loopCnt) {
+                    vm->loopCnt--;
+                    vm->pc = op[2];
+                } else {
+                    vm->inLoop = false;
+                    vm->pc += 3;
+                }
+                continue;
+            case ELOP_JUMP:
+                vm->pc = op[1];
+                continue;
+            default:
+                vm->running = false;
+                return;
+            }
+            break;
+        }
+    }
+
+    if(vm->isRamp) {
+        int pos = vm->len - vm->hold + 1;
+        vm->level = vm->from + (((int)vm->to - (int)vm->from) * pos) / vm->len;
+    } else {
+        vm->level = vm->to;
+    }
+    vm->hold--;
+}
+
+static void el_tick(void *arg)
+{
+    ELCtrl c;
+    const ELCtrl *ctrl = &c;
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&_elCtrlSeq, __ATOMIC_ACQUIRE);
+        c = _elCtrl[seq & 1];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while(seq != __atomic_load_n(&_elCtrlSeq, __ATOMIC_RELAXED));
+
+    if(ctrl->seqGen != _elSeqGen) {
+        _elSeqGen = ctrl->seqGen;
+        el_vmStart(&_specVM, ctrl->seq);
+        if(!(_specialsig = _specVM.running)) {
+            _elSeqDoneGen = _elSeqGen;
+        }
+    }
+
+    if(ctrl->blinkGen != _elBlinkGen) {
+        _elBlinkGen = ctrl->blinkGen;
+        if(_blinkVM.prog != ctrl->blinkProg) {
+            el_vmStart(&_blinkVM, ctrl->blinkProg);
+            // Restart blinking with new pattern
+            if(_blinkEnable && ctrl->blinkEnable) _blinkWasOff = true;
+        }
+        _blinkDelay = ctrl->blinkDelay;
+        _tick_interval = ctrl->tickInterval;
+        _blinkEnable = ctrl->blinkEnable;
+        _elBlinkAckGen = _elBlinkGen;
+    }
 
     if(_specialsig) {
       
         // Special sequence for signalling
         _wasSpecial = true;
-        if(_specialticks == 0) {
-            if(_specialArray[_specialsignum][_specialidx] == SS_END) {
-                 if(_specialOS) {
-                    _specialsig = _wasSpecial = false; 
-                    _el_off();
-                 } else {
-                    _specialidx = 1;
-                 }
-            }
-            if(_specialsig) {
-                (_specialArray[_specialsignum][_specialidx]) ? _el_on() : _el_off();
-            }
-        }
-        if(_specialsig) {
-            _specialticks++;
-            if(_specialticks >= _specialArray[_specialsignum][_specialidx + 1]) {
-                _specialticks = 0;
-                _specialidx += 2;
-            }
+        el_vmTick(&_specVM);
+        if(_specVM.running) {
+            _el_set(_specVM.level);
+        } else {
+            _specialsig = _wasSpecial = false;
+            _elSeqDoneGen = _elSeqGen;
+            _el_off();
         }
 
     } else if(_wasSpecial) {
@@ -313,6 +486,17 @@ static void IRAM_ATTR ISR_DG_Empty()
         return;
     }
 
+    if(_blinkVM.prog) {
+        // User-defined pattern
+        if(_blinkWasOff || !_blinkVM.running) {
+            el_vmStart(&_blinkVM, _blinkVM.prog);
+            _blinkWasOff = false;
+        }
+        el_vmTick(&_blinkVM);
+        if(!_specialsig) _el_set(_blinkVM.level);
+        return;
+    }
+
     if(_blinkWasOff) {
         _ticks = 0;
         if(!_specialsig) _el_on();
@@ -320,7 +504,7 @@ static void IRAM_ATTR ISR_DG_Empty()
         _blinkWasOff = false;
     }
 
-    _ticks += 10;
+    _ticks += EL_TICK_MS;
     if(_ticks >= _tick_interval) {
         _ticks -= _tick_interval;
         _emptyLED = !_emptyLED;
@@ -331,61 +515,346 @@ static void IRAM_ATTR ISR_DG_Empty()
 
 }
 
-EmptyLED::EmptyLED(uint8_t timer_no)
+// Publish _elShadow to tick job
+static void el_publish()
 {
+    uint32_t seq = _elCtrlSeq + 1;
     
-    _timer_no = timer_no;
+    _elCtrl[seq & 1] = _elShadow;
+    __atomic_store_n(&_elCtrlSeq, seq, __ATOMIC_RELEASE);
+}
+
+EmptyLED::EmptyLED()
+{
 }
 
-void EmptyLED::begin(uint8_t pin)
+void EmptyLED::begin(uint8_t pin, bool usePWM)
 {   
     _pin = pin;
     
-    pinMode(_pin, OUTPUT);
+    if((_elPWM = usePWM)) {
+        ledcSetup(EL_PWM_CHANNEL, EL_PWM_FREQ, EL_PWM_RES_BITS);
+        ledcAttachPin(_pin, EL_PWM_CHANNEL);
+    } else {
+        pinMode(_pin, OUTPUT);
+    }
     
     // Switch off
     _el_off();
 
-    // Install & enable timer interrupt
-    _DGTimer_Cfg = timerBegin(_timer_no, TMR_PRESCALE, true);
-    timerAttachInterrupt(_DGTimer_Cfg, &ISR_DG_Empty, true);
-    timerAlarmWrite(_DGTimer_Cfg, TMR_TICKS, true);
-    timerAlarmEnable(_DGTimer_Cfg);
+    // Install tick job
+    _running = tick_addJob(el_tick, NULL, EL_TICK_MS);
 }
 
 void EmptyLED::startBlink(uint16_t milliSecs, uint16_t delayTicks)
 {
-    _critical = true;
-    _blinkDelay = delayTicks;
-    _tick_interval = milliSecs;
-    _blinkEnable = true;
-    _critical = false;
+    _elShadow.blinkDelay = delayTicks;
+    _elShadow.tickInterval = milliSecs;
+    _elShadow.blinkEnable = true;
+    _elShadow.blinkGen++;
+    el_publish();
 }
 
 void EmptyLED::stopBlink()
 {
-    _critical = true;
-    _blinkEnable = false;
-    _critical = false;
+    _elShadow.blinkEnable = false;
+    _elShadow.blinkGen++;
+    el_publish();
 }
 
-void EmptyLED::specialSignal(uint8_t signum) 
+/*
+ * Set user-defined pattern for "empty" blinking, replacing the 
+ * standard blink. Format: Comma-separated steps "level:time", 
+ * level in percent (0-100), time in 10ms units (1-255); "r" before
+ * the level fades to it instead. The pattern repeats. 
+ * An empty string selects the standard blink.
+ */
+bool EmptyLED::setBlinkPattern(const char *pat)
 {
-    _critical = true;
-    _specialsig = false;
-    if(signum) {
-        _specialsignum = signum - 1;
-        _specialOS = (_specialArray[_specialsignum][0] == SS_ONESHOT);
-        _specialidx = 1;
-        _specialticks = 0;
-        _specialsig = true;
+    uint8_t *prog;
+    unsigned long now = millis();
+    int len = 0;
+    bool ret = true;
+
+    // Wait until tick job has picked up the previous pattern,
+    // so the buffer not used by _elShadow is free
+    while(_running && _elBlinkAckGen != _elShadow.blinkGen) {
+        if(millis() - now > 100)
+            return false;
+        delay(1);
     }
-    _critical = false;
+
+    prog = (_elShadow.blinkProg == _elUserProg[0]) ? _elUserProg[1] : _elUserProg[0];
+
+    while(pat && *pat) {
+        int lvl, ticks;
+        bool isRamp = false;
+        
+        while(*pat == ' ' || *pat == ',') pat++;
+        if(!*pat) break;
+        if(*pat == 'r' || *pat == 'R') {
+            isRamp = true;
+            pat++;
+        }
+        if(sscanf(pat, "%d:%d", &lvl, &ticks) != 2 || 
+           lvl < 0 || lvl > 100 || ticks < 1 || ticks > 255 ||
+           len > EL_MAX_PROG - 5) {
+            ret = false;
+            break;
+        }
+        prog[len++] = isRamp ? ELOP_RAMP : ELOP_LVL;
+        prog[len++] = (lvl * 255) / 100;
+        prog[len++] = ticks;
+        while(*pat && *pat != ',') pat++;
+    }
+
+    if(ret && len) {
+        prog[len++] = ELOP_JUMP;
+        prog[len++] = 0;
+    } else {
+        prog = NULL;
+    }
+
+    _elShadow.blinkProg = prog;
+    _elShadow.blinkGen++;
+    el_publish();
+
+    #ifdef DG_DBG
+    Serial.printf("Empty LED: %s blink pattern (%d bytes)\n", prog ? "User" : "Standard", len);
+    #endif
+
+    return ret;
+}
+
+void EmptyLED::specialSignal(uint8_t signum) 
+{
+    _elShadow.seq = (signum && signum <= DGSEQ_MAX) ? _specialArray[signum - 1] : NULL;
+    _elShadow.seqGen++;
+    el_publish();
 }
 
 bool EmptyLED::specialDone()
 {
-    return !_specialsig;
+    return (_elSeqDoneGen == _elShadow.seqGen);
+}
+
+/*
+ * I2C job queue
+ *
+ * I2C transfers are carried out by a separate task, so the caller 
+ * (usually the main loop) does not have to wait for the transfer 
+ * to finish. Jobs are executed in order; a completion callback is 
+ * called (in the context of the I2C task) when done. Synchronous 
+ * transfers (eg. at boot) are queued, too, and waited for.
+ * If the task cannot be created, jobs are executed immediately.
+ */
+
+#define I2C_QUEUE_LEN     8
+#define I2C_ERR_FALLBACK  4       // Consecutive errors before reducing bus speed
+
+typedef struct {
+    uint32_t  clock;              // If non-zero: Only set bus speed
+    uint8_t   addr;
+    uint8_t   wrLen;
+    uint8_t   rdLen;
+    uint8_t   wrData[I2C_MAX_DATA];
+    uint8_t   *rdBuf;
+    i2cDoneCB cb;
+    void      *ctx;
+} I2CJob;
+
+typedef struct {
+    int err;
+    int rdLen;
+} I2CSyncRes;
+
+static QueueHandle_t     _i2cQueue = NULL;
+static SemaphoreHandle_t _i2cSyncSem = NULL;
+static volatile uint32_t _i2cNumJobs = 0;
+static volatile uint32_t _i2cNumErrors = 0;
+static volatile uint32_t _i2cNumDropped = 0;
+static volatile uint32_t _i2cNumNACK = 0;
+static volatile uint32_t _i2cNumTimeout = 0;
+static volatile uint32_t _i2cClock = 100000;
+static int               _i2cErrStreak = 0;
+
+static void i2c_execute(I2CJob *job)
+{
+    int err = 0, rdLen = 0;
+
+    if(job->clock) {
+        Wire.setClock(job->clock);
+        _i2cClock = job->clock;
+        _i2cErrStreak = 0;
+        if(job->cb) {
+            job->cb(0, 0, job->ctx);
+        }
+        return;
+    }
+
+    if(job->wrLen || !job->rdLen) {
+        Wire.beginTransmission(job->addr);
+        if(job->wrLen) {
+            Wire.write(job->wrData, job->wrLen);
+        }
+        err = Wire.endTransmission(true);
+    }
+
+    if(!err && job->rdLen) {
+        rdLen = Wire.requestFrom(job->addr, job->rdLen);
+        for(int i = 0; i < rdLen; i++) {
+            job->rdBuf[i] = Wire.read();
+        }
+        if(rdLen < job->rdLen) err = 4;
+    }
+
+    _i2cNumJobs++;
+    if(err) {
+        _i2cNumErrors++;
+        switch(err) {
+        case 2:             // NACK on address
+        case 3:             // NACK on data
+            _i2cNumNACK++;
+            break;
+        case 5:             // Timeout
+            _i2cNumTimeout++;
+            break;
+        }
+        // Fall back to lower speed if errors persist
+        if(++_i2cErrStreak >= I2C_ERR_FALLBACK && _i2cClock > 100000) {
+            _i2cClock = 100000;
+            Wire.setClock(_i2cClock);
+            _i2cErrStreak = 0;
+        }
+    } else {
+        _i2cErrStreak = 0;
+    }
+
+    if(job->cb) {
+        job->cb(err, rdLen, job->ctx);
+    }
+}
+
+static void i2c_task(void *arg)
+{
+    I2CJob job;
+
+    for(;;) {
+        if(xQueueReceive(_i2cQueue, &job, portMAX_DELAY) == pdTRUE) {
+            i2c_execute(&job);
+        }
+    }
+}
+
+static void i2c_syncDone(int err, int rdLen, void *ctx)
+{
+    I2CSyncRes *res = (I2CSyncRes *)ctx;
+
+    res->err = err;
+    res->rdLen = rdLen;
+    // No semaphore if running without I2C task
+    if(_i2cSyncSem) {
+        xSemaphoreGive(_i2cSyncSem);
+    }
+}
+
+static void i2c_init()
+{
+    if(_i2cQueue)
+        return;
+
+    if(!(_i2cSyncSem = xSemaphoreCreateBinary()))
+        return;
+        
+    if(!(_i2cQueue = xQueueCreate(I2C_QUEUE_LEN, sizeof(I2CJob)))) {
+        vSemaphoreDelete(_i2cSyncSem);
+        _i2cSyncSem = NULL;
+        return;
+    }
+        
+    if(xTaskCreatePinnedToCore(i2c_task, "dgi2c", 3072, NULL, 
+                               uxTaskPriorityGet(NULL) + 1, NULL, xPortGetCoreID()) != pdPASS) {
+        Serial.println("Failed to create I2C task");
+        vQueueDelete(_i2cQueue);
+        _i2cQueue = NULL;
+        vSemaphoreDelete(_i2cSyncSem);
+        _i2cSyncSem = NULL;
+    }
+}
+
+// Queue a job; returns false if queue is full (job dropped)
+static bool i2c_submit(I2CJob *job)
+{
+    if(!_i2cQueue) {
+        i2c_execute(job);
+        return true;
+    }
+    
+    if(xQueueSend(_i2cQueue, job, 0) != pdTRUE) {
+        _i2cNumDropped++;
+        return false;
+    }
+
+    return true;
+}
+
+// Queue a job and wait for it to finish; returns error
+// (as Wire.endTransmission), and number of bytes read
+static int i2c_transfer(I2CJob *job, int *rdLen = NULL)
+{
+    I2CSyncRes res = { 0, 0 };
+
+    job->cb = i2c_syncDone;
+    job->ctx = (void *)&res;
+
+    if(!_i2cQueue) {
+        i2c_execute(job);
+    } else {
+        xQueueSend(_i2cQueue, job, portMAX_DELAY);
+        xSemaphoreTake(_i2cSyncSem, portMAX_DELAY);
+    }
+
+    if(rdLen) *rdLen = res.rdLen;
+    
+    return res.err;
+}
+
+static void i2c_setupWrite(I2CJob *job, uint8_t addr)
+{
+    memset((void *)job, 0, sizeof(*job));
+    job->addr = addr;
+}
+
+/*
+ * Gauge type registry
+ * 
+ * Built-in types (above) plus user-defined ones (added through 
+ * addGaugeType(), usually read from SD at boot). For each list 
+ * (small/large), there is one array in display order (built-ins 
+ * first, then user types as added), and one sorted by id for
+ * lookup by binary search.
+ */
+
+#define NUM_GT_SMALL (sizeof(gaugeTypesSmall) / sizeof(gaugeTypesSmall[0]))
+#define NUM_GT_LARGE (sizeof(gaugeTypesLarge) / sizeof(gaugeTypesLarge[0]))
+#define GT_LIST_SIZE (((NUM_GT_SMALL > NUM_GT_LARGE) ? NUM_GT_SMALL : NUM_GT_LARGE) + GA_MAX_USERTYPES)
+
+static const struct ga_types *gtList[2][GT_LIST_SIZE];
+static const struct ga_types *gtSorted[2][GT_LIST_SIZE];
+static struct ga_types       gtUser[GA_MAX_USERTYPES];
+static char                  gtUserNames[GA_MAX_USERTYPES][GA_MAX_NAMELEN + 1];
+static int                   gtNumUser = 0;
+
+// Insert into list sorted by id
+static void gt_insertSorted(const struct ga_types **list, int num, const struct ga_types *gat)
+{
+    int i = num;
+
+    while(i > 0 && list[i - 1]->id > gat->id) {
+        list[i] = list[i - 1];
+        i--;
+    }
+    list[i] = gat;
 }
 
 /*
@@ -395,17 +864,128 @@ bool EmptyLED::specialDone()
 Gauges::Gauges()
 {
     // Set up number of defined types
-    num_types_small = sizeof(gaugeTypesSmall) / sizeof(gaugeTypesSmall[0]);
-    num_types_large = sizeof(gaugeTypesLarge) / sizeof(gaugeTypesLarge[0]);
+    num_types_small = NUM_GT_SMALL;
+    num_types_large = NUM_GT_LARGE;
+
+    for(int i = 0; i < num_types_small; i++) {
+        gtList[1][i] = &gaugeTypesSmall[i];
+        gt_insertSorted(gtSorted[1], i, &gaugeTypesSmall[i]);
+    }
+    for(int i = 0; i < num_types_large; i++) {
+        gtList[0][i] = &gaugeTypesLarge[i];
+        gt_insertSorted(gtSorted[0], i, &gaugeTypesLarge[i]);
+    }
 
     // Find max id
     max_id_small = findMaxId(gaugeTypesSmall, num_types_small);
     max_id_large = findMaxId(gaugeTypesLarge, num_types_large);
+
+    for(int i = 0; i < 3; i++) {
+        sched_init(&_swTimer[i], digSwitchDue, this);
+    }
+}
+
+/*
+ * GPIO pins usable as gauge outputs (digital and PWM):
+ * Excluded are input-only pins (34-39), the flash pins (6-11),
+ * Serial (1, 3), I2C (21, 22), SD/SPI, I2S, and the Control 
+ * Board's buttons, switches, backlights and "Empty" LED.
+ * Also excluded are the strapping pins 0, 2 (also STATUS_LED_PIN)
+ * and 15: A relay driver or meter on them can keep the ESP32 from
+ * booting, or put it into download mode. 12 is a strapping pin as
+ * well, but it is the Control Board's own gauge output, and its 
+ * circuit is laid out for this.
+ */
+static const uint8_t gaugePins[] = {
+    4, DIGITAL_GAUGE_PIN,
+    #ifndef DG_HAVEDOORSWITCH
+    DOOR_SWITCH_PIN, DOOR2_SWITCH_PIN
+    #endif
+};
+
+static bool gaugePinOK(uint8_t pin)
+{
+    for(int i = 0; i < (int)sizeof(gaugePins); i++) {
+        if(gaugePins[i] == pin) return true;
+    }
+    return false;
+}
+
+/*
+ * Add user-defined gauge type
+ * Must be called before begin(). The name is copied.
+ */
+bool Gauges::addGaugeType(bool isSmall, const struct ga_types *ngat)
+{
+    struct ga_types *gat;
+    int *num = isSmall ? &num_types_small : &num_types_large;
+    int *maxId = isSmall ? &max_id_small : &max_id_large;
+    const char *name = ngat->name;
+    char *d;
+
+    if(gtNumUser >= GA_MAX_USERTYPES) 
+        return false;
+
+    if(ngat->id < 1 || ngat->id > GA_MAX_ID || !name || !*name)
+        return false;
+
+    if(findGauge(isSmall, ngat->id)) {
+        #ifdef DG_DBG
+        Serial.printf("Gauge type id %d already defined\n", ngat->id);
+        #endif
+        return false;
+    }
+
+    switch(ngat->connectionType) {
+    case DGD_TYPE_MCP4728:
+        if(ngat->aga.maxV > 0xfff) return false;
+        break;
+    case DGD_TYPE_DIGITAL:
+        if(!gaugePinOK(ngat->dga.gpioPin)) {
+            Serial.printf("Gauge type %d: GPIO %d not usable\n", ngat->id, ngat->dga.gpioPin);
+            return false;
+        }
+        break;
+    case DGD_TYPE_PWM:
+        if(!gaugePinOK(ngat->dga.gpioPin)) {
+            Serial.printf("Gauge type %d: GPIO %d not usable\n", ngat->id, ngat->dga.gpioPin);
+            return false;
+        }
+        if(ngat->pga.freq < PWM_MIN_FREQ || ngat->pga.freq > PWM_MAX_FREQ) return false;
+        if(ngat->pga.maxDuty > PWM_MAX_DUTY) return false;
+        break;
+    default:
+        return false;
+    }
+
+    gat = &gtUser[gtNumUser];
+    d = gtUserNames[gtNumUser];
+
+    *gat = *ngat;
+    gat->aga.VRefGain &= MCP4728_VREF_GAIN_MASK;
+
+    // Copy name; skip chars that would break the CP's HTML
+    for(int i = 0; *name && i < GA_MAX_NAMELEN; name++) {
+        if(*name >= ' ' && *name != '<' && *name != '>' && *name != '&' && *name != '\'' && *name != '"') {
+            *d++ = *name;
+            i++;
+        }
+    }
+    *d = 0;
+    gat->name = gtUserNames[gtNumUser];
+
+    gt_insertSorted(gtSorted[isSmall ? 1 : 0], *num, gat);
+    gtList[isSmall ? 1 : 0][*num] = gat;
+
+    (*num)++;
+    if(gat->id > *maxId) *maxId = gat->id;
+    gtNumUser++;
+
+    return true;
 }
 
 bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
 {
-    int numMCP4728 = 0;
     uint8_t idArray[3] = { idA, idB, idC };
     int pinIdx = 0;
 
@@ -413,11 +993,15 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
         _pinIndices[i] = -1;
     }
 
+    I2CJob job;
+
+    i2c_init();
+
     // Check for MCP4728
-    Wire.beginTransmission((uint8_t)0x60);
-    if(Wire.endTransmission(true)) {
-        Wire.beginTransmission((uint8_t)0x64);
-        if(Wire.endTransmission(true)) {
+    i2c_setupWrite(&job, 0x60);
+    if(i2c_transfer(&job)) {
+        i2c_setupWrite(&job, 0x64);
+        if(i2c_transfer(&job)) {
             Serial.println("MCP4728 not found");
         } else {
             _address = 0x64;
@@ -450,13 +1034,18 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
                 _vrefGain[i] = gat->aga.VRefGain & MCP4728_VREF_GAIN_MASK;
                 _supportVarPerc[i] = true;
                 _haveMCP4728gauge = true;
-                numMCP4728++;
             } else {
                 _type[i] = DGD_TYPE_NONE;
             }
             break;
         case DGD_TYPE_DIGITAL:
-            if((_pins[i] = gat->dga.gpioPin) < 40) {
+            _pins[i] = gat->dga.gpioPin;
+            for(int j = 0; j < i; j++) {
+                if(_type[j] == DGD_TYPE_PWM && _pins[j] == _pins[i]) {
+                    _pins[i] = 255;
+                }
+            }
+            if(gaugePinOK(_pins[i])) {
                 if(_pinIndices[_pins[i]] < 0) {
                     _pinIndices[_pins[i]] = pinIdx++;
                     #ifdef DG_DBG
@@ -471,11 +1060,29 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
                 _type[i] = DGD_TYPE_NONE;
             }
             break;
+        case DGD_TYPE_PWM:
+            // PWM gauges can't share their pin
+            _pins[i] = gat->dga.gpioPin;
+            for(int j = 0; j < i; j++) {
+                if(_type[j] != DGD_TYPE_NONE && _pins[j] == _pins[i]) {
+                    _pins[i] = 255;
+                }
+            }
+            if(gaugePinOK(_pins[i])) {
+                ledcSetup(PWM_CHANNEL(i), gat->pga.freq, PWM_RES_BITS);
+                ledcAttachPin(_pins[i], PWM_CHANNEL(i));
+                ledcWrite(PWM_CHANNEL(i), 0);
+                setMax(i, gat->pga.maxDuty);
+                _supportVarPerc[i] = true;
+            } else {
+                Serial.printf("Gauge %d: Bad or used PWM pin %d\n", i, gat->dga.gpioPin);
+                _type[i] = DGD_TYPE_NONE;
+            }
+            break;
         }
           
     }
 
-    _allMCP4728 = (numMCP4728 == 3);
     _numDigPins = pinIdx;
 
     #ifdef DG_DBG
@@ -485,7 +1092,9 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
     if(_haveMCP4728) {
         uint8_t readBack[24];
 
-        readEEPROM(readBack);
+        if(readEEPROM(readBack) == 24) {
+            findBusSpeed(readBack);
+        }
         
         if(_haveMCP4728gauge) {
                 
@@ -496,13 +1105,13 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
                 #ifdef DG_DBG
                 Serial.println("Resetting MCP4728 EEPROM for current gauge config");
                 #endif
-                Wire.beginTransmission(_address);
-                Wire.write(0b01010000);   // Sequ write with EEPROM
+                i2c_setupWrite(&job, _address);
+                job.wrData[job.wrLen++] = 0b01010000;   // Sequ write with EEPROM
                 for(int i = 0; i < 4; i++) {
-                    Wire.write(_vrefGain[i] | MCP4728_POWER_DOWN);
-                    Wire.write(0x00);
+                    job.wrData[job.wrLen++] = _vrefGain[i] | MCP4728_POWER_DOWN;
+                    job.wrData[job.wrLen++] = 0x00;
                 }
-                Wire.endTransmission(true);
+                i2c_transfer(&job);
             }
             
         } else {
@@ -514,25 +1123,26 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
                 #ifdef DG_DBG
                 Serial.println("Resetting MCP4728 EEPROM to all disabled");
                 #endif
-                Wire.beginTransmission(_address);
-                Wire.write(0b01010000);   // Sequ write with EEPROM
+                i2c_setupWrite(&job, _address);
+                job.wrData[job.wrLen++] = 0b01010000;   // Sequ write with EEPROM
                 for(int i = 0; i < 4; i++) {
-                    Wire.write(MCP4728_DEFAULT);
-                    Wire.write(0x00);
+                    job.wrData[job.wrLen++] = MCP4728_DEFAULT;
+                    job.wrData[job.wrLen++] = 0x00;
                 }
-                Wire.endTransmission(true);
+                i2c_transfer(&job);
             }
 
         }
 
         // Disable channel D
-        Wire.beginTransmission(_address);
-        Wire.write(0b01000110);    // Multi-write
-        Wire.write(MCP4728_DEFAULT);
-        Wire.write(0x00);
-        Wire.endTransmission(true);
+        i2c_setupWrite(&job, _address);
+        job.wrData[job.wrLen++] = 0b01000110;    // Multi-write
+        job.wrData[job.wrLen++] = MCP4728_DEFAULT;
+        job.wrData[job.wrLen++] = 0x00;
+        i2c_transfer(&job);
     }
 
+    _dacResync = true;
     UpdateAll();
 
     return true;
@@ -541,6 +1151,7 @@ bool Gauges::begin(uint8_t idA, uint8_t idB, uint8_t idC)
 // Reset values to 0 and update display
 void Gauges::reset()
 {
+    stopMotion();
     for(int i = 0; i < 4; i++) {
         _values[i] = _perc[i] = 0;
     }
@@ -550,32 +1161,24 @@ void Gauges::reset()
 // Display all 0, bypass buffer
 void Gauges::off()
 {
-    if(_allMCP4728) {
-        Wire.beginTransmission(_address);
-        for(int i = 0; i < 3; i++) {
-            Wire.write(0b01000000 | ((i << 1) & 0x06));    // Multi-write
-            Wire.write(_vrefGain[i]);
-            Wire.write(0x00);
-        }
-        Wire.endTransmission(true);
-    } else {
-        int digcnt = 0;
-        for(int i = 0; i < 3; i++) {
-            switch(_type[i]) {
-            case DGD_TYPE_MCP4728:
-                Wire.beginTransmission(_address);
-                Wire.write(0b01000000 | ((i << 1) & 0x06));    // Multi-write
-                Wire.write(_vrefGain[i]);
-                Wire.write(0x00);
-                Wire.endTransmission(true);
-                break;
-            case DGD_TYPE_DIGITAL:
-                if(digcnt < _numDigPins) {
-                    setDigitalPin(_pins[i], LOW);
-                    digcnt++;
-                }
-                break;
+    static const uint16_t zeros[3] = { 0, 0, 0 };
+    int digcnt = 0;
+
+    stopMotion();
+    
+    sendDAC(zeros);
+    
+    for(int i = 0; i < 3; i++) {
+        switch(_type[i]) {
+        case DGD_TYPE_DIGITAL:
+            if(digcnt < _numDigPins) {
+                setDigitalPin(_pins[i], LOW);
+                digcnt++;
             }
+            break;
+        case DGD_TYPE_PWM:
+            ledcWrite(PWM_CHANNEL(i), 0);
+            break;
         }
     }
 }
@@ -603,28 +1206,24 @@ bool Gauges::supportVariablePercentage(uint8_t index)
 }
 
 // Set percent value for gauge in buffer (do not update display)
+// Stops motion on this gauge.
 void Gauges::setValuePercent(uint8_t index, uint8_t perc)
 {
-    uint16_t newVal;
-
     index &= 0x03;
 
     if(perc > 100) perc = 100;
-    _perc[index] = perc;
 
-    switch(_type[index]) {
-    case DGD_TYPE_MCP4728:
-        newVal = _max[index] * perc / 100;
-        if(newVal > _max[index]) newVal = _max[index];
-        _values[index] = newVal;
-        #ifdef DG_DBG
-        Serial.printf("Gauge %d: %d%%, val %x\n", index, perc, newVal);
-        #endif
-        break;
-    case DGD_TYPE_DIGITAL:
-        _values[index] = _perc[index];
-        break;
+    if(index < 3) {
+        _mot[index].active = false;
+        _mot[index].pos = perc;
+        _mot[index].vel = 0.0f;
     }
+
+    setValue(index, perc);
+
+    #ifdef DG_DBG
+    Serial.printf("Gauge %d: %d%%, val %x\n", index, perc, _values[index]);
+    #endif
 }
 
 uint8_t Gauges::getValuePercent(uint8_t index)
@@ -637,35 +1236,21 @@ uint8_t Gauges::getValuePercent(uint8_t index)
 // Update the display
 void Gauges::UpdateAll()
 {
-    if(_allMCP4728) {
-        Wire.beginTransmission(_address);   // Send all values to DACs
-        for(int i = 0; i < 3; i++) {
-            Wire.write(0b01000000 | ((i << 1) & 0x06));    // Multi-write
-            Wire.write((_values[i] >> 8) | _vrefGain[i]);
-            Wire.write(_values[i] & 0xff);
-            #ifdef DG_DBG
-            Serial.printf("i %d: %x %x\n", i, (_values[i] >> 8) | _vrefGain[i], _values[i] & 0xff);
-            #endif
-        }
-        Wire.endTransmission(true);
-    } else {
-        int digcnt = 0;
-        for(int i = 0; i < 3; i++) {
-            switch(_type[i]) {
-            case DGD_TYPE_MCP4728:
-                Wire.beginTransmission(_address);   // Send value to DAC
-                Wire.write(0b01000000 | ((i << 1) & 0x06));    // Multi-write
-                Wire.write((_values[i] >> 8) | _vrefGain[i]);
-                Wire.write(_values[i] & 0xff);
-                Wire.endTransmission(true);
-                break;
-            case DGD_TYPE_DIGITAL:
-                if(digcnt < _numDigPins) {
-                    setDigitalPin(_pins[i], (_values[i] > _thresholds[i]) ? HIGH : LOW);
-                    digcnt++;
-                }
-                break;
+    int digcnt = 0;
+    
+    sendDAC(_values);
+    
+    for(int i = 0; i < 3; i++) {
+        switch(_type[i]) {
+        case DGD_TYPE_DIGITAL:
+            if(digcnt < _numDigPins) {
+                setDigitalPin(_pins[i], (_values[i] > _thresholds[i]) ? HIGH : LOW);
+                digcnt++;
             }
+            break;
+        case DGD_TYPE_PWM:
+            ledcWrite(PWM_CHANNEL(i), _values[i]);
+            break;
         }
     }
 }
@@ -683,33 +1268,89 @@ int Gauges::findMaxId(const struct ga_types *gat, int num)
 
 const struct ga_types *Gauges::getGTStruct(bool isSmall, int index)
 {
-    if(isSmall) {
-        if(index >= num_types_small) return NULL;
-        return &gaugeTypesSmall[index];
-    } else {
-        if(index >= num_types_large) return NULL;
-        return &gaugeTypesLarge[index];
+    if(index < 0 || index >= (isSmall ? num_types_small : num_types_large)) 
+        return NULL;
+        
+    return gtList[isSmall ? 1 : 0][index];
+}
+
+/*
+ * Motion
+ *
+ * moveTo() moves a gauge's pointer to a given percentage within a given 
+ * time, following an easing curve. The resulting (commanded) position is 
+ * additionally filtered through a critically damped spring model, which 
+ * simulates the inertia of a real needle (overshoot-free, "heavy" start 
+ * and landing). 
+ * Since the DAC can't be accessed from interrupt context, motion is 
+ * advanced in loop(), in fixed intervals of DGM_TICK_MS; all changed 
+ * values are sent in one go, so I2C traffic is limited to one update 
+ * per interval regardless of how many gauges are moving.
+ * Digital gauges follow the (virtual) percentage and switch at their
+ * threshold, as before.
+ */
+
+void Gauges::moveTo(uint8_t index, uint8_t perc, unsigned long duration, uint8_t ease)
+{
+    struct dgMotion *m;
+    
+    if(index >= 3) return;
+
+    if(perc > 100) perc = 100;
+
+    m = &_mot[index];
+
+    if(!duration) {
+        setValuePercent(index, perc);
+        return;
     }
+
+    if(!m->active) {
+        m->pos = _perc[index];
+        m->vel = 0.0f;
+    }
+    m->from = m->pos;
+    m->to = perc;
+    m->start = millis();
+    m->dur = duration;
+    m->ease = ease;
+    m->active = true;
 }
 
-void Gauges::loop()
+bool Gauges::isMoving(uint8_t index)
+{
+    if(index >= 3) return false;
+    
+    return _mot[index].active;
+}
+
+// Stop all motion, pointers remain where they are
+void Gauges::stopMotion()
 {
     for(int i = 0; i < 3; i++) {
-        if(_type[i] == DGD_TYPE_DIGITAL) {
-            int pidx = _pinIndices[_pins[i]];
-            if(pidx >= 0 && _scheduled[pidx]) {
-                if(millis() >= _scheduled[pidx]) {
-                    digitalWrite(_pins[i], _desiredState[pidx]);
-                    _lastState[pidx] = _desiredState[pidx];
-                    _lastStateChg[pidx] = millis();
-                    _scheduled[pidx] = 0;
-                    #ifdef DG_DBG
-                    Serial.printf("Executing scheduled switch to %d on pin %d\n", _desiredState[pidx], _pins[i]);
-                    #endif
-                }
-            }
+        _mot[i].active = false;
+        _mot[i].vel = 0.0f;
+    }
+}
+
+// Needle inertia as time constant in ms; 0 = none
+void Gauges::setInertia(uint16_t timeConst)
+{
+    _inertia = (float)timeConst / 1000.0f;
+}
+
+void Gauges::loop()
+{
+    unsigned long now = millis();
+    
+    if(now - _lastMotTick >= DGM_TICK_MS) {
+        if(motionTick(now)) {
+            UpdateAll();
         }
+        _lastMotTick = now;
     }
+
+    // Scheduled digital gauge changes are run by sched_run()
 }
 
 
@@ -720,32 +1361,299 @@ void Gauges::setMax(int8_t index, uint16_t maxVal)
 {
     switch(_type[index]) {
     case DGD_TYPE_MCP4728:    // Set max value written to DAC
+    case DGD_TYPE_PWM:        // Set max duty cycle
         if(maxVal > 0xfff) maxVal = 0xfff;
 
         index &= 0x03;
         
         _max[index] = maxVal;
+        if(index < 3) {
+            buildLUT(index, NULL, NULL, 0);
+        }
         break;
     }
 }
 
+/*
+ * Calibration curves
+ * 
+ * Real meters are often not linear. A calibration curve maps the 
+ * percentage on the scale to the percentage of the max voltage. 
+ * It is given as a list of "scale:voltage" pairs, in percent, for 
+ * instance "25:15,50:40,75:70". Points are linearly interpolated; 
+ * 0:0 and 100:100 are implied unless given. Scale values must be 
+ * ascending, voltage values must not decrease. Empty means linear.
+ * The curve is turned into a lookup table of DAC values for each 
+ * integer percentage, so evaluating it is cheap.
+ */
+#define DG_CAL_MAXPTS 12
+
+bool Gauges::setCalibration(uint8_t index, const char *curve)
+{
+    uint8_t x[DG_CAL_MAXPTS + 2], y[DG_CAL_MAXPTS + 2];
+    int num = 0, pts = 0;
+    const char *p = curve;
+
+    if(index >= 3 || !_supportVarPerc[index])
+        return false;
+
+    while(p && *p) {
+        int a, b;
+        
+        while(*p == ' ' || *p == ',') p++;
+        if(!*p) break;
+
+        if(*p < '0' || *p > '9') goto badcurve;
+        a = atoi(p);
+        while(*p >= '0' && *p <= '9') p++;
+        if(*p++ != ':') goto badcurve;
+        if(*p < '0' || *p > '9') goto badcurve;
+        b = atoi(p);
+        while(*p >= '0' && *p <= '9') p++;
+
+        // Implied 0:0 and 100:100 do not count
+        if(a > 100 || b > 100 || ++pts > DG_CAL_MAXPTS) goto badcurve;
+
+        if(!num && a) {
+            x[num] = y[num] = 0;
+            num++;
+        }
+        if(num && (a <= x[num-1] || b < y[num-1])) goto badcurve;
+        x[num] = a;
+        y[num] = b;
+        num++;
+    }
+
+    if(num && x[num-1] < 100) {
+        x[num] = y[num] = 100;
+        num++;
+    }
+
+    buildLUT(index, x, y, num);
+
+    return true;
+
+badcurve:
+    Serial.printf("Gauge %d: Bad calibration curve, using linear\n", index);
+    buildLUT(index, NULL, NULL, 0);
+    return false;
+}
+
+void Gauges::buildLUT(uint8_t index, const uint8_t *x, const uint8_t *y, int num)
+{
+    int seg = 0;
+
+    for(int i = 0; i <= 100; i++) {
+        float v = (float)i;
+
+        if(num >= 2) {
+            while(seg < num - 2 && i > x[seg + 1]) seg++;
+            v = (float)y[seg] + (float)(y[seg + 1] - y[seg]) * (float)(i - x[seg]) / (float)(x[seg + 1] - x[seg]);
+        }
+
+        _lut[index][i] = (uint16_t)((float)_max[index] * v / 100.0f + 0.5f);
+        if(_lut[index][i] > _max[index]) _lut[index][i] = _max[index];
+    }
+}
+
 const struct ga_types *Gauges::findGauge(bool isSmall, int id)
 {
-    if(isSmall) {
-        for(int i = 0; i < num_types_small; i++) {
-            if(id == gaugeTypesSmall[i].id) {
-                return &gaugeTypesSmall[i];
+    const struct ga_types **list = gtSorted[isSmall ? 1 : 0];
+    int lo = 0, hi = (isSmall ? num_types_small : num_types_large) - 1;
+
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if(list[mid]->id == id) return list[mid];
+        if(list[mid]->id < id) lo = mid + 1;
+        else                   hi = mid - 1;
+    }
+
+    return NULL;
+}
+
+/*
+ * Send values to DAC, but only if any of them has changed since
+ * last time. 
+ * Changed channels are sent by "multi-write", which also sets
+ * VRef/Gain. With MCP4728_FASTWRITE, the first transfer after 
+ * begin() (or a failure) sends all gauge channels by multi-write, 
+ * all later ones use "fast write", which updates all four channels 
+ * in one 8-byte transaction (channels not used by gauges are kept 
+ * powered down).
+ */
+void Gauges::sendDAC(const uint16_t *vals)
+{
+    I2CJob job;
+    uint32_t failGen = __atomic_load_n(&_dacFailGen, __ATOMIC_ACQUIRE);
+    // Not synced if asked to resend, or if a transfer failed since last send
+    bool synced = !_dacResync && (failGen == _dacSeenFail);
+    bool dirty = !synced;
+
+    if(!_haveMCP4728gauge)
+        return;
+
+    for(int i = 0; i < 3 && !dirty; i++) {
+        if(_type[i] == DGD_TYPE_MCP4728 && vals[i] != _dacSent[i]) {
+            dirty = true;
+        }
+    }
+
+    if(!dirty)
+        return;
+
+    i2c_setupWrite(&job, _address);
+    
+    #ifdef MCP4728_FASTWRITE
+    if(synced) {
+        for(int i = 0; i < 4; i++) {
+            if(i < 3 && _type[i] == DGD_TYPE_MCP4728) {
+                job.wrData[job.wrLen++] = (vals[i] >> 8) & 0x0f;     // Fast write
+                job.wrData[job.wrLen++] = vals[i] & 0xff;
+            } else {
+                job.wrData[job.wrLen++] = MCP4728_FW_POWER_DOWN;
+                job.wrData[job.wrLen++] = 0x00;
             }
         }
-    } else {
-        for(int i = 0; i < num_types_large; i++) {
-            if(id == gaugeTypesLarge[i].id) {
-                return &gaugeTypesLarge[i];
+    } else
+    #endif
+    {
+        for(int i = 0; i < 3; i++) {
+            if(_type[i] == DGD_TYPE_MCP4728 && (!synced || vals[i] != _dacSent[i])) {
+                job.wrData[job.wrLen++] = 0b01000000 | ((i << 1) & 0x06);    // Multi-write
+                job.wrData[job.wrLen++] = (vals[i] >> 8) | _vrefGain[i];
+                job.wrData[job.wrLen++] = vals[i] & 0xff;
+                #ifdef DG_DBG
+                Serial.printf("i %d: %x %x\n", i, (vals[i] >> 8) | _vrefGain[i], vals[i] & 0xff);
+                #endif
             }
         }
     }
 
-    return NULL;
+    job.cb = dacDone;
+    job.ctx = (void *)this;
+
+    // Update before submitting; dacDone() might be
+    // called before i2c_submit() returns. A failure
+    // reported after we read _dacFailGen above bumps
+    // it again, so it is not lost.
+    for(int i = 0; i < 3; i++) {
+        _dacSent[i] = vals[i];
+    }
+    _dacSeenFail = failGen;
+    _dacResync = false;
+    
+    if(!i2c_submit(&job)) {
+        // Queue full: Resend all next time
+        _dacResync = true;
+    }
+}
+
+// Called from I2C task
+void Gauges::dacDone(int err, int rdLen, void *ctx)
+{
+    if(err) {
+        // Failed: Resend all (using multi-write) next time
+        __atomic_add_fetch(&((Gauges *)ctx)->_dacFailGen, 1, __ATOMIC_RELEASE);
+    }
+}
+
+void Gauges::getI2CStats(struct dgI2CStats *st)
+{
+    st->clock = _i2cClock;
+    st->jobs = _i2cNumJobs;
+    st->errors = _i2cNumErrors;
+    st->nacks = _i2cNumNACK;
+    st->timeouts = _i2cNumTimeout;
+    st->dropped = _i2cNumDropped;
+}
+
+// Set (fractional) percent value in buffer
+void Gauges::setValue(uint8_t index, float perc)
+{
+    uint16_t newVal;
+
+    if(perc < 0.0f) perc = 0.0f;
+    else if(perc > 100.0f) perc = 100.0f;
+    
+    _perc[index] = (uint8_t)(perc + 0.5f);
+
+    switch(_type[index]) {
+    case DGD_TYPE_MCP4728:
+    case DGD_TYPE_PWM:
+        if(index < 3) {
+            int i = (int)perc;
+            if(i >= 100) {
+                newVal = _lut[index][100];
+            } else {
+                newVal = _lut[index][i] + (uint16_t)((float)(_lut[index][i + 1] - _lut[index][i]) * (perc - (float)i) + 0.5f);
+            }
+        } else {
+            newVal = (uint16_t)((float)_max[index] * perc / 100.0f + 0.5f);
+        }
+        if(newVal > _max[index]) newVal = _max[index];
+        _values[index] = newVal;
+        break;
+    case DGD_TYPE_DIGITAL:
+        _values[index] = _perc[index];
+        break;
+    }
+}
+
+// Advance motion; returns true if any value has changed
+bool Gauges::motionTick(unsigned long now)
+{
+    bool changed = false;
+    float dt = (float)(now - _lastMotTick) / 1000.0f;
+
+    // Limit dt after pauses (eg. blocking operations); inertia
+    // model is skipped if dt too large for a stable result
+    if(dt > 0.1f) dt = 0.1f;
+    
+    for(int i = 0; i < 3; i++) {
+        struct dgMotion *m = &_mot[i];
+        float t, e, cmd;
+        uint16_t oldVal;
+
+        if(!m->active) continue;
+
+        // Commanded position on easing curve
+        t = (now - m->start >= m->dur) ? 1.0f : (float)(now - m->start) / (float)m->dur;
+        switch(m->ease) {
+        case DGM_EASE_IN:
+            e = t * t;
+            break;
+        case DGM_EASE_OUT:
+            e = t * (2.0f - t);
+            break;
+        case DGM_EASE_INOUT:
+            e = (t < 0.5f) ? 2.0f * t * t : -1.0f + (4.0f - 2.0f * t) * t;
+            break;
+        default:
+            e = t;
+        }
+        cmd = m->from + (m->to - m->from) * e;
+
+        // Needle inertia: critically damped spring towards cmd
+        if(_supportVarPerc[i] && _inertia > dt * 2.0f) {
+            float w = 1.0f / _inertia;
+            m->vel += ((w * w) * (cmd - m->pos) - (2.0f * w * m->vel)) * dt;
+            m->pos += m->vel * dt;
+        } else {
+            m->pos = cmd;
+        }
+
+        if(t >= 1.0f && fabsf(m->to - m->pos) < 0.05f && fabsf(m->vel) < 1.0f) {
+            m->pos = m->to;
+            m->vel = 0.0f;
+            m->active = false;
+        }
+
+        oldVal = _values[i];
+        setValue(i, m->pos);
+        if(_values[i] != oldVal) changed = true;
+    }
+
+    return changed;
 }
 
 void Gauges::setDigitalPin(uint8_t pin, uint8_t state)
@@ -766,8 +1674,9 @@ void Gauges::setDigitalPin(uint8_t pin, uint8_t state)
     if(state != _lastState[pidx]) {
         if(elapsed < DIG_SWITCH_MIN_TIME) {
             _desiredState[pidx] = state;
-            if(!_scheduled[pidx]) {
-                _scheduled[pidx] = now + (DIG_SWITCH_MIN_TIME - elapsed);
+            if(!sched_armed(&_swTimer[pidx])) {
+                _swTimer[pidx].id = pin;
+                sched_start(&_swTimer[pidx], _lastStateChg[pidx], DIG_SWITCH_MIN_TIME);
                 #ifdef DG_DBG
                 Serial.printf("Scheduled switch to %d for gauge pin %d\n", state, pin);
                 #endif
@@ -786,23 +1695,85 @@ void Gauges::setDigitalPin(uint8_t pin, uint8_t state)
         _lastState[pidx] = state;
         _lastStateChg[pidx] = now;
     }
-    _scheduled[pidx] = 0;
+    sched_stop(&_swTimer[pidx]);
+}
+
+// Timer callback: Execute scheduled switch
+void Gauges::digSwitchDue(struct schedTimer *t, unsigned long now)
+{
+    Gauges *g = (Gauges *)t->arg;
+    uint8_t pin = t->id;
+    int pidx = g->_pinIndices[pin];
+
+    digitalWrite(pin, g->_desiredState[pidx]);
+    g->_lastState[pidx] = g->_desiredState[pidx];
+    g->_lastStateChg[pidx] = now;
+    
+    #ifdef DG_DBG
+    Serial.printf("Executing scheduled switch to %d on pin %d\n", g->_desiredState[pidx], pin);
+    #endif
+}
+
+/*
+ * Try Fast-mode (400kHz); it is used if two EEPROM readbacks match 
+ * the one made at 100kHz. Otherwise, stay at 100kHz.
+ * Fast-mode Plus (1MHz) is not tried: The MCP4728 does not support
+ * it (max 400kHz, or 3.4MHz in High-speed mode, which needs a special
+ * master code), and the readback check can't detect garbled writes.
+ */
+void Gauges::findBusSpeed(const uint8_t *refBuf)
+{
+    static const uint32_t speeds[] = { 400000, 100000 };
+    uint8_t buf[24];
+    I2CJob job;
+
+    for(int i = 0; i < (int)(sizeof(speeds) / sizeof(speeds[0])); i++) {
+        bool ok = true;
+
+        i2c_setupWrite(&job, 0);
+        job.clock = speeds[i];
+        i2c_transfer(&job);
+
+        if(speeds[i] == 100000) 
+            break;
+
+        for(int j = 0; j < 2 && ok; j++) {
+            int i2clen = 0;
+            memset(buf, 0, sizeof(buf));
+            i2c_setupWrite(&job, _address);
+            job.rdLen = 24;
+            job.rdBuf = buf;
+            if(i2c_transfer(&job, &i2clen) || i2clen != 24 || memcmp(buf, refBuf, 24)) {
+                ok = false;
+            }
+        }
+        
+        if(ok) break;
+    }
+
+    #ifdef DG_DBG
+    Serial.printf("I2C bus speed %d\n", (int)_i2cClock);
+    #endif
 }
 
 int Gauges::readEEPROM(uint8_t *buf)
 {
+    I2CJob job;
+    int i2clen = 0;
+
     // Read EEPROM
-    int i2clen = Wire.requestFrom(_address, (uint8_t)24);
+    i2c_setupWrite(&job, _address);
+    job.rdLen = 24;
+    job.rdBuf = buf;
+    i2c_transfer(&job, &i2clen);
+    
     if(i2clen < 24) {
         Serial.printf("Error: Can only read back %d bytes from MCP4728 DAC\n", i2clen);
     }
+    #ifdef DG_DBG
     for(int i = 0; i < min(24, i2clen); i++) {
-        buf[i] = Wire.read();
-        #ifdef DG_DBG
         Serial.printf("0x%02x ", buf[i]);
-        #endif
     }
-    #ifdef DG_DBG
     Serial.println("");
     #endif
 
@@ -55,6 +55,8 @@
 #ifndef _DGDISPLAY_H
 #define _DGDISPLAY_H
 
+#include "dg_sched.h"
+
 /*
  * Empty LED class
  */
@@ -63,18 +65,18 @@ class EmptyLED {
 
     public:
 
-        EmptyLED(uint8_t timer_no);
-        void begin(uint8_t pin);
+        EmptyLED();
+        void begin(uint8_t pin, bool usePWM = true);
         
         void startBlink(uint16_t ticks, uint16_t delayTicks);
         void stopBlink();
+        bool setBlinkPattern(const char *pat);
 
         void specialSignal(uint8_t signum);
         bool specialDone();
         
     private:
-        hw_timer_t *_DGTimer_Cfg = NULL;
-        uint8_t _timer_no;
+        bool _running = false;
         
 };
 
@@ -85,6 +87,14 @@ class EmptyLED {
 #define DGSEQ_UPDAVAIL   5
 #define DGSEQ_MAX        DGSEQ_UPDAVAIL
 
+// Empty LED PWM (LEDC channel 0; uses LEDC timer 0)
+#define EL_PWM_CHANNEL   0
+#define EL_PWM_FREQ      5000
+#define EL_PWM_RES_BITS  8
+
+// Max size of user-defined blink pattern (bytecode)
+#define EL_MAX_PROG      64
+
 /*
  * Gauges Class
  */
@@ -94,10 +104,15 @@ struct dacGauge {               // DGD_TYPE_MCP4728:
     uint8_t  VRefGain;          // Int/Ext VRef; Gain flags
 };
 
-struct binGauge {               // DGD_TYPE_DIGITAL:
+struct binGauge {               // DGD_TYPE_DIGITAL, DGD_TYPE_PWM:
     uint8_t gpioPin;            // GPIO pin for digitial output
 };
 
+struct pwmGauge {               // DGD_TYPE_PWM:
+    uint16_t freq;              // PWM frequency (Hz)
+    uint16_t maxDuty;           // max duty cycle (0-1023)
+};
+
 struct ga_types {
     int  id;                    // ID
     const char *name;           // Name to show
@@ -105,13 +120,29 @@ struct ga_types {
     uint8_t connectionType;     // Connection type
 
     struct dacGauge aga;        // Data for analog gauges
-    struct binGauge dga;        // Data for digital gauges
+    struct binGauge dga;        // Data for digital (and PWM) gauges
+    struct pwmGauge pga;        // Data for PWM gauges
 };
 
+// Limits for user-defined gauge types
+#define GA_MAX_ID           99
+#define GA_MAX_USERTYPES    16
+#define GA_MAX_NAMELEN      39
+
 // Connection type
 #define DGD_TYPE_NONE       0
 #define DGD_TYPE_MCP4728    1
 #define DGD_TYPE_DIGITAL    2
+#define DGD_TYPE_PWM        3
+
+// DGD_TYPE_PWM: LEDC channels (one per gauge) and resolution
+// Channels are two apart, as each pair of channels shares a timer
+#define PWM_CHANNEL_BASE    2
+#define PWM_CHANNEL(i)      (PWM_CHANNEL_BASE + ((i) << 1))
+#define PWM_RES_BITS        10
+#define PWM_MAX_DUTY        ((1 << PWM_RES_BITS) - 1)
+#define PWM_MIN_FREQ        100
+#define PWM_MAX_FREQ        40000
 
 // DGD_TYPE_MCP4728: VRefGain
 #define MCP4728_VREF_INT       0x80    // Vref = 2.048V / 4.096V (depending on GAIN)
@@ -122,10 +153,51 @@ struct ga_types {
 #define MCP4728_VREF_GAIN_MASK (MCP4728_VREF_INT|MCP4728_GAIN_HIGH)
 #define MCP4728_DEFAULT        (MCP4728_VREF_INT|MCP4728_POWER_DOWN)
 #define MCP4728_DEFAULT_MASK   (MCP4728_VREF_INT|MCP4728_POWER_DOWN|MCP4728_GAIN_HIGH)
+#define MCP4728_FW_POWER_DOWN  0x30    // Power down bits in "fast write" format
+
+// Use "fast write" for DAC updates. This requires the LDAC pin
+// to be LOW (as on the Adafruit MCP4728 breakout); otherwise, the
+// outputs never change. Off by default, since LDAC wiring on the
+// Control Board is not guaranteed; multi-write of only the changed
+// channels costs 4-10 bytes per update vs. 9 for fast write, and a
+// General Call Update (for LDAC high) would eat up the difference.
+//#define MCP4728_FASTWRITE
 
 // Minimum time between state changes for digital gauges
 #define DIG_SWITCH_MIN_TIME 1500
 
+// Gauge motion: Easing curves
+#define DGM_EASE_LINEAR     0
+#define DGM_EASE_IN         1     // slow start
+#define DGM_EASE_OUT        2     // slow end
+#define DGM_EASE_INOUT      3     // slow start and end
+
+// Gauge motion: Update interval (max one DAC transaction per interval)
+#define DGM_TICK_MS         20
+// Gauge motion: Default needle inertia (time constant in ms)
+#define DGM_INERTIA         80
+
+// I2C job queue
+#define I2C_MAX_DATA        12
+typedef void (*i2cDoneCB)(int err, int rdLen, void *ctx);
+
+struct dgI2CStats {
+    uint32_t clock;
+    uint32_t jobs;
+    uint32_t errors;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t dropped;
+};
+
+struct dgMotion {
+    float         from, to;     // percent
+    float         pos, vel;     // needle position (percent), velocity (percent/s)
+    unsigned long start, dur;
+    uint8_t       ease;
+    bool          active;
+};
+
 class Gauges {
 
     public:
@@ -142,31 +214,48 @@ class Gauges {
 
         void setBinGaugeThreshold(uint8_t index, uint8_t thres);
 
+        bool setCalibration(uint8_t index, const char *curve);
+
         bool supportVariablePercentage(uint8_t index);
         void setValuePercent(uint8_t index, uint8_t perc);
         uint8_t getValuePercent(uint8_t index);
 
+        void moveTo(uint8_t index, uint8_t perc, unsigned long duration, uint8_t ease = DGM_EASE_LINEAR);
+        bool isMoving(uint8_t index);
+        void stopMotion();
+        void setInertia(uint16_t timeConst);
+
         void UpdateAll();
 
         const struct ga_types *getGTStruct(bool isSmall, int index);
+        bool addGaugeType(bool isSmall, const struct ga_types *gat);
+
+        void getI2CStats(struct dgI2CStats *st);
 
         int num_types_small, max_id_small;
         int num_types_large, max_id_large;
                
     private:
         void setMax(int8_t index, uint16_t maxVal);
+        void buildLUT(uint8_t index, const uint8_t *x, const uint8_t *y, int num);
         int findMaxId(const struct ga_types *gat, int num);
         const struct ga_types *findGauge(bool isSmall, int id);
 
         void setDigitalPin(uint8_t pin, uint8_t state);
+        static void digSwitchDue(struct schedTimer *t, unsigned long now);
+
+        void sendDAC(const uint16_t *vals);
+        static void dacDone(int err, int rdLen, void *ctx);
+        void setValue(uint8_t index, float perc);
+        bool motionTick(unsigned long now);
 
         int  readEEPROM(uint8_t *buf);
+        void findBusSpeed(const uint8_t *refBuf);
         
         uint8_t _type[3];
 
         bool _haveMCP4728 = false;
         bool _haveMCP4728gauge = false;
-        bool _allMCP4728 = false;
         int  _numDigPins = 0;
 
         bool _supportVarPerc[4] = { false, false, false, false };
@@ -177,7 +266,12 @@ class Gauges {
         // For DGD_TYPE_MCP4728:
         uint8_t _address     = 255;
         uint16_t _max[4]     = { 0, 0, 0, 0 };
+        uint16_t _lut[3][101];
         uint8_t _vrefGain[4] = { MCP4728_DEFAULT, MCP4728_DEFAULT, MCP4728_DEFAULT, MCP4728_DEFAULT };
+        uint16_t _dacSent[3] = { 0, 0, 0 };
+        bool _dacResync = true;             // Resend all channels next time
+        uint32_t _dacSeenFail = 0;          // _dacFailGen as of last send
+        volatile uint32_t _dacFailGen = 0;  // Failed transfers (I2C task)
 
         // For DGD_TYPE_DIGITAL
         uint8_t _pins[4]       = { 255, 255, 255, 255 };
@@ -187,7 +281,12 @@ class Gauges {
         uint8_t       _lastState[3]    = { 0, 0, 0 };
         uint8_t       _desiredState[3] = { 0, 0, 0 };
         unsigned long _lastStateChg[3] = { 0, 0, 0 };
-        unsigned long _scheduled[3]    = { 0, 0, 0 };
+        struct schedTimer _swTimer[3];
+
+        // Motion
+        struct dgMotion _mot[3];
+        float         _inertia = (float)DGM_INERTIA / 1000.0f;
+        unsigned long _lastMotTick = 0;
 };
 
 #endif
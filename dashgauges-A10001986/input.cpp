@@ -53,8 +53,10 @@
  */
 
 #include <Arduino.h>
+#include <soc/gpio_reg.h>
 
 #include "input.h"
+#include "dg_sched.h"
 
 
 /*
@@ -65,8 +67,25 @@
  * reported immediately (after PressTicks have elapsed), regardless of a button
  * release. The latter mode is used for when the TCD is connected to trigger
  * time travels.
+ * 
+ * All inputs are sampled by a tick job every DGB_SAMPLE_MS, from one 
+ * snapshot of the GPIO input registers, and debounced all at once by a
+ * vertical counter: A bit changes its debounced state after four 
+ * consecutive samples at the new level. Debounced changes are put into 
+ * a per-button ring, timestamped with the time of the last actual edge
+ * (as captured by a GPIO interrupt). scan() feeds them to the state 
+ * machine in order, so press durations are measured from the edge times,
+ * even if scan() is called late.
  */
 
+static DGButton *buttons[DGB_MAX_BUTTONS];
+static volatile int numButtons = 0;
+
+// Vertical counter, owned by tick job
+static int      vcNum = 0;
+static uint32_t vcState = 0;
+static uint32_t vcCnt0 = 0xffffffff, vcCnt1 = 0xffffffff;
+
 /* pin: The pin to be used
  * activeLow: Set to true when the input level is LOW when the button is pressed, Default is true.
  * pullupActive: Activate the internal pullup when available. Default is true.
@@ -82,7 +101,98 @@ DGButton::DGButton(const int pin, const bool activeLow, const bool pullupActive)
 
 void DGButton::begin()
 {
+    int num = numButtons;
+    
     pinMode(_pin, _pullupActive ? INPUT_PULLUP : INPUT);
+
+    _evActive = _active = (digitalRead(_pin) == _buttonPressed);
+    _edgeHead = _edgeTail = 0;
+    _edgeOverflow = false;
+    _lastEdge = millis();
+
+    for(int i = 0; i < num; i++) {
+        if(buttons[i] == this) return;
+    }
+
+    attachInterruptArg(digitalPinToInterrupt(_pin), edgeISR, this, CHANGE);
+
+    if(num < DGB_MAX_BUTTONS) {
+        buttons[num] = this;
+        if(!num) {
+            tick_addJob(sampleAll, NULL, DGB_SAMPLE_MS);
+        }
+        __atomic_store_n(&numButtons, num + 1, __ATOMIC_RELEASE);
+    }
+}
+
+// GPIO ISR: Record edge time
+void IRAM_ATTR DGButton::edgeISR(void *arg)
+{
+    ((DGButton *)arg)->_lastEdge = millis();
+}
+
+// Tick job: Sample and debounce inputs of all buttons
+void DGButton::sampleAll(void *arg)
+{
+    int num = __atomic_load_n(&numButtons, __ATOMIC_ACQUIRE);
+    uint64_t in = ((uint64_t)REG_READ(GPIO_IN1_REG) << 32) | REG_READ(GPIO_IN_REG);
+    unsigned long now = millis();
+    uint32_t raw = 0, chg;
+
+    for(int i = 0; i < num; i++) {
+        if((int)((in >> buttons[i]->_pin) & 1) == buttons[i]->_buttonPressed) {
+            raw |= (1 << i);
+        }
+    }
+
+    // New buttons start with their current level
+    for(; vcNum < num; vcNum++) {
+        uint32_t m = (1 << vcNum);
+        vcState = (vcState & ~m) | (raw & m);
+    }
+
+    // Vertical counter: Count samples differing from debounced
+    // state, reset count on samples equal to it; toggle state
+    // when count rolls over.
+    chg = raw ^ vcState;
+    vcCnt0 = ~(vcCnt0 & chg);
+    vcCnt1 = vcCnt0 ^ (vcCnt1 & chg);
+    chg &= vcCnt0 & vcCnt1;
+    vcState ^= chg;
+
+    for(int i = 0; chg; i++, chg >>= 1) {
+        if(chg & 1) {
+            buttons[i]->pushEdge(!!(vcState & (1 << i)), now);
+        }
+    }
+}
+
+// Put debounced change in ring (tick job)
+void DGButton::pushEdge(bool active, unsigned long now)
+{
+    uint8_t head = _edgeHead;
+    uint8_t next = (head + 1) & (DGB_EDGE_RING - 1);
+    unsigned long edge = _lastEdge;
+
+    // Use time of last edge if it belongs to this change
+    unsigned long etime = (now - edge <= DGB_SAMPLE_MS * 5) ? edge : now - (DGB_SAMPLE_MS * 3);
+
+    _active = active;
+
+    // Change hook bypasses the state machine
+    if(_changeFunc) {
+        _changeFunc(active, etime, _changeArg);
+        return;
+    }
+    
+    if(next == __atomic_load_n(&_edgeTail, __ATOMIC_ACQUIRE)) {
+        _edgeOverflow = true;
+        return;
+    }
+
+    _edges[head].time = etime;
+    _edges[head].active = active;
+    __atomic_store_n(&_edgeHead, next, __ATOMIC_RELEASE);
 }
 
 // Setup buttom timin:
@@ -128,12 +238,57 @@ void DGButton::attachELongPressStop(void (*newFunction)(void))
     _elongPressStopFunc = newFunction;
 }
 
-// Check input of the pin and advance the state machine
+// Register function for debounced level changes. Called from the
+// tick job (not the main loop), and replaces the state machine for
+// this button. Must be registered before begin().
+void DGButton::attachChange(void (*newFunction)(bool active, unsigned long edgeTime, void *arg), void *arg)
+{
+    _changeArg = arg;
+    _changeFunc = newFunction;
+}
+
+// Feed captured edges to the state machine, then advance it to now
 void DGButton::scan(void)
 {
-    unsigned long now = millis();
-    unsigned long waitTime = now - _startTime;
-    bool active = (digitalRead(_pin) == _buttonPressed);
+    uint8_t tail = _edgeTail;
+    uint8_t head = __atomic_load_n(&_edgeHead, __ATOMIC_ACQUIRE);
+    unsigned long now;
+
+    while(tail != head) {
+        DGBEdge *e = &_edges[tail];
+        // Let timed transitions happen up to the edge, then the edge
+        step(_evActive, e->time);
+        _evActive = e->active;
+        step(_evActive, e->time);
+        tail = (tail + 1) & (DGB_EDGE_RING - 1);
+    }
+    __atomic_store_n(&_edgeTail, tail, __ATOMIC_RELEASE);
+
+    now = millis();
+
+    // Ring overflow: Resync with debounced level
+    if(_edgeOverflow) {
+        _edgeOverflow = false;
+        if(_active != _evActive) {
+            step(_evActive, now);
+            _evActive = _active;
+        }
+    }
+
+    step(_evActive, now);
+}
+
+// Advance the state machine
+void DGButton::step(bool active, unsigned long now)
+{
+    unsigned long waitTime;
+
+    // Edge times may lag behind the last step (edge captured 
+    // between reading millis() and the ring)
+    if((long)(now - _stepTime) < 0) now = _stepTime;
+    _stepTime = now;
+    
+    waitTime = now - _startTime;
     
     switch(_state) {
     case TCBS_IDLE:
@@ -167,7 +322,7 @@ void DGButton::scan(void)
             transitionTo(_lastState);
         } else if((!active) && (waitTime > _pressDur)) {
             if(!_pressNotified && _pressFunc) _pressFunc();
-            reset();
+            clearState();
         }
         break;
   
@@ -186,7 +341,7 @@ void DGButton::scan(void)
             transitionTo(_lastState);
         } else if(waitTime >= _debounceDur) {
             if(_longPressStopFunc) _longPressStopFunc();
-            reset();
+            clearState();
         }
         break;
 
@@ -202,7 +357,7 @@ void DGButton::scan(void)
             transitionTo(_lastState);
         } else if(waitTime >= _debounceDur) {
             if(_elongPressStopFunc) _elongPressStopFunc();
-            reset();
+            clearState();
         }
         break;
         
@@ -212,7 +367,21 @@ void DGButton::scan(void)
     }
 }
 
+// Reset state machine, discard pending edges
 void DGButton::reset(void)
+{
+    __atomic_store_n(&_edgeTail, __atomic_load_n(&_edgeHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    _evActive = _active;
+    clearState();
+}
+
+// Debounced level
+bool DGButton::isActive(void)
+{
+    return _active;
+}
+
+void DGButton::clearState(void)
 {
     _state = TCBS_IDLE;
     _lastState = TCBS_IDLE;
@@ -69,6 +69,13 @@ typedef enum {
     TCBS_ELONGPRESSEND
 } ButtonState;
 
+#define DGB_EDGE_RING     16      // Power of 2
+
+typedef struct {
+    unsigned long time;
+    bool          active;
+} DGBEdge;
+
 class DGButton {
   
     public:
@@ -83,12 +90,21 @@ class DGButton {
         void attachLongPressStop(void (*newFunction)(void));
         void attachELongPressStart(void (*newFunction)(void));
         void attachELongPressStop(void (*newFunction)(void));
+        void attachChange(void (*newFunction)(bool active, unsigned long edgeTime, void *arg), void *arg = NULL);
 
         void scan(void);
         void reset(void);
 
+        bool isActive(void);
+
+        static void sampleAll(void *arg);
+
     private:
 
+        static void edgeISR(void *arg);
+        void pushEdge(bool active, unsigned long now);
+        void step(bool active, unsigned long now);
+        void clearState(void);
         void transitionTo(ButtonState nextState);
 
         void (*_pressFunc)(void) = NULL;
@@ -96,6 +112,8 @@ class DGButton {
         void (*_longPressStopFunc)(void) = NULL;
         void (*_elongPressStartFunc)(void) = NULL;
         void (*_elongPressStopFunc)(void) = NULL;
+        void (*_changeFunc)(bool, unsigned long, void *) = NULL;
+        void *_changeArg = NULL;
 
         int _pin;
         bool _pullupActive;
@@ -113,6 +131,20 @@ class DGButton {
         unsigned long _startTime;
 
         bool _pressNotified = false;
+
+        volatile bool _active = false;      // Debounced by tick job
+        volatile unsigned long _lastEdge = 0;   // Set by GPIO ISR
+
+        // Ring of debounced changes, written by tick job, read by scan()
+        DGBEdge _edges[DGB_EDGE_RING];
+        volatile uint8_t _edgeHead = 0;
+        volatile uint8_t _edgeTail = 0;
+        volatile bool _edgeOverflow = false;
+        bool _evActive = false;             // Last level fed to state machine
+        unsigned long _stepTime = 0;        // Time of last step
 };
 
+#define DGB_MAX_BUTTONS   6
+#define DGB_SAMPLE_MS     2
+
 #endif
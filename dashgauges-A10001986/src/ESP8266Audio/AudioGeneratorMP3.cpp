@@ -69,6 +69,15 @@ AudioGeneratorMP3::~AudioGeneratorMP3()
 
 
 bool AudioGeneratorMP3::stop()
+{
+  bool ret = stopKeepOutput();
+  output->stop();
+  return ret;
+}
+
+// Stop decoding, but leave the output running, so that what is
+// still in its DMA buffer plays out while the next file is begin()'d
+bool AudioGeneratorMP3::stopKeepOutput()
 {
   if (madInitted) {
     mad_synth_finish(synth);
@@ -90,7 +99,6 @@ bool AudioGeneratorMP3::stop()
   stream = NULL;
 
   running = false;
-  output->stop();
   return file->close();
 }
 
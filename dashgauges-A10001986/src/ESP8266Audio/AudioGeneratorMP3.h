@@ -37,6 +37,7 @@ class AudioGeneratorMP3 : public AudioGenerator
     virtual bool begin(AudioFileSource *source, AudioOutput *output) override;
     virtual bool loop() override;
     virtual bool stop() override;
+    bool stopKeepOutput();
     virtual bool isRunning() override;
     virtual void desync () override;
 
@@ -0,0 +1,246 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test harness: Fakes for the modules that are not built on
+ * the host (settings, WiFi, MQTT), and for the I2S audio output.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+#include "../../dashgauges-A10001986/dg_global.h"
+
+#include <Arduino.h>
+
+#include "../../dashgauges-A10001986/src/ESP8266Audio/AudioOutputI2S.h"
+#include "../../dashgauges-A10001986/dg_settings.h"
+#include "../../dashgauges-A10001986/dg_wifi.h"
+
+#include "host.h"
+
+/*
+ * Settings
+ */
+
+struct Settings   settings;
+struct IPSettings ipsettings;
+
+bool    haveFS = true;
+bool    haveSD = true;
+bool    FlashROMode = false;
+bool    haveAudioFiles = true;
+uint8_t musFolderNum = 0;
+
+void unmount_fs()               {}
+void write_settings()           {}
+void loadCurVolume()            {}
+void storeCurVolume()           {}
+void saveCurVolume()            {}
+void saveUpdAvail()             {}
+void saveCarMode()              {}
+void loadMusFoldNum()           {}
+void saveMusFoldNum()           {}
+void loadShuffle()              {}
+void saveShuffle()              {}
+void deleteIpSettings()         {}
+bool check_allow_CPA()          { return false; }
+bool prepareCopyAudioFiles()    { return false; }
+void doCopyAudioFiles()         {}
+
+bool evalBool(char *s)
+{
+    return *s != '0';
+}
+
+/*
+ * WiFi
+ */
+
+bool     gaugeTypeLocked = false;
+bool     carMode = false;
+uint32_t host_wifiLoops = 0;
+uint32_t host_wifiLoopUs = 0;
+
+void wifi_loop()
+{
+    host_wifiLoops++;
+    host_charge(host_wifiLoopUs);
+}
+
+void wifiOn(unsigned long newDelay, bool alsoInAPMode, bool deferConfigPortal) {}
+bool wifiOnWillBlock()                  { return false; }
+bool updateAvailable()                  { return false; }
+void updateConfigPortalVolValues()      {}
+void updateConfigPortalShufValues()     {}
+void updateConfigPortalUpdValues()      {}
+
+bool wifi_getIP(uint8_t& a, uint8_t& b, uint8_t& c, uint8_t& d)
+{
+    a = 127; b = 0; c = 0; d = 1;
+    return host_wifiUp;
+}
+
+bool isIp(char *str)
+{
+    unsigned int a, b, c, d;
+    char x;
+    return sscanf(str, "%u.%u.%u.%u%c", &a, &b, &c, &d, &x) == 4;
+}
+
+/*
+ * MQTT
+ */
+
+bool     pubMP = false;
+uint32_t host_mqttPubs = 0;
+char     host_mqttLastTopic[64];
+char     host_mqttLastPayload[1024];
+
+bool mqttConnected()
+{
+    return true;
+}
+
+bool mqttPublish(const char *topic, const char *pl, unsigned int len)
+{
+    host_mqttPubs++;
+    snprintf(host_mqttLastTopic, sizeof(host_mqttLastTopic), "%s", topic);
+    snprintf(host_mqttLastPayload, sizeof(host_mqttLastPayload), "%.*s", (int)len, pl);
+    return true;
+}
+
+/*
+ * I2S output
+ */
+
+HostAudio host_audio;
+
+static uint32_t audLevel = 0;       // Frames in DMA buffer
+static uint64_t audLastUs = 0;
+static uint64_t audCurGap = 0;
+
+// Play what was buffered since last call; account for gaps
+static void aud_drain(uint32_t rate)
+{
+    uint64_t now = host_nowUs();
+    uint64_t el = now - audLastUs;
+    uint64_t frames = rate ? el * rate / 1000000 : 0;
+
+    if(!frames) return;
+    audLastUs = now;
+
+    if(frames <= audLevel) {
+        audLevel -= frames;
+        host_audio.frames += frames;
+        audCurGap = 0;
+        return;
+    }
+
+    uint64_t gap = (frames - audLevel) * 1000000 / rate;
+    host_audio.frames += audLevel;
+    audLevel = 0;
+    if(host_audio.armed) {
+        host_audio.gapUs += gap;
+        audCurGap += gap;
+        if(audCurGap > host_audio.maxGapUs) host_audio.maxGapUs = audCurGap;
+    }
+}
+
+void host_audioArm(bool arm)
+{
+    aud_drain(44100);
+    host_audio.armed = arm;
+    audCurGap = 0;
+}
+
+AudioOutputI2S::AudioOutputI2S(int port, int output_mode, int dma_buf_count, int use_apll)
+{
+    this->portNo = port;
+    this->output_mode = output_mode;
+    this->dma_buf_count = dma_buf_count;
+    this->use_apll = use_apll;
+    i2sOn = false;
+    mono = false;
+    hertz = 44100;
+    bps = 16;
+    channels = 2;
+    SetGain(1.0);
+}
+
+AudioOutputI2S::~AudioOutputI2S()
+{
+}
+
+bool AudioOutputI2S::SetPinout(int bclkPin, int wclkPin, int doutPin)
+{
+    return true;
+}
+
+bool AudioOutputI2S::SetOutputModeMono(bool mono)
+{
+    this->mono = mono;
+    return true;
+}
+
+bool AudioOutputI2S::SetRate(int hz)
+{
+    aud_drain(hertz);
+    hertz = hz;
+    return true;
+}
+
+bool AudioOutputI2S::SetBitsPerSample(int bits)
+{
+    bps = bits;
+    return true;
+}
+
+bool AudioOutputI2S::SetChannels(int channels)
+{
+    this->channels = channels;
+    return true;
+}
+
+bool AudioOutputI2S::begin(bool txDAC)
+{
+    if(!i2sOn) {
+        aud_drain(hertz);
+        i2sOn = true;
+        host_audio.begins++;
+    }
+    return true;
+}
+
+size_t AudioOutputI2S::ConsumeSample(int16_t sL, int16_t sR)
+{
+    if(!i2sOn)
+        return 0;
+
+    aud_drain(hertz);
+    if(audLevel >= (uint32_t)dma_buf_count * 64)
+        return 0;
+
+    audLevel++;
+    return 1;
+}
+
+void AudioOutputI2S::flush()
+{
+}
+
+bool AudioOutputI2S::stop()
+{
+    if(!i2sOn)
+        return false;
+
+    // i2s_zero_dma_buffer(): Buffered frames are lost
+    aud_drain(hertz);
+    host_audio.lostFrames += audLevel;
+    audLevel = 0;
+    i2sOn = false;
+    host_audio.stops++;
+    return true;
+}
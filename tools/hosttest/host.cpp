@@ -0,0 +1,1003 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test harness: Simulated hardware and OS behind the stubs
+ * in stub/.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include "../../dashgauges-A10001986/src/SD/SD.h"
+
+#include "host.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*
+ * Time
+ */
+
+static bool                  rtMode = false;
+static std::atomic<uint64_t> vNowUs(0);
+static std::atomic<int64_t>  msOffset(0);
+static std::chrono::steady_clock::time_point rtStart = std::chrono::steady_clock::now();
+static std::thread::id       mainThread = std::this_thread::get_id();
+
+struct esp_timer {
+    void     (*cb)(void *);
+    void     *arg;
+    uint64_t period;
+    uint64_t next;
+    bool     active;
+};
+static std::vector<esp_timer *> timers;
+static std::recursive_mutex     timerLock;
+
+static void rt_timerThread()
+{
+    for(;;) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        std::lock_guard<std::recursive_mutex> lk(timerLock);
+        uint64_t now = host_nowUs();
+        for(auto t : timers) {
+            if(t->active && t->next <= now) {
+                t->next += t->period;
+                if(t->next <= now) t->next = now + t->period;
+                t->cb(t->arg);
+            }
+        }
+    }
+}
+
+void host_init(bool realtime)
+{
+    rtMode = realtime;
+    mainThread = std::this_thread::get_id();
+    rtStart = std::chrono::steady_clock::now();
+    vNowUs = 0;
+    msOffset = 0;
+    if(rtMode) {
+        std::thread(rt_timerThread).detach();
+    }
+}
+
+uint64_t host_nowUs()
+{
+    if(rtMode) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - rtStart).count();
+    }
+    return vNowUs.load();
+}
+
+void host_advanceUs(uint64_t us)
+{
+    if(rtMode) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+        return;
+    }
+
+    uint64_t target = vNowUs.load() + us;
+
+    // Fire due timers in order
+    for(;;) {
+        esp_timer *due = NULL;
+        std::lock_guard<std::recursive_mutex> lk(timerLock);
+        for(auto t : timers) {
+            if(t->active && t->next <= target && (!due || t->next < due->next)) {
+                due = t;
+            }
+        }
+        if(!due) break;
+        if(due->next > vNowUs.load()) vNowUs = due->next;
+        due->next += due->period;
+        due->cb(due->arg);
+    }
+    if(target > vNowUs.load()) vNowUs = target;
+}
+
+void host_advance(uint32_t ms)
+{
+    host_advanceUs((uint64_t)ms * 1000);
+}
+
+void host_setMillis(uint32_t ms)
+{
+    msOffset = (int64_t)ms - (int64_t)(host_nowUs() / 1000);
+}
+
+// Charge time for a (simulated) slow operation: Other threads'
+// time does not move the virtual clock, but their (real) sleep
+// is noticed by whoever waits for them.
+void host_charge(uint64_t us)
+{
+    if(!us) return;
+    if(rtMode || std::this_thread::get_id() != mainThread) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    } else {
+        vNowUs += us;
+    }
+}
+
+unsigned long millis()
+{
+    return (uint32_t)((int64_t)(host_nowUs() / 1000) + msOffset.load());
+}
+
+unsigned long micros()
+{
+    return (uint32_t)((int64_t)host_nowUs() + msOffset.load() * 1000);
+}
+
+void delay(uint32_t ms)
+{
+    if(!rtMode && std::this_thread::get_id() == mainThread) {
+        host_advance(ms);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    if(!rtMode && std::this_thread::get_id() == mainThread) {
+        host_advanceUs(us);
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    esp_timer *t = new esp_timer { args->callback, args->arg, 0, 0, false };
+    std::lock_guard<std::recursive_mutex> lk(timerLock);
+    timers.push_back(t);
+    *handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    std::lock_guard<std::recursive_mutex> lk(timerLock);
+    if(t->active) return ESP_FAIL;
+    t->period = period_us;
+    t->next = host_nowUs() + period_us;
+    t->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    std::lock_guard<std::recursive_mutex> lk(timerLock);
+    if(!t->active) return ESP_FAIL;
+    t->active = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time()
+{
+    return (int64_t)host_nowUs();
+}
+
+/*
+ * GPIO, LEDC
+ */
+
+struct HostISR {
+    void (*fn)(void *);
+    void *arg;
+    int  mode;
+};
+static int     pinLevel[64];
+static HostISR pinISR[64];
+
+uint32_t host_ledcDuty[16];
+uint32_t host_ledcFreq[16];
+uint32_t host_ledcWrites = 0;
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if(mode == INPUT_PULLUP && pin < 64) pinLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if(pin < 64) pinLevel[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return (pin < 64) ? pinLevel[pin] : LOW;
+}
+
+void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode)
+{
+    if(pin < 64) pinISR[pin] = { fn, arg, mode };
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if(pin < 64) pinISR[pin].fn = NULL;
+}
+
+void host_setPin(uint8_t pin, int level)
+{
+    level = level ? HIGH : LOW;
+    if(pin >= 64 || pinLevel[pin] == level) return;
+    pinLevel[pin] = level;
+    HostISR *i = &pinISR[pin];
+    if(i->fn && (i->mode == CHANGE || (i->mode == RISING && level) || (i->mode == FALLING && !level))) {
+        i->fn(i->arg);
+    }
+}
+
+int host_getPin(uint8_t pin)
+{
+    return (pin < 64) ? pinLevel[pin] : LOW;
+}
+
+uint32_t host_gpioReg(int reg)
+{
+    uint32_t r = 0;
+    int base = (reg == GPIO_IN1_REG) ? 32 : 0;
+    for(int i = 0; i < 32; i++) {
+        if(pinLevel[base + i]) r |= (1UL << i);
+    }
+    return r;
+}
+
+uint32_t ledcSetup(uint8_t chan, uint32_t freq, uint8_t resBits)
+{
+    if(chan < 16) host_ledcFreq[chan] = freq;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t chan)
+{
+}
+
+void ledcWrite(uint8_t chan, uint32_t duty)
+{
+    if(chan < 16) host_ledcDuty[chan] = duty;
+    host_ledcWrites++;
+}
+
+/*
+ * Misc
+ */
+
+bool host_serial = false;
+bool host_wifiUp = false;
+
+static std::mt19937 rng(1);
+static std::mutex   rngLock;
+
+void host_seed(uint32_t seed)
+{
+    std::lock_guard<std::mutex> lk(rngLock);
+    rng.seed(seed);
+}
+
+uint32_t esp_random()
+{
+    std::lock_guard<std::mutex> lk(rngLock);
+    return rng();
+}
+
+void esp_restart()
+{
+    printf("esp_restart() called\n");
+    _exit(1);
+}
+
+HardwareSerial Serial;
+SPIClass       SPI;
+WiFiClass      WiFi;
+
+int HardwareSerial::printf(const char *fmt, ...)
+{
+    int r = 0;
+    if(host_serial) {
+        va_list ap;
+        va_start(ap, fmt);
+        r = vprintf(fmt, ap);
+        va_end(ap);
+    }
+    return r;
+}
+
+void HardwareSerial::print(const char *s)   { if(host_serial) fputs(s, stdout); }
+void HardwareSerial::print(int v)           { if(host_serial) ::printf("%d", v); }
+void HardwareSerial::println(const char *s) { if(host_serial) puts(s); }
+void HardwareSerial::println(int v)         { if(host_serial) ::printf("%d\n", v); }
+
+/*
+ * Tasks: std::threads. vTaskDelete(NULL) ends the thread.
+ */
+
+bool host_failTaskCreate = false;
+int  host_tasksCreated = 0;
+
+struct HostTaskExit {};
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    if(host_failTaskCreate)
+        return pdFAIL;
+
+    host_tasksCreated++;
+    std::thread([fn, arg]() {
+        try {
+            fn(arg);
+        } catch(HostTaskExit&) {
+        }
+    }).detach();
+
+    if(handle) *handle = (TaskHandle_t)(intptr_t)host_tasksCreated;
+
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if(!task) throw HostTaskExit();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks);
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return 1;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return 1;
+}
+
+/*
+ * Queues and semaphores; waits are in real time
+ */
+
+struct HostQueue {
+    std::mutex              m;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    size_t                  len;
+    size_t                  itemSize;
+};
+
+template<class Pred>
+static bool host_wait(std::unique_lock<std::mutex>& lk, std::condition_variable& cv, TickType_t wait, Pred p)
+{
+    if(wait == portMAX_DELAY) {
+        cv.wait(lk, p);
+        return true;
+    }
+    return cv.wait_for(lk, std::chrono::milliseconds(wait), p);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t itemSize)
+{
+    HostQueue *q = new HostQueue;
+    q->len = len;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t h)
+{
+    delete (HostQueue *)h;
+}
+
+BaseType_t xQueueSend(QueueHandle_t h, const void *item, TickType_t wait)
+{
+    HostQueue *q = (HostQueue *)h;
+    std::unique_lock<std::mutex> lk(q->m);
+    if(!host_wait(lk, q->cv, wait, [q] { return q->items.size() < q->len; }))
+        return pdFALSE;
+    q->items.emplace_back((const uint8_t *)item, (const uint8_t *)item + q->itemSize);
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t h, void *item, TickType_t wait)
+{
+    HostQueue *q = (HostQueue *)h;
+    std::unique_lock<std::mutex> lk(q->m);
+    if(!host_wait(lk, q->cv, wait, [q] { return !q->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+struct HostSem {
+    std::mutex              m;
+    std::condition_variable cv;
+    bool                    given = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return new HostSem;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t h)
+{
+    delete (HostSem *)h;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h)
+{
+    HostSem *s = (HostSem *)h;
+    std::lock_guard<std::mutex> lk(s->m);
+    if(s->given) return pdFALSE;
+    s->given = true;
+    s->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t wait)
+{
+    HostSem *s = (HostSem *)h;
+    std::unique_lock<std::mutex> lk(s->m);
+    if(!host_wait(lk, s->cv, wait, [s] { return s->given; }))
+        return pdFALSE;
+    s->given = false;
+    return pdTRUE;
+}
+
+/*
+ * I2C bus and MCP4728 model
+ */
+
+TwoWire      Wire;
+HostI2CStats host_i2c;
+uint32_t     host_i2cMaxClock = 400000;
+bool         host_i2cFail = false;
+HostMCP4728  host_dac;
+
+static uint32_t   i2cClock = 100000;
+static std::mutex i2cLock;
+
+static void dac_setOut(int ch, uint16_t val)
+{
+    if(host_dac.out[ch] != val) {
+        host_dac.out[ch] = val;
+        host_dac.outUpdates++;
+    }
+}
+
+static void dac_update()
+{
+    for(int ch = 0; ch < 4; ch++) {
+        dac_setOut(ch, host_dac.input[ch]);
+    }
+}
+
+static void dac_write(const uint8_t *d, size_t len)
+{
+    size_t i = 0;
+
+    switch(d[0] >> 3) {
+    case 0b01000:                   // Multi write
+        while(i + 2 < len) {
+            int ch = (d[i] >> 1) & 3;
+            bool udac = d[i] & 1;
+            host_dac.vrefGain[ch] = d[i+1] & 0xf0;
+            host_dac.input[ch] = ((d[i+1] & 0x0f) << 8) | d[i+2];
+            if(!udac || host_dac.ldacLow) dac_setOut(ch, host_dac.input[ch]);
+            i += 3;
+        }
+        return;
+    case 0b01010:                   // Sequential write (with EEPROM)
+        {
+            int ch = (d[0] >> 1) & 3;
+            bool udac = d[0] & 1;
+            for(i = 1; i + 1 < len && ch < 4; i += 2, ch++) {
+                host_dac.vrefGain[ch] = d[i] & 0xf0;
+                host_dac.input[ch] = ((d[i] & 0x0f) << 8) | d[i+1];
+                host_dac.eeprom[ch][0] = d[i];
+                host_dac.eeprom[ch][1] = d[i+1];
+                if(!udac || host_dac.ldacLow) dac_setOut(ch, host_dac.input[ch]);
+            }
+        }
+        return;
+    }
+
+    if(!(d[0] >> 6)) {              // Fast write
+        for(int ch = 0; ch < 4 && i + 1 < len; ch++, i += 2) {
+            host_dac.input[ch] = ((d[i] & 0x0f) << 8) | d[i+1];
+            host_dac.vrefGain[ch] = (host_dac.vrefGain[ch] & 0x90) | ((d[i] & 0x30) << 1);
+            if(host_dac.ldacLow) dac_setOut(ch, host_dac.input[ch]);
+        }
+    }
+}
+
+static void dac_read(uint8_t *buf, size_t len)
+{
+    uint8_t r[24];
+
+    for(int ch = 0; ch < 4; ch++) {
+        r[ch*6 + 0] = 0xc0 | (ch << 4);
+        r[ch*6 + 1] = host_dac.vrefGain[ch] | (host_dac.input[ch] >> 8);
+        r[ch*6 + 2] = host_dac.input[ch] & 0xff;
+        r[ch*6 + 3] = 0xc8 | (ch << 4);
+        r[ch*6 + 4] = host_dac.eeprom[ch][0];
+        r[ch*6 + 5] = host_dac.eeprom[ch][1];
+    }
+    for(size_t i = 0; i < len; i++) {
+        buf[i] = (i < 24) ? r[i] : 0xff;
+    }
+    // Too fast for the bus: Corrupt data
+    if(i2cClock > host_i2cMaxClock) {
+        for(size_t i = 0; i < len; i += 5) buf[i] ^= 0x20;
+    }
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t freq)
+{
+    i2cClock = freq ? freq : 100000;
+    return true;
+}
+
+bool TwoWire::setClock(uint32_t freq)
+{
+    i2cClock = freq;
+    return true;
+}
+
+uint32_t TwoWire::getClock()
+{
+    return i2cClock;
+}
+
+void TwoWire::beginTransmission(uint8_t addr)
+{
+    _addr = addr;
+    _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t b)
+{
+    if(_txLen >= sizeof(_txBuf)) return 0;
+    _txBuf[_txLen++] = b;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+    while(n < len && write(buf[n])) n++;
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    std::lock_guard<std::mutex> lk(i2cLock);
+
+    host_i2c.txns++;
+    host_i2c.bytes++;
+
+    if(host_i2cFail)
+        return 2;
+
+    if(_addr == 0x00) {             // General call
+        host_i2c.bytes += _txLen;
+        if(_txLen && _txBuf[0] == 0x08) dac_update();
+        return 0;
+    }
+
+    if(_addr != 0x60 || !host_dac.present)
+        return 2;
+
+    host_i2c.bytes += _txLen;
+    if(_txLen) dac_write(_txBuf, _txLen);
+
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len, bool sendStop)
+{
+    std::lock_guard<std::mutex> lk(i2cLock);
+
+    host_i2c.txns++;
+    host_i2c.reads++;
+    host_i2c.bytes++;
+    _rxLen = _rxPos = 0;
+
+    if(host_i2cFail || addr != 0x60 || !host_dac.present)
+        return 0;
+
+    if(len > sizeof(_rxBuf)) len = sizeof(_rxBuf);
+    dac_read(_rxBuf, len);
+    _rxLen = len;
+    host_i2c.bytes += len;
+
+    return len;
+}
+
+int TwoWire::available()
+{
+    return _rxLen - _rxPos;
+}
+
+int TwoWire::read()
+{
+    return (_rxPos < _rxLen) ? _rxBuf[_rxPos++] : -1;
+}
+
+/*
+ * File systems
+ */
+
+struct HostNode {
+    bool   isDir;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    time_t mtime;
+};
+
+struct HostVol {
+    std::recursive_mutex            m;
+    std::map<std::string, HostNode> nodes;
+    HostFSLatency                   lat = { 0, 0, 0, 0 };
+    HostFSOps                       ops = { 0, 0, 0, 0, 0 };
+};
+
+struct HostFileState {
+    HostVol     *vol;
+    std::string path;
+    bool        isDir;
+    bool        open;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t      pos;
+    time_t      mtime;
+    std::vector<std::string> children;
+    size_t      childIdx;
+};
+
+static std::string fs_norm(const char *path)
+{
+    std::string p(path ? path : "");
+    if(p.empty() || p[0] != '/') p = "/" + p;
+    while(p.size() > 1 && p.back() == '/') p.pop_back();
+    return p;
+}
+
+static std::string fs_parent(const std::string& p)
+{
+    size_t i = p.rfind('/');
+    return (i == 0) ? "/" : p.substr(0, i);
+}
+
+static bool fs_existsLocked(HostVol *v, const std::string& p)
+{
+    return p == "/" || v->nodes.count(p);
+}
+
+static File fs_openLocked(HostVol *v, const std::string& p)
+{
+    auto st = std::make_shared<HostFileState>();
+    st->vol = v;
+    st->path = p;
+    st->open = true;
+    st->pos = 0;
+    st->childIdx = 0;
+    if(p == "/" || v->nodes[p].isDir) {
+        st->isDir = true;
+        st->mtime = (p == "/") ? 0 : v->nodes[p].mtime;
+        std::string prefix = (p == "/") ? "/" : p + "/";
+        for(auto it = v->nodes.lower_bound(prefix); it != v->nodes.end(); ++it) {
+            if(it->first.compare(0, prefix.size(), prefix)) break;
+            if(it->first.find('/', prefix.size()) == std::string::npos) {
+                st->children.push_back(it->first);
+            }
+        }
+        // FAT returns entries in creation order, roughly; shuffle
+        // deterministically so that nothing depends on sorting
+        std::mt19937 r(st->children.size());
+        std::shuffle(st->children.begin(), st->children.end(), r);
+    } else {
+        st->isDir = false;
+        st->data = v->nodes[p].data;
+        st->mtime = v->nodes[p].mtime;
+    }
+    return File(st);
+}
+
+fs::FS::FS(FSImplPtr impl)
+{
+    vol = new HostVol;
+}
+
+File fs::FS::open(const char *path, const char *mode, const bool create)
+{
+    std::string p = fs_norm(path);
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+
+    host_charge(vol->lat.openUs);
+    vol->ops.opens++;
+
+    if(mode[0] == 'r') {
+        if(!fs_existsLocked(vol, p)) return File();
+        return fs_openLocked(vol, p);
+    }
+
+    if(!fs_existsLocked(vol, fs_parent(p))) return File();
+    auto it = vol->nodes.find(p);
+    if(it != vol->nodes.end() && it->second.isDir) return File();
+    if(it == vol->nodes.end() || mode[0] == 'w') {
+        vol->nodes[p] = { false, std::make_shared<std::vector<uint8_t>>(), time(NULL) };
+    }
+    File f = fs_openLocked(vol, p);
+    if(mode[0] == 'a') f.seek(0, SeekEnd);
+    return f;
+}
+
+bool fs::FS::exists(const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+    host_charge(vol->lat.openUs);
+    vol->ops.opens++;
+    return fs_existsLocked(vol, fs_norm(path));
+}
+
+bool fs::FS::remove(const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+    auto it = vol->nodes.find(fs_norm(path));
+    if(it == vol->nodes.end() || it->second.isDir) return false;
+    vol->nodes.erase(it);
+    return true;
+}
+
+bool fs::FS::rename(const char *pathFrom, const char *pathTo)
+{
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+    std::string f = fs_norm(pathFrom), t = fs_norm(pathTo);
+    host_charge(vol->lat.openUs);
+    auto it = vol->nodes.find(f);
+    if(it == vol->nodes.end() || vol->nodes.count(t)) return false;
+    HostNode n = it->second;
+    vol->nodes.erase(it);
+    vol->nodes[t] = n;
+    vol->ops.renames++;
+    return true;
+}
+
+bool fs::FS::mkdir(const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+    std::string p = fs_norm(path);
+    if(fs_existsLocked(vol, p)) return false;
+    vol->nodes[p] = { true, NULL, time(NULL) };
+    return true;
+}
+
+bool fs::FS::rmdir(const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(vol->m);
+    return vol->nodes.erase(fs_norm(path)) > 0;
+}
+
+fs::File::operator bool() const
+{
+    return _p && _p->open;
+}
+
+size_t fs::File::write(uint8_t b)
+{
+    return write(&b, 1);
+}
+
+size_t fs::File::write(const uint8_t *buf, size_t len)
+{
+    if(!*this || _p->isDir) return 0;
+    std::lock_guard<std::recursive_mutex> lk(_p->vol->m);
+    auto& d = *_p->data;
+    if(_p->pos + len > d.size()) d.resize(_p->pos + len);
+    memcpy(d.data() + _p->pos, buf, len);
+    _p->pos += len;
+    return len;
+}
+
+int fs::File::available()
+{
+    if(!*this || _p->isDir) return 0;
+    return _p->data->size() - _p->pos;
+}
+
+int fs::File::read()
+{
+    uint8_t b;
+    return (read(&b, 1) == 1) ? b : -1;
+}
+
+size_t fs::File::read(uint8_t *buf, size_t len)
+{
+    if(!*this || _p->isDir) return 0;
+    std::lock_guard<std::recursive_mutex> lk(_p->vol->m);
+    auto& d = *_p->data;
+    size_t n = (_p->pos < d.size()) ? std::min(len, d.size() - _p->pos) : 0;
+    memcpy(buf, d.data() + _p->pos, n);
+    _p->pos += n;
+    _p->vol->ops.reads++;
+    _p->vol->ops.bytesRead += n;
+    host_charge(_p->vol->lat.readUs + (uint64_t)_p->vol->lat.readUsPerKB * n / 1024);
+    return n;
+}
+
+bool fs::File::seek(uint32_t pos, SeekMode mode)
+{
+    if(!*this || _p->isDir) return false;
+    size_t np = pos;
+    if(mode == SeekCur) np = _p->pos + pos;
+    else if(mode == SeekEnd) np = _p->data->size() + pos;
+    if(np > _p->data->size()) return false;
+    _p->pos = np;
+    return true;
+}
+
+size_t fs::File::position() const
+{
+    return *this ? _p->pos : 0;
+}
+
+size_t fs::File::size() const
+{
+    return (*this && !_p->isDir) ? _p->data->size() : 0;
+}
+
+void fs::File::close()
+{
+    if(_p) _p->open = false;
+    _p.reset();
+}
+
+time_t fs::File::getLastWrite()
+{
+    return *this ? _p->mtime : 0;
+}
+
+const char *fs::File::path() const
+{
+    return *this ? _p->path.c_str() : NULL;
+}
+
+const char *fs::File::name() const
+{
+    if(!*this) return NULL;
+    const char *s = strrchr(_p->path.c_str(), '/');
+    return s ? s + 1 : _p->path.c_str();
+}
+
+bool fs::File::isDirectory()
+{
+    return *this && _p->isDir;
+}
+
+File fs::File::openNextFile(const char *mode)
+{
+    if(!*this || !_p->isDir) return File();
+    std::lock_guard<std::recursive_mutex> lk(_p->vol->m);
+    if(_p->childIdx >= _p->children.size()) return File();
+    host_charge(_p->vol->lat.dirEntryUs + _p->vol->lat.openUs);
+    _p->vol->ops.dirEntries++;
+    _p->vol->ops.opens++;
+    return fs_openLocked(_p->vol, _p->children[_p->childIdx++]);
+}
+
+String fs::File::getNextFileName(bool *isDir)
+{
+    if(!*this || !_p->isDir) return String();
+    std::lock_guard<std::recursive_mutex> lk(_p->vol->m);
+    if(_p->childIdx >= _p->children.size()) return String();
+    host_charge(_p->vol->lat.dirEntryUs);
+    _p->vol->ops.dirEntries++;
+    const std::string& c = _p->children[_p->childIdx++];
+    if(isDir) *isDir = _p->vol->nodes[c].isDir;
+    return String(c);
+}
+
+void fs::File::rewindDirectory()
+{
+    if(*this) _p->childIdx = 0;
+}
+
+fs::SDFS::SDFS(FSImplPtr impl) : FS(impl)
+{
+}
+
+fs::SDFS SD(NULL);
+fs::FS   LittleFS(NULL);
+
+void host_fsClear(FS& fs)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    fs.vol->nodes.clear();
+    fs.vol->ops = { 0, 0, 0, 0, 0 };
+}
+
+void host_fsAddFile(FS& fs, const char *path, const uint8_t *data, size_t len, time_t mtime)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    auto d = std::make_shared<std::vector<uint8_t>>(len);
+    if(data) memcpy(d->data(), data, len);
+    fs.vol->nodes[fs_norm(path)] = { false, d, mtime };
+}
+
+void host_fsAddFile(FS& fs, const char *path, size_t len, time_t mtime)
+{
+    host_fsAddFile(fs, path, NULL, len, mtime);
+}
+
+void host_fsMkdir(FS& fs, const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    fs.vol->nodes[fs_norm(path)] = { true, NULL, 0 };
+}
+
+bool host_fsExists(FS& fs, const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    return fs_existsLocked(fs.vol, fs_norm(path));
+}
+
+void host_fsSetLatency(FS& fs, const HostFSLatency& lat)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    fs.vol->lat = lat;
+}
+
+HostFSOps& host_fsOps(FS& fs)
+{
+    return fs.vol->ops;
+}
+
+std::vector<uint8_t> host_fsRead(FS& fs, const char *path)
+{
+    std::lock_guard<std::recursive_mutex> lk(fs.vol->m);
+    auto it = fs.vol->nodes.find(fs_norm(path));
+    if(it == fs.vol->nodes.end() || it->second.isDir) return std::vector<uint8_t>();
+    return *it->second.data;
+}
+
+int host_fails = 0;
+
+void host_exit()
+{
+    fflush(stdout);
+    _exit(host_fails ? 1 : 0);
+}
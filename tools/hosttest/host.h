@@ -0,0 +1,155 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test harness: Test-side API of the simulated hardware
+ * (host.cpp). The firmware only sees the stubs in stub/; tests use
+ * this to drive time, pins, the I2C bus and the file systems, and
+ * to look at the results.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+#ifndef _HOST_H
+#define _HOST_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <FS.h>
+#include <vector>
+
+/*
+ * Time
+ *
+ * By default, time is virtual: It starts at 0 and only advances
+ * through host_advance(), or delay() called from the main thread.
+ * Other threads' delays sleep in real time. In realtime mode,
+ * millis() is wall clock time since host_init().
+ */
+void     host_init(bool realtime = false);
+void     host_advance(uint32_t ms);
+void     host_advanceUs(uint64_t us);
+uint64_t host_nowUs();
+void     host_setMillis(uint32_t ms);   // Virtual: Set millis() (for wrap tests)
+void     host_charge(uint64_t us);      // Cost of a simulated slow operation
+
+/*
+ * Pins and LEDC
+ */
+void     host_setPin(uint8_t pin, int level);    // Calls attached ISR on change
+int      host_getPin(uint8_t pin);
+
+extern uint32_t host_ledcDuty[16];
+extern uint32_t host_ledcFreq[16];
+extern uint32_t host_ledcWrites;
+
+/*
+ * Tasks
+ */
+extern bool     host_failTaskCreate;    // Make xTaskCreatePinnedToCore() fail
+extern int      host_tasksCreated;
+
+/*
+ * I2C
+ *
+ * Every transaction costs one address byte plus its data bytes.
+ * Above host_i2cMaxClock, reads return corrupted data.
+ */
+struct HostI2CStats {
+    uint32_t txns;
+    uint32_t bytes;
+    uint32_t reads;
+};
+extern HostI2CStats host_i2c;
+extern uint32_t     host_i2cMaxClock;
+extern bool         host_i2cFail;       // NACK everything
+
+// MCP4728 model at 0x60
+struct HostMCP4728 {
+    bool     present = true;
+    bool     ldacLow = false;           // LDAC pin level; fast write updates outputs only if low
+    uint16_t input[4];                  // Input registers
+    uint16_t out[4];                    // Output (what the gauge sees)
+    uint8_t  vrefGain[4];               // VREF/PD/GAIN bits of last multi write
+    uint8_t  eeprom[4][2];
+    uint32_t outUpdates;                // Number of output register changes
+};
+extern HostMCP4728 host_dac;
+
+/*
+ * File systems
+ *
+ * In-memory; SD and LittleFS are separate volumes. Latency is
+ * charged per open, per read and per KB read, and per directory
+ * entry returned; as virtual time in virtual mode, as real sleep in
+ * realtime mode.
+ */
+struct HostFSLatency {
+    uint32_t openUs;
+    uint32_t readUsPerKB;
+    uint32_t dirEntryUs;
+    uint32_t readUs;            // per read() call
+};
+struct HostFSOps {
+    uint32_t opens;
+    uint32_t reads;
+    uint64_t bytesRead;
+    uint32_t dirEntries;
+    uint32_t renames;
+};
+
+void       host_fsClear(FS& fs);
+void       host_fsAddFile(FS& fs, const char *path, const uint8_t *data, size_t len, time_t mtime = 0);
+void       host_fsAddFile(FS& fs, const char *path, size_t len, time_t mtime = 0);   // Zero-filled
+void       host_fsMkdir(FS& fs, const char *path);
+bool       host_fsExists(FS& fs, const char *path);
+void       host_fsSetLatency(FS& fs, const HostFSLatency& lat);
+HostFSOps& host_fsOps(FS& fs);
+std::vector<std::uint8_t> host_fsRead(FS& fs, const char *path);
+
+/*
+ * Audio output (fakes.cpp)
+ *
+ * Models the I2S DMA buffer (dma_buf_count x 64 frames), drained at
+ * the sample rate. While armed, time with an empty buffer counts as
+ * gap. stop() discards what is buffered, as i2s_zero_dma_buffer().
+ */
+struct HostAudio {
+    bool     armed;
+    uint64_t gapUs;             // Total time with nothing to play
+    uint64_t maxGapUs;          // Longest single gap
+    uint64_t frames;            // Frames played
+    uint64_t lostFrames;        // Frames discarded by stop()
+    uint32_t begins;
+    uint32_t stops;
+};
+extern HostAudio host_audio;
+void host_audioArm(bool arm);
+
+/*
+ * Leaf modules (fakes.cpp): Settings, WiFi and MQTT
+ */
+extern uint32_t host_wifiLoops;
+extern uint32_t host_wifiLoopUs;        // Cost of one wifi_loop() call
+extern uint32_t host_mqttPubs;
+extern char     host_mqttLastTopic[64];
+extern char     host_mqttLastPayload[1024];
+
+/*
+ * Misc
+ */
+extern bool host_serial;        // Print Serial output to stdout
+extern bool host_wifiUp;
+void        host_seed(uint32_t seed);
+
+// Checks count failures; host_exit() ends the test with exit
+// code 1 if any failed. It does not run destructors, as tasks
+// may still be blocked on queues.
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #c); host_fails++; } } while(0)
+extern int  host_fails;
+[[noreturn]] void host_exit();
+
+#endif
@@ -0,0 +1,100 @@
+#!/bin/sh
+#
+# -------------------------------------------------------------------
+# Dash Gauges Panel
+# (C) 2023-2026 Thomas Winischhofer (A10001986)
+# https://github.com/realA10001986/Dash-Gauges
+# https://dg.out-a-ti.me
+#
+# Host test harness: Build and run tests
+#
+# License: Modified MIT NON-AI (see LICENSE)
+# -------------------------------------------------------------------
+#
+# Usage: run.sh [test ...]     (default: all test_*.cpp)
+#
+# Each test #includes the firmware module(s) it tests, so it can
+# reach their statics; all other modules are linked as objects.
+# Objects are rebuilt when their source is newer.
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+FW="$HERE/../../dashgauges-A10001986"
+OUT="$HERE/build"
+
+CXX=${CXX:-g++}
+CC=${CC:-gcc}
+FLAGS="-g -O1 -I$HERE/stub -Wno-write-strings -Wno-format -Wno-unused-result -fno-strict-aliasing"
+CXXFLAGS="$FLAGS -std=gnu++17"
+CFLAGS="$FLAGS -Wno-implicit-function-declaration"
+
+FWMODS="dg_main dg_audio dgdisplay input dg_sched AudioFileSourceLoop AudioGeneratorWAVLoop"
+MP3SRC="$FW/src/ESP8266Audio/AudioGeneratorMP3.cpp $FW/src/ESP8266Audio/AudioLogger.cpp"
+MADSRC=$(ls "$FW"/src/ESP8266Audio/libmad/*.c)
+
+mkdir -p "$OUT"
+
+# obj <src> <obj> <extra flags>
+obj()
+{
+    if [ ! -f "$2" ] || [ "$1" -nt "$2" ] || [ "$HERE/host.h" -nt "$2" ] ||
+       [ -n "$(find "$HERE/stub" -newer "$2" -print -quit)" ]; then
+        case "$1" in
+        *.c) $CC $CFLAGS $3 -c "$1" -o "$2" ;;
+        *)   $CXX $CXXFLAGS $3 -c "$1" -o "$2" ;;
+        esac
+    fi
+}
+
+# Objects, per sanitizer variant
+build_objs()
+{
+    v=$1; vflags=$2
+    mkdir -p "$OUT/$v"
+    obj "$HERE/host.cpp" "$OUT/$v/host.o" "$vflags"
+    obj "$HERE/fakes.cpp" "$OUT/$v/fakes.o" "$vflags"
+    for m in $FWMODS; do
+        obj "$FW/$m.cpp" "$OUT/$v/$m.o" "$vflags"
+    done
+    # Vendored code: Not ours to fix warnings in
+    for s in $MP3SRC $MADSRC; do
+        b=$(basename "$s"); b=${b%.*}
+        obj "$s" "$OUT/$v/$b.o" "$vflags -w"
+    done
+}
+
+TESTS="$*"
+[ -z "$TESTS" ] && TESTS=$(cd "$HERE" && ls test_*.cpp | sed 's/\.cpp$//')
+
+fails=0
+for t in $TESTS; do
+    t=${t%.cpp}
+    src="$HERE/$t.cpp"
+    # A test may ask for TSan with "// HOSTTEST: tsan", and lists
+    # the firmware modules it includes with "// HOSTTEST: uses ..."
+    if grep -q '^// HOSTTEST: tsan' "$src"; then
+        v=tsan; vflags="-fsanitize=thread"
+    else
+        v=plain; vflags=""
+    fi
+    build_objs $v "$vflags"
+    uses=$(sed -n 's|^// HOSTTEST: uses ||p' "$src")
+    objs="$OUT/$v/host.o $OUT/$v/fakes.o"
+    for m in $FWMODS; do
+        case " $uses " in *" $m "*) ;; *) objs="$objs $OUT/$v/$m.o" ;; esac
+    done
+    for s in $MP3SRC $MADSRC; do
+        b=$(basename "$s"); objs="$objs $OUT/$v/${b%.*}.o"
+    done
+    $CXX $CXXFLAGS $vflags -I"$HERE" "$src" $objs -o "$OUT/$t" -lpthread
+    echo "=== $t"
+    if "$OUT/$t"; then
+        echo "--- $t: PASS"
+    else
+        echo "--- $t: FAIL"
+        fails=$((fails + 1))
+    fi
+done
+
+[ $fails -eq 0 ] || { echo "$fails test(s) failed"; exit 1; }
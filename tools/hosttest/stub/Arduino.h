@@ -0,0 +1,142 @@
+/*
+ * Host test stub: Arduino core (ESP32 flavor)
+ *
+ * Only what the firmware uses. Time, GPIO, LEDC, tasks and queues
+ * are implemented in host.cpp; see host.h for the test-side API.
+ */
+
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#include <pgmspace.h>
+
+#ifndef ESP32
+#define ESP32 1
+#endif
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PSTR(x) (x)
+#define F(x)    (x)
+
+#define HIGH          0x1
+#define LOW           0x0
+#define INPUT         0x01
+#define OUTPUT        0x03
+#define PULLUP        0x04
+#define INPUT_PULLUP  0x05
+#define PULLDOWN      0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING    0x01
+#define FALLING   0x02
+#define CHANGE    0x03
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+uint32_t ledcSetup(uint8_t chan, uint32_t freq, uint8_t resBits);
+void     ledcAttachPin(uint8_t pin, uint8_t chan);
+void     ledcWrite(uint8_t chan, uint32_t duty);
+
+uint32_t esp_random();
+void     esp_restart();
+
+/*
+ * String: Minimal, backed by std::string
+ */
+class String {
+    public:
+        String(const char *s = "") : _s(s ? s : "") {}
+        String(const std::string& s) : _s(s) {}
+        const char *c_str() const         { return _s.c_str(); }
+        unsigned int length() const       { return _s.length(); }
+        char charAt(unsigned int i) const { return (i < _s.length()) ? _s[i] : 0; }
+        String& operator+=(const char *s) { _s += s; return *this; }
+        String& operator+=(const String& s) { _s += s._s; return *this; }
+        bool operator==(const char *s) const { return _s == s; }
+    private:
+        std::string _s;
+};
+
+/*
+ * Serial: Output goes to stdout if host_serial is set
+ */
+class HardwareSerial {
+    public:
+        void begin(unsigned long baud) {}
+        int  printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+        void print(const char *s);
+        void print(int v);
+        void println(const char *s = "");
+        void println(int v);
+        void println(const String& s) { println(s.c_str()); }
+        void flush() {}
+};
+
+extern HardwareSerial Serial;
+
+/*
+ * FreeRTOS (subset): Tasks are std::threads, queues and
+ * semaphores are mutex/condvar based. Ticks are ms.
+ */
+typedef void    *TaskHandle_t;
+typedef void    *QueueHandle_t;
+typedef void    *SemaphoreHandle_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         0
+#define pdTRUE          1
+#define pdPASS          1
+#define pdFAIL          0
+#define portMAX_DELAY   0xffffffffUL
+#define pdMS_TO_TICKS(x) ((TickType_t)(x))
+
+BaseType_t  xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack,
+                                    void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+void        vTaskDelete(TaskHandle_t task);
+void        vTaskDelay(TickType_t ticks);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+BaseType_t  xPortGetCoreID();
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t itemSize);
+void          vQueueDelete(QueueHandle_t q);
+BaseType_t    xQueueSend(QueueHandle_t q, const void *item, TickType_t wait);
+BaseType_t    xQueueReceive(QueueHandle_t q, void *item, TickType_t wait);
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+void              vSemaphoreDelete(SemaphoreHandle_t s);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t s);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait);
+
+#endif
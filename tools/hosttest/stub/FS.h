@@ -0,0 +1,90 @@
+/*
+ * Host test stub: FS
+ *
+ * An in-memory file system with optional SD-like latency; see
+ * host.h for setting up files and latency. API as in the ESP32
+ * Arduino core, as far as the firmware uses it.
+ */
+
+#ifndef _HOST_FS_H
+#define _HOST_FS_H
+
+#include <Arduino.h>
+#include <memory>
+#include <time.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+struct HostVol;
+struct HostFileState;
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File {
+    public:
+        File() {}
+        File(std::shared_ptr<HostFileState> p) : _p(p) {}
+
+        size_t write(uint8_t b);
+        size_t write(const uint8_t *buf, size_t len);
+        int    available();
+        int    read();
+        size_t read(uint8_t *buf, size_t len);
+        void   flush() {}
+        bool   seek(uint32_t pos, SeekMode mode = SeekSet);
+        size_t position() const;
+        size_t size() const;
+        void   close();
+        time_t getLastWrite();
+        const char *path() const;
+        const char *name() const;
+        bool   isDirectory();
+        File   openNextFile(const char *mode = FILE_READ);
+        String getNextFileName(bool *isDir = NULL);
+        void   rewindDirectory();
+
+        operator bool() const;
+
+    private:
+        std::shared_ptr<HostFileState> _p;
+};
+
+class FSImpl {};
+typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+class FS {
+    public:
+        FS(FSImplPtr impl);
+        File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+        File open(const String& path, const char *mode = FILE_READ, const bool create = false)
+                                      { return open(path.c_str(), mode, create); }
+        bool exists(const char *path);
+        bool exists(const String& path) { return exists(path.c_str()); }
+        bool remove(const char *path);
+        bool rename(const char *pathFrom, const char *pathTo);
+        bool mkdir(const char *path);
+        bool rmdir(const char *path);
+
+        HostVol *vol;
+};
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#define SS 5
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Host test stub: IPAddress
+ */
+
+#ifndef _HOST_IPADDRESS_H
+#define _HOST_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+    public:
+        IPAddress() {}
+        IPAddress(uint32_t a) : _a(a) {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+            : _a((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+        operator uint32_t() const { return _a; }
+        uint8_t operator[](int i) const { return (_a >> (i * 8)) & 0xff; }
+        bool fromString(const char *s)
+        {
+            unsigned int a, b, c, d;
+            if(sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) return false;
+            *this = IPAddress(a, b, c, d);
+            return true;
+        }
+        String toString() const
+        {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+            return String(buf);
+        }
+    private:
+        uint32_t _a = 0;
+};
+
+#endif
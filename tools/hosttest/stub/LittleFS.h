@@ -0,0 +1,12 @@
+/*
+ * Host test stub: LittleFS (in-memory, see FS.h)
+ */
+
+#ifndef _HOST_LITTLEFS_H
+#define _HOST_LITTLEFS_H
+
+#include <FS.h>
+
+extern fs::FS LittleFS;
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Host test stub: SPI
+ */
+
+#ifndef _HOST_SPI_H
+#define _HOST_SPI_H
+
+#include <Arduino.h>
+
+class SPIClass {
+    public:
+        void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * Host test stub: WiFi (status only, see host_wifiUp)
+ */
+
+#ifndef _HOST_WIFI_H
+#define _HOST_WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+extern bool host_wifiUp;
+
+class WiFiClass {
+    public:
+        wl_status_t status() { return host_wifiUp ? WL_CONNECTED : WL_DISCONNECTED; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
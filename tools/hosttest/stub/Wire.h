@@ -0,0 +1,40 @@
+/*
+ * Host test stub: Wire
+ *
+ * Transfers go to the device models in host.cpp (MCP4728), and
+ * are counted in host_i2c (see host.h).
+ */
+
+#ifndef _HOST_WIRE_H
+#define _HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+    public:
+        bool     begin(int sda = -1, int scl = -1, uint32_t freq = 0);
+        bool     setClock(uint32_t freq);
+        uint32_t getClock();
+        void     setTimeOut(uint16_t ms) {}
+
+        void     beginTransmission(uint8_t addr);
+        size_t   write(uint8_t b);
+        size_t   write(const uint8_t *buf, size_t len);
+        uint8_t  endTransmission(bool sendStop = true);
+
+        uint8_t  requestFrom(uint8_t addr, uint8_t len, bool sendStop = true);
+        int      available();
+        int      read();
+
+    private:
+        uint8_t  _addr = 0;
+        uint8_t  _txBuf[128];
+        size_t   _txLen = 0;
+        uint8_t  _rxBuf[128];
+        size_t   _rxLen = 0;
+        size_t   _rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host test stub: Pretend to be core 2.0.17
+ */
+
+#ifndef _HOST_ESP_ARDUINO_VERSION_H
+#define _HOST_ESP_ARDUINO_VERSION_H
+
+#define ESP_ARDUINO_VERSION_VAL(major, minor, patch) ((major << 16) | (minor << 8) | (patch))
+#define ESP_ARDUINO_VERSION_MAJOR 2
+#define ESP_ARDUINO_VERSION_MINOR 0
+#define ESP_ARDUINO_VERSION_PATCH 17
+#define ESP_ARDUINO_VERSION ESP_ARDUINO_VERSION_VAL(2, 0, 17)
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Host test stub: esp_timer
+ *
+ * Timers run on the virtual clock: host_advance() calls due
+ * callbacks in the caller's thread, in order of their due time.
+ */
+
+#ifndef _HOST_ESP_TIMER_H
+#define _HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK    0
+#define ESP_FAIL  -1
+
+typedef struct esp_timer *esp_timer_handle_t;
+
+typedef enum {
+    ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct {
+    void (*callback)(void *arg);
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+int64_t   esp_timer_get_time();
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Host test stub: lwIP sockets are POSIX sockets
+ */
+
+#ifndef _HOST_LWIP_SOCKETS_H
+#define _HOST_LWIP_SOCKETS_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define closesocket(s) close(s)
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host test stub: PROGMEM is plain memory on the host
+ */
+
+#ifndef _HOST_PGMSPACE_H
+#define _HOST_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#ifndef PSTR
+#define PSTR(x) (x)
+#endif
+#define pgm_read_byte(a)  (*(const uint8_t *)(a))
+#define pgm_read_word(a)  (*(const uint16_t *)(a))
+#define pgm_read_dword(a) (*(const uint32_t *)(a))
+#define memcpy_P(d, s, n) memcpy((d), (s), (n))
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Host test stub: GPIO input registers, built from the
+ * simulated pin levels (see host_setPin())
+ */
+
+#ifndef _HOST_GPIO_REG_H
+#define _HOST_GPIO_REG_H
+
+#include <stdint.h>
+
+#define GPIO_IN_REG   0
+#define GPIO_IN1_REG  1
+
+uint32_t host_gpioReg(int reg);
+
+#define REG_READ(r) host_gpioReg(r)
+
+#endif
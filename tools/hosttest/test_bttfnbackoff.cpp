@@ -0,0 +1,276 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: BTTFN polling under packet loss (user-048)
+ *
+ * Virtual clock. The panel polls a fake TCD on 127.0.0.2:1338 over
+ * localhost UDP, with bttfn_loop() every 5ms as from the main loop
+ * (no receive task). The fake TCD answers after a random round trip
+ * time, and drops requests or responses as told.
+ * - TCD gone for 10 minutes: Polls back off up to 30s, with jitter;
+ *   far fewer than with the old fixed interval (counted by a model
+ *   of the old rules)
+ * - TCD back: The panel reconnects within one backed off interval,
+ *   and returns to the normal interval
+ * - 30% loss, 150-300ms RTT: The response timeout follows the RTT,
+ *   the panel stays connected
+ * - NOT_PREPARE: Polls every 400ms for 20s, then back to normal
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+
+#include "host.h"
+#include <poll.h>
+
+#define TCD_IP      "127.0.0.2"
+#define LOOP_MS     5
+
+/*
+ * Fake TCD, run from the test's loop
+ */
+static int                tcdSock;
+static struct sockaddr_in dgAddr;
+static int                tcdLoss;          // % of requests lost (either way)
+static uint32_t           rttMin = 20, rttMax = 80;
+
+struct Pending {
+    uint32_t           due;
+    uint8_t            buf[BTTF_PACKET_SIZE];
+    struct sockaddr_in to;
+};
+static std::vector<Pending> pending;
+static std::vector<uint32_t> polls;         // millis() of each request
+
+static void tcd_finish(uint8_t *buf)
+{
+    uint8_t a = 0;
+
+    memcpy(buf, BTTFUDPHD, 4);
+    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
+        a += buf[i] ^ 0x55;
+    }
+    buf[BTTF_PACKET_SIZE - 1] = a;
+}
+
+static void tcd_poll()
+{
+    Pending p;
+    socklen_t fl = sizeof(p.to);
+
+    while(recvfrom(tcdSock, p.buf, BTTF_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *)&p.to, &fl) == BTTF_PACKET_SIZE) {
+        if(!check_packet(p.buf) || !p.buf[5] || (p.buf[5] & 0x80))
+            continue;
+        polls.push_back(millis());
+        if((int)(rand() % 100) < tcdLoss)
+            continue;
+        p.buf[4] = BTTFN_VERSION | 0x80;
+        p.buf[18] = 10; p.buf[19] = 0;
+        p.buf[26] = 0;
+        p.buf[31] = 0;
+        tcd_finish(p.buf);
+        p.due = millis() + rttMin + rand() % (rttMax - rttMin + 1);
+        pending.push_back(p);
+    }
+
+    for(size_t i = 0; i < pending.size(); ) {
+        if((int32_t)(millis() - pending[i].due) >= 0) {
+            sendto(tcdSock, pending[i].buf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&pending[i].to, sizeof(pending[i].to));
+            // Make sure it's there when the panel looks
+            struct pollfd pfd = { bttfnSock, POLLIN, 0 };
+            poll(&pfd, 1, 100);
+            pending.erase(pending.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+static void tcd_notify(uint8_t type)
+{
+    uint8_t buf[BTTF_PACKET_SIZE] = { 0 };
+
+    buf[4] = BTTFN_VERSION | 0x40;
+    buf[5] = type;
+    tcd_finish(buf);
+    sendto(tcdSock, buf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&dgAddr, sizeof(dgAddr));
+    struct pollfd pfd = { bttfnSock, POLLIN, 0 };
+    poll(&pfd, 1, 100);
+}
+
+static int tcd_open()
+{
+    struct sockaddr_in a;
+    int yes = 1;
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT);
+    inet_pton(AF_INET, TCD_IP, &a.sin_addr);
+    if(bind(s, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static void run_for(uint32_t ms)
+{
+    for(uint32_t t = 0; t < ms; t += LOOP_MS) {
+        bttfn_loop();
+        tcd_poll();
+        host_advance(LOOP_MS);
+    }
+}
+
+// Polls from index "from" on: Intervals
+static std::vector<uint32_t> intervals(size_t from)
+{
+    std::vector<uint32_t> v;
+
+    for(size_t i = from + 1; i < polls.size(); i++) {
+        v.push_back(polls[i] - polls[i - 1]);
+    }
+    return v;
+}
+
+// Previous rules: Response timeout 700ms; first 10 timeouts
+// trigger an immediate retry, then one poll every 1200ms
+static int old_polls(uint32_t ms)
+{
+    int n = 0, fails = 0;
+    uint32_t t = 0;
+
+    while(t < ms) {
+        n++;
+        fails++;
+        t += (fails <= 10) ? 700 : 1200;
+    }
+    return n;
+}
+
+static void test_outage()
+{
+    // Connected first
+    run_for(5000);
+    CHECK(lastBTTFNpacket != 0 && !BTTFNfailCount);
+
+    tcdLoss = 100;
+    size_t p0 = polls.size();
+    run_for(10 * 60 * 1000);
+    std::vector<uint32_t> iv = intervals(p0);
+    int n = polls.size() - p0;
+    uint32_t maxIv = 0, lastIv = 0;
+    int same = 0;
+    for(uint32_t i : iv) {
+        if(i > maxIv) maxIv = i;
+        if(i == lastIv) same++;
+        lastIv = i;
+    }
+    printf("  TCD gone for 10 min: %d polls (old rules: %d), longest interval %.1fs, %d repeated intervals\n",
+        n, old_polls(10 * 60 * 1000), maxIv / 1000.0, same);
+    CHECK(n < old_polls(10 * 60 * 1000) / 10);
+    CHECK(maxIv <= BTTFN_POLL_INT_MAX + BTTFN_POLL_INT_MAX / 4 + BTTFN_RESPONSE_TO + LOOP_MS);
+    CHECK(maxIv >= BTTFN_POLL_INT_MAX - BTTFN_POLL_INT_MAX / 4);
+    CHECK(same < 3);
+
+    // TCD back
+    tcdLoss = 0;
+    uint32_t back = millis();
+    size_t p1 = polls.size();
+    while(BTTFNfailCount && millis() - back < 60000) {
+        run_for(LOOP_MS);
+    }
+    uint32_t rec = millis() - back;
+    run_for(10000);
+    iv = intervals(polls.size() - 4);
+    printf("  TCD back: reconnected after %.1fs; then polling every %d/%d/%dms\n",
+        rec / 1000.0, iv[0], iv[1], iv[2]);
+    CHECK(polls.size() > p1);
+    CHECK(rec <= maxIv);
+    for(uint32_t i : iv) {
+        CHECK(i >= BTTFN_POLL_INT && i <= BTTFN_POLL_INT + 2 * LOOP_MS);
+    }
+}
+
+static void test_lossy()
+{
+    uint32_t maxSince = 0, minTO = 999999, maxTO = 0;
+
+    tcdLoss = 30;
+    rttMin = 150; rttMax = 300;
+    size_t p0 = polls.size();
+    for(int i = 0; i < 10 * 60 * 1000 / 100; i++) {
+        run_for(100);
+        uint32_t since = millis() - lastBTTFNpacket;
+        if(since > maxSince) maxSince = since;
+        // Timeout from the previous RTT takes a while to adapt
+        if(i < 300) continue;
+        if(BTTFNRespTO < minTO) minTO = BTTFNRespTO;
+        if(BTTFNRespTO > maxTO) maxTO = BTTFNRespTO;
+    }
+    printf("  30%% loss, RTT 150-300ms, 10 min: %d polls, response timeout %d-%dms after 30s, longest without response %.1fs\n",
+        (int)(polls.size() - p0), minTO, maxTO, maxSince / 1000.0);
+    // Above the average RTT, below the old fixed timeout
+    CHECK(minTO > (rttMin + rttMax) / 2 && maxTO < BTTFN_RESPONSE_TO);
+    // Never long enough for main_loop() to drop the connection
+    CHECK(maxSince < 30000);
+    tcdLoss = 0;
+}
+
+static void test_prepare()
+{
+    run_for(3000);
+    size_t p0 = polls.size();
+    tcd_notify(BTTFN_NOT_PREPARE);
+    run_for(BTTFN_POLL_FAST_DUR + 5000);
+
+    int fast = 0, normal = 0;
+    for(size_t i = p0 + 1; i < polls.size(); i++) {
+        uint32_t iv = polls[i] - polls[i - 1];
+        if(polls[i] - polls[p0] <= BTTFN_POLL_FAST_DUR - BTTFN_POLL_INT_FAST) {
+            fast += (iv <= BTTFN_POLL_INT_FAST + 2 * LOOP_MS);
+        } else if(polls[i] - polls[p0] > BTTFN_POLL_FAST_DUR + BTTFN_POLL_INT) {
+            normal += (iv >= BTTFN_POLL_INT);
+        }
+    }
+    printf("  NOT_PREPARE: %d polls at %dms, then %d at %dms\n", fast, BTTFN_POLL_INT_FAST, normal, BTTFN_POLL_INT);
+    CHECK(fast >= BTTFN_POLL_FAST_DUR / (BTTFN_POLL_INT_FAST + 2 * LOOP_MS) - 2);
+    CHECK(normal >= 2);
+}
+
+int main()
+{
+    host_init();
+    host_wifiUp = true;
+    host_failTaskCreate = true;         // Sockets read from the loop
+    host_seed(48);
+
+    if((tcdSock = tcd_open()) < 0) {
+        printf("  can't bind %s:%d, skipped\n", TCD_IP, BTTF_DEFAULT_LOCAL_PORT);
+        host_exit();
+    }
+    memset(&dgAddr, 0, sizeof(dgAddr));
+    dgAddr.sin_family = AF_INET;
+    dgAddr.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT);
+    dgAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    strcpy(settings.tcdIP, TCD_IP);
+    bttfn_setup();
+    CHECK(useBTTFN && !bttfnRxTask);
+
+    test_outage();
+    test_lossy();
+    test_prepare();
+
+    host_exit();
+}
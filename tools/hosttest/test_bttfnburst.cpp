@@ -0,0 +1,180 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Draining bursts of BTTFN notifications (user-045)
+ *
+ * A fake TCD sends bursts of notifications (speed, info, alarm,
+ * commands) to the BTTFN socket over localhost UDP. The main loop
+ * is modelled as one BTTFNCheckPacket() per iteration, plus 20ms
+ * (virtual) for wifi_loop() and audio_loop(). Notification-to-action
+ * latency is measured per burst, once reading one packet per
+ * iteration (as before), once with draining.
+ * Speed packets come out of order, are duplicated, and the TCD
+ * restarts its counter: Only the newest speed may show, a late
+ * packet must not let a stale duplicate through afterwards.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+
+#include "host.h"
+#include <poll.h>
+
+#define LOOP_MS     20
+#define NBURSTS     50
+#define NPKTS       13      // Packets per burst
+
+static int tcdSock;
+static struct sockaddr_in dgAddr;
+
+static void send_not(uint8_t type, uint16_t p0, uint16_t p1, uint32_t seq = 0, uint32_t cmd = 0)
+{
+    uint8_t buf[BTTF_PACKET_SIZE] = { 0 };
+    uint8_t a = 0;
+
+    memcpy(buf, BTTFUDPHD, 4);
+    buf[4] = BTTFN_VERSION | 0x40;
+    buf[5] = type;
+    if(cmd) {
+        SET32(buf, 6, cmd);
+    } else {
+        buf[6] = p0; buf[7] = p0 >> 8;
+        buf[8] = p1; buf[9] = p1 >> 8;
+    }
+    SET32(buf, 12, seq);
+    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
+        a += buf[i] ^ 0x55;
+    }
+    buf[BTTF_PACKET_SIZE - 1] = a;
+
+    sendto(tcdSock, buf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&dgAddr, sizeof(dgAddr));
+}
+
+// Wait until the socket has something to read (localhost is
+// quick, but not synchronous)
+static void wait_rx()
+{
+    struct pollfd pfd = { bttfnSock, POLLIN, 0 };
+    poll(&pfd, 1, 1000);
+}
+
+static void reset_state()
+{
+    uint32_t c;
+
+    gpsSpeed = -1;
+    tcdIsBusy = false;
+    networkAlarm = false;
+    while((c = cmdq_peek())) cmdq_pop();
+}
+
+static int cmds_queued()
+{
+    int n = 0;
+
+    for(uint32_t i = cmdQHead; i != __atomic_load_n(&cmdQTail, __ATOMIC_ACQUIRE); i++) n++;
+    return n;
+}
+
+struct Result {
+    int maxLoops;           // Loop iterations until all actions were taken
+    int sumLoops;
+    int staleSpeed;         // A speed other than the newest showed at the end
+};
+
+// One burst: 9 speed packets (one late, one duplicate), info,
+// alarm, two commands; returns loop iterations until all were
+// acted upon
+static int burst(bool old, uint32_t *seq, int *stale)
+{
+    int loops = 0;
+
+    reset_state();
+
+    uint32_t s = *seq;
+    for(int i = 0; i < 6; i++) {
+        send_not(BTTFN_NOT_SPD, (s + i) % 80, BTTFN_SSRC_GPS, s + i);
+    }
+    send_not(BTTFN_NOT_SPD, 88, BTTFN_SSRC_GPS, s + 7);          // Newest
+    send_not(BTTFN_NOT_INFO, 0, BTTFN_TCDI2_BUSY);
+    send_not(BTTFN_NOT_SPD, (s + 6) % 80, BTTFN_SSRC_GPS, s + 6); // Late
+    send_not(BTTFN_NOT_ALARM, 0, 0);
+    send_not(BTTFN_NOT_PCG_CMD, 0, 0, 0, 11);
+    send_not(BTTFN_NOT_SPD, (s + 6) % 80, BTTFN_SSRC_GPS, s + 6); // Duplicate
+    send_not(BTTFN_NOT_PCG_CMD, 0, 0, 0, 12);
+    *seq = s + 8;
+    wait_rx();
+
+    while(loops < 50) {
+        if(old) {
+            BTTFNReadPacket(millisNonZero());
+        } else {
+            BTTFNCheckPacket();
+        }
+        host_advance(LOOP_MS);
+        loops++;
+        if(gpsSpeed == 88 && tcdIsBusy && networkAlarm && cmds_queued() == 2) {
+            // The late and the duplicate one may still be pending
+            while(BTTFNReadPacket(millisNonZero())) {}
+            break;
+        }
+        // Give late-arriving datagrams a chance
+        if(loops == 1) wait_rx();
+    }
+    if(gpsSpeed != 88) (*stale)++;
+
+    return loops;
+}
+
+static Result run(bool old)
+{
+    Result r = Result();
+    uint32_t seq = 1;
+
+    for(int i = 0; i < NBURSTS; i++) {
+        int l = burst(old, &seq, &r.staleSpeed);
+        if(l > r.maxLoops) r.maxLoops = l;
+        r.sumLoops += l;
+        host_advance(500);
+        // TCD restart now and then: Counter starts over
+        if(i == NBURSTS / 2) seq = 1;
+    }
+    return r;
+}
+
+int main()
+{
+    socklen_t al = sizeof(dgAddr);
+
+    host_init();
+
+    // Our socket on an ephemeral port; no receive task, so the
+    // socket is read from the (modelled) main loop
+    CHECK((bttfnSock = bttfn_socket(0, false)) >= 0);
+    getsockname(bttfnSock, (struct sockaddr *)&dgAddr, &al);
+    dgAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK((tcdSock = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+
+    Result o = run(true);
+    Result n = run(false);
+
+    printf("  %d bursts of %d notifications, main loop iteration %dms:\n", NBURSTS, NPKTS, LOOP_MS);
+    printf("  one packet per iteration: %2d iterations (%3dms) until all actions taken, avg %.1f\n",
+        o.maxLoops, o.maxLoops * LOOP_MS, (double)o.sumLoops / NBURSTS);
+    printf("  draining:                 %2d iterations (%3dms) until all actions taken, avg %.1f\n",
+        n.maxLoops, n.maxLoops * LOOP_MS, (double)n.sumLoops / NBURSTS);
+    printf("  newest speed missed: %d (old), %d (draining)\n", o.staleSpeed, n.staleSpeed);
+
+    CHECK(!o.staleSpeed && !n.staleSpeed);
+    CHECK(n.maxLoops <= (NPKTS + BTTFN_DRAIN_MAX - 1) / BTTFN_DRAIN_MAX);
+    CHECK(n.maxLoops < o.maxLoops);
+
+    host_exit();
+}
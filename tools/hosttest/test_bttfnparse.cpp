@@ -0,0 +1,228 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: BTTFN packet parser (user-044)
+ *
+ * - Fuzzing: 10^6 packets (valid ones with random fields, valid
+ *   ones with a byte changed, short reads, random junk with the
+ *   right header) go through bttfn_parse(). It must classify each
+ *   as the previous code did, and every field read through the
+ *   views must equal the old decoding by offset (buf[26],
+ *   GET32(buf, 27), ...). Short reads are rejected.
+ * - Throughput: Packets per second through bttfn_parse() and the
+ *   dispatch (BTTFNHandlePacket(), handle_tcd_notification()), for
+ *   a mix of speed, info and NOT_DATA notifications and responses.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+
+#include "host.h"
+#include <chrono>
+
+#define FUZZ_NUM    1000000
+
+// Previous decoding, by offset
+#define OLD_GET16(a,b)  ((uint16_t)((a)[b] | ((a)[(b)+1] << 8)))
+#define OLD_GET32(a,b)  ((uint32_t)((a)[b] | ((a)[(b)+1] << 8) | ((a)[(b)+2] << 16) | ((uint32_t)(a)[(b)+3] << 24)))
+
+static int old_kind(const uint8_t *buf)
+{
+    if(!check_packet(buf))
+        return BTTFN_PKT_INVALID;
+    if((buf[4] & 0x4f) == (BTTFN_VERSION | 0x40))
+        return BTTFN_PKT_NOT;
+    if((buf[4] & 0x8f) == (BTTFN_VERSION | 0x80))
+        return BTTFN_PKT_RSP;
+    return BTTFN_PKT_INVALID;
+}
+
+// Number of fields that differ from the old decoding
+static int compare(const union bttfnPacket *p, const uint8_t *buf)
+{
+    int bad = 0;
+
+    bad += (p->rsp.flags   != buf[5]);
+    bad += (p->rsp.id      != OLD_GET32(buf, 6));
+    bad += (p->rsp.speed   != (int16_t)OLD_GET16(buf, 18));
+    bad += (p->rsp.ssid7   != (char)buf[18]);
+    bad += ((p->rsp.pwMark & 0x01) != (buf[19] & 0x01));
+    bad += (p->rsp.status  != buf[26]);
+    bad += (p->rsp.session != OLD_GET32(buf, 27));
+    bad += (p->rsp.caps    != buf[31]);
+    bad += !!memcmp(p->rsp.ssid, &buf[41], 6);
+    bad += (p->ntf.type    != buf[5]);
+    bad += (p->ntf.cmd     != OLD_GET32(buf, 6));
+    bad += (p->ntf.p0      != OLD_GET16(buf, 6));
+    bad += (p->ntf.p1      != OLD_GET16(buf, 8));
+    bad += (p->ntf.seq     != OLD_GET32(buf, 12));
+
+    return bad;
+}
+
+static void finish(uint8_t *buf)
+{
+    uint8_t a = 0;
+
+    memcpy(buf, BTTFUDPHD, 4);
+    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
+        a += buf[i] ^ 0x55;
+    }
+    buf[BTTF_PACKET_SIZE - 1] = a;
+}
+
+static void randomPacket(uint8_t *buf)
+{
+    static const uint8_t vers[] = { 0x41, 0xc1, 0x81, 0x01, 0x42, 0x82, 0x51, 0x91 };
+
+    for(int i = 0; i < BTTF_PACKET_SIZE; i++) buf[i] = rand();
+    buf[4] = vers[rand() % sizeof(vers)];
+    finish(buf);
+}
+
+static void test_fuzz()
+{
+    uint8_t buf[BTTF_PACKET_SIZE];
+    int cnt[3] = { 0 }, shortRd = 0, wrongKind = 0, wrongField = 0;
+
+    host_seed(44);
+    for(int n = 0; n < FUZZ_NUM; n++) {
+        int len = BTTF_PACKET_SIZE, kind;
+
+        randomPacket(buf);
+        switch(rand() % 4) {
+        case 0:
+            break;
+        case 1:
+            // Change one byte
+            buf[rand() % BTTF_PACKET_SIZE] ^= 1 + rand() % 255;
+            break;
+        case 2:
+            len = rand() % BTTF_PACKET_SIZE;
+            break;
+        default:
+            for(int i = 4; i < BTTF_PACKET_SIZE; i++) buf[i] = rand();
+            break;
+        }
+
+        const union bttfnPacket *p = bttfn_parse(buf, len, &kind);
+        int ok = (len < BTTF_PACKET_SIZE) ? BTTFN_PKT_INVALID : old_kind(buf);
+
+        if(len < BTTF_PACKET_SIZE) shortRd++;
+        if(kind != ok || (!p) != (kind == BTTFN_PKT_INVALID)) {
+            if(wrongKind++ < 5) {
+                printf("  packet %d (len %d, ver %02x): kind %d, expected %d\n", n, len, buf[4], kind, ok);
+            }
+            continue;
+        }
+        cnt[kind]++;
+        if(p) {
+            CHECK((const uint8_t *)p == buf);
+            wrongField += compare(p, buf);
+        }
+    }
+
+    printf("  fuzz: %d packets; %d notifications, %d responses, %d invalid (%d short reads)\n",
+        FUZZ_NUM, cnt[BTTFN_PKT_NOT], cnt[BTTFN_PKT_RSP], cnt[BTTFN_PKT_INVALID], shortRd);
+    printf("        %d wrongly classified, %d fields differ from the old decoding\n", wrongKind, wrongField);
+
+    CHECK(!wrongKind);
+    CHECK(!wrongField);
+    CHECK(cnt[BTTFN_PKT_NOT] > FUZZ_NUM / 20 && cnt[BTTFN_PKT_RSP] > FUZZ_NUM / 20);
+}
+
+// Packet mix as in a busy network: Speed, info, NOT_DATA, response
+#define MIX_NUM     1024
+
+static uint8_t mix[MIX_NUM][BTTF_PACKET_SIZE];
+
+static void buildMix()
+{
+    uint32_t seq = 1;
+
+    for(int i = 0; i < MIX_NUM; i++) {
+        uint8_t *b = mix[i];
+        memset(b, 0, BTTF_PACKET_SIZE);
+        switch(i % 4) {
+        case 0:
+        case 1:
+            b[4] = BTTFN_VERSION | 0x40;
+            b[5] = BTTFN_NOT_SPD;
+            b[6] = i % 89;
+            b[8] = BTTFN_SSRC_GPS;
+            SET32(b, 12, seq);
+            break;
+        case 2:
+            b[4] = BTTFN_VERSION | 0x40;
+            b[5] = (i & 4) ? BTTFN_NOT_INFO : (BTTFN_NOT_DATA | 0x12);
+            SET32(b, 6, seq);
+            b[26] = 0x01;
+            SET32(b, 27, 0x1234);
+            break;
+        default:
+            b[4] = BTTFN_VERSION | 0x80;
+            b[5] = 0x12;
+            b[18] = 42;
+            b[26] = 0x10;
+            break;
+        }
+        seq++;
+        finish(b);
+    }
+}
+
+static void test_throughput()
+{
+    static struct bttfnRxPkt rx;
+    uint64_t pkts = 0;
+    int handled = 0;
+
+    buildMix();
+    TCDSupportsNOTData = true;
+    BTTFUDPID = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    double sec;
+    do {
+        for(int r = 0; r < 100; r++) {
+            for(int i = 0; i < MIX_NUM; i++) {
+                // Reset sequence counters, so each round is accepted
+                if(mix[i][5] == BTTFN_NOT_SPD) {
+                    bttfnTCDSeqCnt = 0;
+                } else {
+                    bttfnTCDDataSeqCnt = 0;
+                }
+                if(bttfn_parse(mix[i], BTTF_PACKET_SIZE, &rx.kind)) {
+                    memcpy(rx.buf, mix[i], BTTF_PACKET_SIZE);
+                    BTTFNHandlePacket(&rx, millis());
+                    handled++;
+                }
+            }
+            pkts += MIX_NUM;
+        }
+        sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while(sec < 0.5);
+
+    printf("  throughput: %.1f million packets/s through parse and dispatch\n", pkts / sec / 1e6);
+
+    CHECK(handled == (int)pkts);
+    CHECK(gpsSpeed >= 0 && gpsSpeed <= 88);
+    CHECK(pkts / sec > 100000);
+}
+
+int main()
+{
+    host_init();
+
+    test_fuzz();
+    test_throughput();
+
+    host_exit();
+}
@@ -0,0 +1,281 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: BTTFN receive task over POSIX UDP (user-046)
+ *
+ * Real time, under ThreadSanitizer. bttfn_setup() opens the
+ * sockets and starts the receive task (a thread here) as on the
+ * ESP32. A fake TCD runs in another thread on 127.0.0.2:1338 and
+ * answers polls; the panel listens on 1338 on all addresses.
+ * - Polls are answered, the panel is connected
+ * - While the main loop is stuck for 300ms, speed packets are
+ *   timestamped on arrival, not when the loop gets to them
+ * - A TT notification during a stall: The lead is reduced by the
+ *   time the packet waited in the queue
+ * - A burst larger than the queue: What doesn't fit is dropped and
+ *   counted, the rest is handled in order
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+// HOSTTEST: tsan
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+
+#include "host.h"
+#include <atomic>
+#include <thread>
+
+#define TCD_IP      "127.0.0.2"
+#define STALL_MS    300
+
+/*
+ * Fake TCD
+ */
+enum { JOB_NONE, JOB_SPEED, JOB_TT, JOB_FLOOD };
+
+static int                    tcdSock;
+static struct sockaddr_in     dgAddr;
+static std::atomic<bool>      tcdStop;
+static std::atomic<int>       tcdJob;
+static std::atomic<int>       tcdRequests;
+static std::atomic<int>       tcdSpeed(42);    // Current speed, as sent last
+static std::atomic<uint32_t>  sentAt[64];       // millis() per sequence number
+
+static void tcd_send(uint8_t *buf)
+{
+    uint8_t a = 0;
+
+    memcpy(buf, BTTFUDPHD, 4);
+    for(int i = 4; i < BTTF_PACKET_SIZE - 1; i++) {
+        a += buf[i] ^ 0x55;
+    }
+    buf[BTTF_PACKET_SIZE - 1] = a;
+}
+
+static void tcd_not(uint8_t type, uint16_t p0, uint16_t p1, uint32_t seq)
+{
+    uint8_t buf[BTTF_PACKET_SIZE] = { 0 };
+
+    buf[4] = BTTFN_VERSION | 0x40;
+    buf[5] = type;
+    buf[6] = p0; buf[7] = p0 >> 8;
+    buf[8] = p1; buf[9] = p1 >> 8;
+    SET32(buf, 12, seq);
+    tcd_send(buf);
+    if(type == BTTFN_NOT_SPD) tcdSpeed = p0;
+    sentAt[seq % 64] = millis();
+    sendto(tcdSock, buf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&dgAddr, sizeof(dgAddr));
+}
+
+static void tcd_answer()
+{
+    uint8_t buf[BTTF_PACKET_SIZE];
+    struct sockaddr_in from;
+    socklen_t fl = sizeof(from);
+
+    if(recvfrom(tcdSock, buf, BTTF_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *)&from, &fl) != BTTF_PACKET_SIZE)
+        return;
+    if(!check_packet(buf) || !buf[5] || (buf[5] & 0x80))
+        return;
+
+    tcdRequests++;
+    buf[4] = BTTFN_VERSION | 0x80;
+    buf[18] = tcdSpeed; buf[19] = 0;   // Speed
+    buf[26] = 0;                    // Status
+    buf[31] = 0;                    // Caps: Poll speed and status
+    tcd_send(buf);
+    sendto(tcdSock, buf, BTTF_PACKET_SIZE, 0, (struct sockaddr *)&from, fl);
+}
+
+static void tcd_task()
+{
+    uint32_t seq = 1;
+
+    while(!tcdStop) {
+        fd_set rfds;
+        struct timeval tv = { 0, 2000 };
+        FD_ZERO(&rfds);
+        FD_SET(tcdSock, &rfds);
+        if(select(tcdSock + 1, &rfds, NULL, NULL, &tv) > 0) {
+            tcd_answer();
+        }
+
+        switch(tcdJob.exchange(JOB_NONE)) {
+        case JOB_SPEED:
+            // 12 speed packets, 20ms apart
+            for(int i = 0; i < 12; i++) {
+                tcd_not(BTTFN_NOT_SPD, 10 + i, BTTFN_SSRC_GPS, seq++);
+                delay(20);
+            }
+            break;
+        case JOB_TT:
+            delay(50);
+            tcd_not(BTTFN_NOT_TT, 5000, 6000, seq++);
+            break;
+        case JOB_FLOOD:
+            for(int i = 0; i < 40; i++) {
+                tcd_not(BTTFN_NOT_SPD, 40 + i, BTTFN_SSRC_GPS, seq++);
+                delay(1);
+            }
+            break;
+        }
+    }
+}
+
+static int tcd_open()
+{
+    struct sockaddr_in a;
+    int yes = 1;
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT);
+    inet_pton(AF_INET, TCD_IP, &a.sin_addr);
+    if(bind(s, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+/*
+ * Panel side
+ */
+static void loop_for(uint32_t ms)
+{
+    uint32_t t0 = millis();
+
+    while(millis() - t0 < ms) {
+        bttfn_loop();
+        delay(5);
+    }
+}
+
+// Run a TCD job while the main loop is stuck
+static void stall(int job)
+{
+    tcdJob = job;
+    delay(STALL_MS);
+}
+
+static int queued(struct bttfnRxQueue *q)
+{
+    return (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) - q->tail) & (BTTFN_RXQ_LEN - 1);
+}
+
+static void test_connect()
+{
+    loop_for(2000);
+    printf("  connect: %d polls answered, response timeout %lums\n", (int)tcdRequests, BTTFNRespTO);
+    CHECK(tcdRequests >= 1);
+    CHECK(lastBTTFNpacket != 0);
+    CHECK(BTTFNHaveRTT && !BTTFNfailCount);
+    CHECK(gpsSpeed == 42);
+}
+
+static void test_timestamps()
+{
+    uint32_t maxLag = 0, maxWait = 0;
+
+    stall(JOB_SPEED);
+    // Speed packets come every 20ms for 240ms; allow for a slow host
+    delay(100);
+
+    int n = queued(&bttfnRxQ);
+    uint32_t now = millis();
+    for(int i = 0; i < n; i++) {
+        struct bttfnRxPkt *p = &bttfnRxQ.pkt[(bttfnRxQ.tail + i) & (BTTFN_RXQ_LEN - 1)];
+        if(p->kind != BTTFN_PKT_NOT) continue;
+        uint32_t lag = p->time - sentAt[((union bttfnPacket *)p->buf)->ntf.seq % 64];
+        uint32_t wait = now - p->time;
+        if(lag > maxLag) maxLag = lag;
+        if(wait > maxWait) maxWait = wait;
+    }
+    loop_for(20);
+
+    printf("  main loop stuck: %d packets queued; arrival timestamped %dms after sending, waited up to %dms\n",
+        n, maxLag, maxWait);
+    CHECK(n >= 12);
+    CHECK(maxLag <= 10);
+    CHECK(maxWait >= STALL_MS - 50);
+    CHECK(gpsSpeed == 21);
+}
+
+static void test_ttlead()
+{
+    networkTimeTravel = false;
+    stall(JOB_TT);
+    uint32_t t0 = millis();
+    bttfn_loop();
+    uint32_t t1 = millis();
+    uint32_t sent = sentAt[0];
+    for(int i = 0; i < 64; i++) {
+        if((int32_t)(sentAt[i] - sent) > 0) sent = sentAt[i];
+    }
+
+    printf("  TT during stall: lead %d, packet waited %dms\n", networkLead, t0 - sent);
+    CHECK(networkTimeTravel);
+    CHECK(networkP1 == 6000);
+    CHECK(networkLead <= 5000 - (t0 - sent) + 10);
+    CHECK(networkLead >= 5000 - (t1 - sent) - 10);
+    networkTimeTravel = false;
+}
+
+static void test_overflow()
+{
+    uint32_t d0 = __atomic_load_n(&bttfnRxQ.dropped, __ATOMIC_RELAXED);
+
+    stall(JOB_FLOOD);
+    delay(100);
+    int n = queued(&bttfnRxQ);
+    uint32_t d = __atomic_load_n(&bttfnRxQ.dropped, __ATOMIC_RELAXED) - d0;
+    // Not through bttfn_loop(): A poll response would set the
+    // TCD's current speed
+    while(BTTFNReadPacket(millisNonZero())) {}
+
+    printf("  burst of 40: %d queued, %d dropped; speed after %d\n", n, d, gpsSpeed);
+    CHECK(n == BTTFN_RXQ_LEN - 1);
+    CHECK(n + d == 40);
+    // The last one to fit in the queue (speeds are 40-79)
+    CHECK(gpsSpeed == 40 + n - 1);
+    CHECK(!queued(&bttfnRxQ));
+}
+
+int main()
+{
+    host_init(true);
+    host_wifiUp = true;
+
+    if((tcdSock = tcd_open()) < 0) {
+        printf("  can't bind %s:%d, skipped\n", TCD_IP, BTTF_DEFAULT_LOCAL_PORT);
+        host_exit();
+    }
+    memset(&dgAddr, 0, sizeof(dgAddr));
+    dgAddr.sin_family = AF_INET;
+    dgAddr.sin_port = htons(BTTF_DEFAULT_LOCAL_PORT);
+    dgAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::thread tcd(tcd_task);
+
+    strcpy(settings.tcdIP, TCD_IP);
+    bttfn_setup();
+    CHECK(useBTTFN);
+    CHECK(bttfnRxTask != NULL);
+
+    test_connect();
+    test_timestamps();
+    test_ttlead();
+    test_overflow();
+
+    tcdStop = true;
+    tcd.join();
+
+    host_exit();
+}
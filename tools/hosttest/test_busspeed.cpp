@@ -0,0 +1,65 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: I2C bus speed negotiation (user-034)
+ *
+ * Gauges::begin() on buses whose maximum reliable clock differs
+ * (reads above it return corrupted data):
+ * - 400kHz is used if readbacks at 400kHz are good, never more
+ * - Otherwise, 100kHz
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+
+#include "host.h"
+
+static uint32_t negotiate(uint32_t maxClock)
+{
+    Gauges gauges;
+    struct dgI2CStats st;
+
+    host_i2cMaxClock = maxClock;
+    Wire.setClock(100000);
+    _i2cClock = 100000;
+    gauges.begin(3, 3, 4);
+    gauges.getI2CStats(&st);
+
+    CHECK(st.clock == Wire.getClock());
+    // Readback at chosen speed is good
+    uint8_t buf[24];
+    I2CJob job;
+    int len = 0;
+    i2c_setupWrite(&job, 0x60);
+    job.rdLen = 24;
+    job.rdBuf = buf;
+    CHECK(!i2c_transfer(&job, &len) && len == 24);
+    CHECK(buf[0] == 0xc0 && buf[6] == 0xd0);
+
+    return st.clock;
+}
+
+int main()
+{
+    host_init();
+    host_failTaskCreate = true;
+
+    uint32_t c1 = negotiate(1000000);
+    uint32_t c2 = negotiate(400000);
+    uint32_t c3 = negotiate(100000);
+
+    printf("  bus good up to 1MHz: %d, 400kHz: %d, 100kHz: %d\n", c1, c2, c3);
+
+    CHECK(c1 == 400000);
+    CHECK(c2 == 400000);
+    CHECK(c3 == 100000);
+
+    host_exit();
+}
@@ -0,0 +1,202 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Calibration curves (user-035)
+ *
+ * Three analog gauges on the MCP4728 model.
+ * - Without a curve, values are linear as before
+ * - Fixed and random curves: DAC values match a double precision
+ *   piecewise-linear reference within one LSB, at whole and
+ *   fractional percents, and never decrease
+ * - Malformed curves are rejected, and the gauge falls back to
+ *   linear
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "host.h"
+
+// Test needs setValue() for fractional percents
+#define private public
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+#undef private
+
+#include <string>
+
+static Gauges gauges;
+
+// Reference: Interpolate over (0:0), points, (100:100)
+static double ref(const std::vector<int>& x, const std::vector<int>& y, double p)
+{
+    std::vector<int> xs = { 0 }, ys = { 0 };
+
+    for(size_t i = 0; i < x.size(); i++) {
+        if(!i && !x[0]) { ys[0] = y[0]; continue; }
+        xs.push_back(x[i]); ys.push_back(y[i]);
+    }
+    if(xs.back() < 100) { xs.push_back(100); ys.push_back(100); }
+
+    for(size_t i = 1; i < xs.size(); i++) {
+        if(p <= xs[i]) {
+            return ys[i-1] + (double)(ys[i] - ys[i-1]) * (p - xs[i-1]) / (xs[i] - xs[i-1]);
+        }
+    }
+    return ys.back();
+}
+
+// Returns the largest deviation from the reference in LSB, and
+// counts decreasing steps
+static int check(int g, const std::vector<int>& x, const std::vector<int>& y, int& nonMono)
+{
+    double maxV = gauges._max[g];
+    int maxErr = 0;
+    uint16_t prev = 0;
+
+    nonMono = 0;
+    for(int t = 0; t <= 1000; t++) {
+        double p = t / 10.0;
+        gauges.setValue(g, (float)p);
+        uint16_t v = gauges._values[g];
+        int err = abs((int)v - (int)lround(maxV * ref(x, y, p) / 100.0));
+        if(err > maxErr) maxErr = err;
+        if(t && v < prev) nonMono++;
+        prev = v;
+    }
+
+    // And through the public API to the DAC
+    for(int p = 0; p <= 100; p += 5) {
+        gauges.setValuePercent(g, p);
+        gauges.UpdateAll();
+        int err = abs((int)host_dac.out[g] - (int)lround(maxV * ref(x, y, p) / 100.0));
+        if(err > maxErr) maxErr = err;
+    }
+
+    return maxErr;
+}
+
+static std::string curveStr(const std::vector<int>& x, const std::vector<int>& y)
+{
+    std::string s;
+    for(size_t i = 0; i < x.size(); i++) {
+        if(i) s += (i & 1) ? "," : ", ";
+        s += std::to_string(x[i]) + ":" + std::to_string(y[i]);
+    }
+    return s;
+}
+
+static void test_linear()
+{
+    int nm;
+
+    for(int g = 0; g < 3; g++) {
+        CHECK(gauges.setCalibration(g, ""));
+        CHECK(check(g, {}, {}, nm) <= 1);
+        CHECK(!nm);
+    }
+}
+
+static void test_fixed()
+{
+    static const struct {
+        const char *curve;
+        std::vector<int> x, y;
+    } c[] = {
+        { "25:15,50:40,75:70",  { 25, 50, 75 },     { 15, 40, 70 } },
+        { " 10:30 , 90:95 ",    { 10, 90 },         { 30, 95 } },
+        { "0:10,100:90",        { 0, 100 },         { 10, 90 } },
+        { "20:0,40:0,60:50",    { 20, 40, 60 },     { 0, 0, 50 } },     // flat part
+        { "50:100",             { 50 },             { 100 } },
+        { "1:2,2:4,3:6,4:8,5:10,6:12,7:14,8:16,9:18,10:20,11:22,12:24",
+                                { 1,2,3,4,5,6,7,8,9,10,11,12 }, { 2,4,6,8,10,12,14,16,18,20,22,24 } },
+    };
+    int nm;
+
+    for(size_t i = 0; i < sizeof(c) / sizeof(c[0]); i++) {
+        int g = i % 3;
+        CHECK(gauges.setCalibration(g, c[i].curve));
+        int err = check(g, c[i].x, c[i].y, nm);
+        printf("  \"%s\": max error %d LSB\n", c[i].curve, err);
+        CHECK(err <= 1);
+        CHECK(!nm);
+    }
+}
+
+static void test_random()
+{
+    int worst = 0, nm, totalNm = 0;
+
+    host_seed(35);
+    for(int n = 0; n < 2000; n++) {
+        std::vector<int> x, y;
+        int num = 1 + rand() % 12, lx = 0, ly = 0;
+        for(int i = 0; i < num && lx < 100; i++) {
+            lx += 1 + rand() % ((100 - lx) < 20 ? (100 - lx) : 20);
+            ly += rand() % (101 - ly > 25 ? 25 : 101 - ly);
+            x.push_back(lx);
+            y.push_back(ly);
+        }
+        int g = n % 3;
+        std::string s = curveStr(x, y);
+        if(!gauges.setCalibration(g, s.c_str())) {
+            printf("  rejected valid curve \"%s\"\n", s.c_str());
+            host_fails++;
+            continue;
+        }
+        int err = check(g, x, y, nm);
+        if(err > worst) worst = err;
+        totalNm += nm;
+    }
+    printf("  2000 random curves: max error %d LSB, %d decreasing steps\n", worst, totalNm);
+    CHECK(worst <= 1);
+    CHECK(!totalNm);
+}
+
+static void test_bad()
+{
+    static const char *bad[] = {
+        "50:40,40:50",          // scale not ascending
+        "50:40,50:50",          // scale repeated
+        "25:30,50:20",          // voltage decreasing
+        "101:50",               // out of range
+        "50:101",
+        "50",                   // no voltage
+        "50:",
+        ":50",
+        "a:b",
+        "50;40",
+        "1:1,2:2,3:3,4:4,5:5,6:6,7:7,8:8,9:9,10:10,11:11,12:12,13:13",  // too many
+    };
+    int nm;
+
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        int g = i % 3;
+        CHECK(gauges.setCalibration(g, "25:75"));
+        CHECK(!gauges.setCalibration(g, bad[i]));
+        CHECK(check(g, {}, {}, nm) <= 1);
+    }
+}
+
+int main()
+{
+    host_init();
+    host_failTaskCreate = true;         // I2C synchronous, deterministic
+    host_dac.ldacLow = true;
+
+    // Generic 0-5V gauges
+    CHECK(gauges.begin(3, 3, 4));
+
+    test_linear();
+    test_fixed();
+    test_random();
+    test_bad();
+
+    host_exit();
+}
@@ -0,0 +1,174 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Draining a burst of 16 commands (user-050)
+ *
+ * Boots the firmware (three analog gauges, key sounds on SD with
+ * SD latency), and queues a burst of 16 commands as from the TCD
+ * keypad or MQTT: volume steps, key sounds, gauge percentages,
+ * volume level, shuffle. main_loop() runs with a wifi_loop() of
+ * 10ms, as with MQTT connected.
+ * - Time and loop iterations until the burst is drained, with
+ *   batches vs. one command per iteration (as before; commands are
+ *   fed one at a time)
+ * - Both end in the same state
+ * - A time travel command in the middle of a burst ends the batch;
+ *   the rest waits until the time travel is over
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+#include "../../dashgauges-A10001986/src/SD/SD.h"
+
+#include "host.h"
+
+#define WIFI_LOOP_US    10000
+
+static const uint32_t burst[16] = {
+    1015, 1015, 501, 1015, 150, 1016, 503, 450,
+    1015, 750, 504, 1016, 310, 555, 1015, 506
+};
+
+struct State {
+    int  vol;
+    int  idle[3];
+    bool shuffle;
+};
+
+static State state()
+{
+    State s = { aud_state.curVolume, { left_gauge_idle, center_gauge_idle, right_gauge_idle }, !!aud_state.mpShuffle };
+    return s;
+}
+
+// As loop() in the sketch
+static void step()
+{
+    main_loop();
+    audio_loop();
+    wifi_loop();
+    audio_loop();
+    bttfn_loop();
+    host_advance(1);
+}
+
+static void reset()
+{
+    aud_state.curVolume = 5;
+    aud_state.mpShuffle = 0;
+    left_gauge_idle = center_gauge_idle = right_gauge_idle = 60;
+    for(int i = 0; i < 2000; i++) step();
+}
+
+// Returns loop iterations until drained; *ms: virtual time
+static int drain(bool batch, uint32_t *ms)
+{
+    int loops = 0, next = 0;
+    uint32_t t0 = millis();
+
+    if(batch) {
+        for(int i = 0; i < 16; i++) addCmdQueue(burst[i]);
+        next = 16;
+    }
+    while(next < 16 || cmdq_peek()) {
+        if(!batch && !cmdq_peek()) addCmdQueue(burst[next++]);
+        step();
+        loops++;
+    }
+    *ms = millis() - t0;
+
+    return loops;
+}
+
+static void test_drain()
+{
+    uint32_t oms, nms;
+
+    reset();
+    int ol = drain(false, &oms);
+    State os = state();
+
+    reset();
+    int nl = drain(true, &nms);
+    State ns = state();
+
+    printf("  16 commands, wifi_loop() %dms:\n", WIFI_LOOP_US / 1000);
+    printf("  one per iteration: %2d iterations, %3dms\n", ol, oms);
+    printf("  batches:           %2d iterations, %3dms\n", nl, nms);
+
+    CHECK(nl < ol);
+    CHECK(nms < oms);
+    CHECK(!memcmp(&os, &ns, sizeof(os)));
+    // Last volume command: 310, then one step up
+    CHECK(ns.vol == 11);
+    CHECK(ns.idle[0] == 50 && ns.idle[1] == 50 && ns.idle[2] == 50);
+    CHECK(ns.shuffle);
+}
+
+static void test_gating()
+{
+    reset();
+    addCmdQueue(1015);
+    addCmdQueue(1000);                  // Time travel
+    addCmdQueue(1016);
+    addCmdQueue(1016);
+    step();
+    CHECK(TTrunning);
+    CHECK(aud_state.curVolume == 6);
+    CHECK(cmdq_peek() == 1016);
+
+    // The rest is taken in the iteration the time travel ends
+    int ms = 0, early = 0;
+    while(TTrunning && ms < 60000) {
+        if(cmdq_peek() != 1016) early++;
+        step();
+        ms++;
+    }
+    printf("  time travel in a burst: rest waited %.1fs until it was over\n", ms / 1000.0);
+    CHECK(!TTrunning);
+    CHECK(!early);
+    CHECK(!cmdq_peek());
+    CHECK(aud_state.curVolume == 4);
+}
+
+int main()
+{
+    host_init();
+    host_failTaskCreate = true;         // I2C synchronous, deterministic
+
+    strcpy(settings.gaugeIDA, "3");
+    strcpy(settings.gaugeIDB, "3");
+    strcpy(settings.gaugeIDC, "4");
+
+    // Key sounds on SD; SD over SPI: ~5ms per open
+    for(int i = 1; i < 10; i++) {
+        char fn[16];
+        sprintf(fn, "/key%d.mp3", i);
+        host_fsAddFile(SD, fn, 4096);
+    }
+    host_fsSetLatency(SD, { 5000, 1000, 0 });
+
+    powerupMillis = millis();
+    Wire.begin(-1, -1, 100000);
+    main_boot();
+    main_boot2();
+    audio_setup();
+    main_setup();
+    CHECK(haveSD);
+
+    // Startup sequence
+    for(int i = 0; i < 5000; i++) step();
+    host_wifiLoopUs = WIFI_LOOP_US;
+
+    test_drain();
+    test_gating();
+
+    host_exit();
+}
@@ -0,0 +1,118 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Command queue with multiple producers (user-049)
+ *
+ * Under ThreadSanitizer. Four producer threads (standing in for
+ * MQTT, BTTFN and the web interface) push commands through
+ * addCmdQueue() as fast as they can, while the main thread takes
+ * them with cmdq_peek()/cmdq_pop(); once as fast as it can, once
+ * with pauses so that the queue runs full.
+ * - Every command is either delivered or counted as dropped
+ * - No command is delivered twice, none is corrupted
+ * - Commands of each producer come in the order they were queued
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_main
+// HOSTTEST: tsan
+
+#include "../../dashgauges-A10001986/dg_main.cpp"
+
+#include "host.h"
+#include <atomic>
+#include <thread>
+
+#define NPROD       4
+#define PER_PROD    100000
+
+static std::atomic<int> prodDone;
+
+// Command: Producer in bits 24-27, sequence number below
+static void producer(int id)
+{
+    for(uint32_t s = 1; s <= PER_PROD; s++) {
+        addCmdQueue(((uint32_t)(id + 1) << 24) | s);
+        // Let the others (and the consumer) in
+        std::this_thread::yield();
+    }
+    prodDone++;
+}
+
+struct Result {
+    uint32_t delivered;
+    uint32_t dropped;
+    int      bad;           // Corrupted, duplicate or out of order
+};
+
+static Result run(bool slow)
+{
+    Result r = Result();
+    uint32_t last[NPROD] = { 0 };
+    uint32_t d0 = __atomic_load_n(&cmdQDropped, __ATOMIC_RELAXED);
+    std::thread prod[NPROD];
+
+    prodDone = 0;
+    for(int i = 0; i < NPROD; i++) {
+        prod[i] = std::thread(producer, i);
+    }
+
+    for(;;) {
+        // Read before looking at the queue: If all were done
+        // then, an empty queue means we have everything
+        bool done = (prodDone == NPROD);
+        uint32_t c = cmdq_peek();
+        if(!c) {
+            if(done) break;
+            std::this_thread::yield();
+            continue;
+        }
+        cmdq_pop();
+        r.delivered++;
+
+        int p = (c >> 24) - 1;
+        uint32_t s = c & 0xffffff;
+        if(p < 0 || p >= NPROD || s > PER_PROD || s <= last[p]) {
+            if(r.bad++ < 5) {
+                printf("  command %08x after %08x\n", c, (p >= 0 && p < NPROD) ? last[p] : 0);
+            }
+        } else {
+            last[p] = s;
+        }
+
+        if(slow && !(r.delivered % 64)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    for(int i = 0; i < NPROD; i++) {
+        prod[i].join();
+    }
+    r.dropped = __atomic_load_n(&cmdQDropped, __ATOMIC_RELAXED) - d0;
+
+    return r;
+}
+
+int main()
+{
+    host_init();
+
+    for(int slow = 0; slow < 2; slow++) {
+        Result r = run(slow);
+        printf("  %s consumer: %d producers x %d commands; %d delivered, %d dropped (queue full), %d bad\n",
+            slow ? "slow" : "fast", NPROD, PER_PROD, r.delivered, r.dropped, r.bad);
+        CHECK(r.delivered + r.dropped == NPROD * PER_PROD);
+        CHECK(!r.bad);
+        if(slow) {
+            CHECK(r.dropped > 0);
+        }
+    }
+    CHECK(!cmdq_peek());
+
+    host_exit();
+}
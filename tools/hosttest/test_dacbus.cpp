@@ -0,0 +1,128 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: I2C bus traffic of DAC updates (user-032)
+ *
+ * Boots the firmware with three analog gauges on the MCP4728 model,
+ * and runs a full time travel sequence (stand-alone time travel,
+ * drain, empty alarm, refill) through main_loop(). Counts bytes on
+ * the bus, once sending all channels on every update (as before),
+ * once with only changed channels sent, and nothing if nothing
+ * changed.
+ * LDAC is high, as it may be on real hardware: The DAC outputs must
+ * follow the gauge values all the time.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "host.h"
+
+// Test needs to force a resync of all channels
+#define private public
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+#undef private
+
+#include "../../dashgauges-A10001986/dg_settings.h"
+#include "../../dashgauges-A10001986/dg_main.h"
+#include "../../dashgauges-A10001986/dg_audio.h"
+
+struct Result {
+    uint32_t txns;
+    uint32_t bytes;
+    int      mismatches;        // DAC output != gauge value after an update
+    uint32_t ms;
+};
+
+static bool resendAll;
+
+static void step(Result& r)
+{
+    uint32_t tx = host_i2c.txns;
+
+    if(resendAll) gauges._dacResync = true;
+    main_loop();
+    audio_loop();
+    if(host_i2c.txns != tx) {
+        for(int i = 0; i < 3; i++) {
+            if(host_dac.out[i] != gauges._values[i]) r.mismatches++;
+        }
+    }
+    host_advance(1);
+    r.ms++;
+}
+
+static Result sequence(bool old)
+{
+    Result r = Result();
+    uint32_t tx = host_i2c.txns, by = host_i2c.bytes;
+
+    resendAll = old;
+
+    addCmdQueue(1000);                  // MQTT "TIMETRAVEL"
+    do {
+        step(r);
+    } while(r.ms < 100 || TTrunning);
+    for(int i = 0; i < 3000; i++) step(r);
+
+    refill_plutonium();
+    do {
+        step(r);
+    } while(refill || refillWA);
+    for(int i = 0; i < 2000; i++) step(r);
+
+    r.txns = host_i2c.txns - tx;
+    r.bytes = host_i2c.bytes - by;
+
+    return r;
+}
+
+int main()
+{
+    Result dummy = Result();
+
+    host_init();
+    host_failTaskCreate = true;         // I2C synchronous, deterministic
+    host_dac.ldacLow = false;
+
+    // Generic 0-5V gauges
+    strcpy(settings.gaugeIDA, "3");
+    strcpy(settings.gaugeIDB, "3");
+    strcpy(settings.gaugeIDC, "4");
+
+    powerupMillis = millis();
+    Wire.begin(-1, -1, 100000);
+    main_boot();
+    main_boot2();
+    audio_setup();
+    main_setup();
+
+    // Startup sequence
+    for(int i = 0; i < 5000; i++) step(dummy);
+    CHECK(gauges.getValuePercent(0) != 0);
+
+    Result o = sequence(true);
+    Result n = sequence(false);
+
+    printf("  time travel sequence of %.1fs:\n", n.ms / 1000.0);
+    printf("  all channels every update: %5d transactions, %6d bytes\n", o.txns, o.bytes);
+    printf("  changed channels only:      %5d transactions, %6d bytes\n", n.txns, n.bytes);
+
+    CHECK(o.ms == n.ms);
+    CHECK(n.bytes < o.bytes);
+    CHECK(n.txns <= o.txns);
+    CHECK(!o.mismatches && !n.mismatches && !dummy.mismatches);
+    for(int i = 0; i < 3; i++) {
+        CHECK(host_dac.out[i] == gauges._values[i]);
+        CHECK(host_dac.out[i] != 0);
+    }
+
+    host_exit();
+}
@@ -0,0 +1,329 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Vertical counter debouncer vs. the old scan() (user-042)
+ *
+ * Three buttons, set up like Button 1 (press, long and extra long
+ * press), the TT button (press, long press) and the TCD trigger
+ * input (5ms debounce, press only), are driven with random press
+ * sequences at the same time: Random press and pause lengths (away
+ * from the timing thresholds), with contact bounce of up to 5ms at
+ * each edge. scan() is called every ms.
+ * The old scan(), which read the pin itself (replicated below),
+ * runs on the same pins. Both must report the same events in the
+ * same order, at nearly the same times.
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses input
+
+#include "../../dashgauges-A10001986/input.cpp"
+
+#include "host.h"
+
+#define NBUT    3
+#define SIMMS   (30 * 60 * 1000)
+
+enum { EV_PRESS, EV_LPSTART, EV_LPSTOP, EV_ELPSTART, EV_ELPSTOP };
+static const char *evNames[] = { "press", "lp start", "lp stop", "elp start", "elp stop" };
+
+struct Ev {
+    int      type;
+    uint32_t time;
+};
+
+// [0] old, [1] new; per button
+static std::vector<Ev> evs[2][NBUT];
+
+// Without a long press function, press is called on every scan()
+// while held; count that as one event
+template<int W, int B, int T> static void cb()
+{
+    static uint32_t last = 0;
+    std::vector<Ev>& e = evs[W][B];
+    uint32_t now = millis();
+
+    if(T == EV_PRESS && !e.empty() && e.back().type == EV_PRESS && last == now - 1) {
+        last = now;
+        return;
+    }
+    e.push_back({ T, now });
+    last = now;
+}
+
+// Previous DGButton::scan(): Polls the pin, no other debouncing
+class OldButton {
+    public:
+        OldButton(int pin, bool activeLow)
+        {
+            _pin = pin;
+            _buttonPressed = activeLow ? LOW : HIGH;
+        }
+
+        void setTiming(int d, int p, int l, int el = 0)
+        {
+            _debounceDur = d; _pressDur = p; _longPressDur = l; _elongPressDur = el;
+        }
+
+        void (*_pressFunc)(void) = NULL;
+        void (*_longPressStartFunc)(void) = NULL;
+        void (*_longPressStopFunc)(void) = NULL;
+        void (*_elongPressStartFunc)(void) = NULL;
+        void (*_elongPressStopFunc)(void) = NULL;
+
+        void scan(void)
+        {
+            unsigned long now = millis();
+            unsigned long waitTime = now - _startTime;
+            bool active = (digitalRead(_pin) == _buttonPressed);
+
+            switch(_state) {
+            case TCBS_IDLE:
+                if(active) {
+                    transitionTo(TCBS_PRESSED);
+                    _startTime = now;
+                }
+                break;
+            case TCBS_PRESSED:
+                if((!active) && (waitTime < _debounceDur)) {
+                    transitionTo(_lastState);
+                } else if(!active) {
+                    transitionTo(TCBS_RELEASED);
+                    _startTime = now;
+                } else {
+                    if(!_longPressStartFunc) {
+                        if(waitTime > _pressDur) {
+                            if(_pressFunc) _pressFunc();
+                            _pressNotified = true;
+                        }
+                    } else if(waitTime > _longPressDur) {
+                        if(_longPressStartFunc) _longPressStartFunc();
+                        transitionTo(TCBS_LONGPRESS);
+                    }
+                }
+                break;
+            case TCBS_RELEASED:
+                if((active) && (waitTime < _debounceDur)) {
+                    transitionTo(_lastState);
+                } else if((!active) && (waitTime > _pressDur)) {
+                    if(!_pressNotified && _pressFunc) _pressFunc();
+                    reset();
+                }
+                break;
+            case TCBS_LONGPRESS:
+                if(!active) {
+                    transitionTo(TCBS_LONGPRESSEND);
+                    _startTime = now;
+                } else if(_elongPressDur && (waitTime > _elongPressDur)) {
+                    if(_elongPressStartFunc) _elongPressStartFunc();
+                    transitionTo(TCBS_ELONGPRESS);
+                }
+                break;
+            case TCBS_LONGPRESSEND:
+                if((active) && (waitTime < _debounceDur)) {
+                    transitionTo(_lastState);
+                } else if(waitTime >= _debounceDur) {
+                    if(_longPressStopFunc) _longPressStopFunc();
+                    reset();
+                }
+                break;
+            case TCBS_ELONGPRESS:
+                if(!active) {
+                    transitionTo(TCBS_ELONGPRESSEND);
+                    _startTime = now;
+                }
+                break;
+            case TCBS_ELONGPRESSEND:
+                if((active) && (waitTime < _debounceDur)) {
+                    transitionTo(_lastState);
+                } else if(waitTime >= _debounceDur) {
+                    if(_elongPressStopFunc) _elongPressStopFunc();
+                    reset();
+                }
+                break;
+            default:
+                transitionTo(TCBS_IDLE);
+                break;
+            }
+        }
+
+    private:
+        void reset(void)
+        {
+            _state = _lastState = TCBS_IDLE;
+            _startTime = 0;
+            _pressNotified = false;
+        }
+        void transitionTo(ButtonState s)
+        {
+            _lastState = _state;
+            _state = s;
+        }
+
+        int _pin, _buttonPressed;
+        unsigned int _debounceDur = 50, _pressDur = 400, _longPressDur = 800, _elongPressDur = 0;
+        ButtonState _state = TCBS_IDLE, _lastState = TCBS_IDLE;
+        unsigned long _startTime = 0;
+        bool _pressNotified = false;
+};
+
+// Button 1, TT button, TCD trigger; all active high
+static const int pins[NBUT] = { 36, 13, 16 };
+
+static DGButton  nb[NBUT] = { DGButton(36, false, false), DGButton(13, false, false), DGButton(16, false, false) };
+static OldButton ob[NBUT] = { OldButton(36, false), OldButton(13, false), OldButton(16, false) };
+
+template<int B, class Btn> static void setup(Btn& b)
+{
+    switch(B) {
+    case 0:
+        b.setTiming(50, 200, 2000, 6000);
+        break;
+    case 1:
+        b.setTiming(50, 200, 5000);
+        break;
+    case 2:
+        b.setTiming(5, 50, 100000);
+        break;
+    }
+}
+
+static void attachAll()
+{
+    setup<0>(ob[0]); setup<1>(ob[1]); setup<2>(ob[2]);
+    setup<0>(nb[0]); setup<1>(nb[1]); setup<2>(nb[2]);
+
+    ob[0]._pressFunc = cb<0, 0, EV_PRESS>;
+    ob[0]._longPressStartFunc = cb<0, 0, EV_LPSTART>;
+    ob[0]._longPressStopFunc = cb<0, 0, EV_LPSTOP>;
+    ob[0]._elongPressStartFunc = cb<0, 0, EV_ELPSTART>;
+    ob[0]._elongPressStopFunc = cb<0, 0, EV_ELPSTOP>;
+    nb[0].attachPress(cb<1, 0, EV_PRESS>);
+    nb[0].attachLongPressStart(cb<1, 0, EV_LPSTART>);
+    nb[0].attachLongPressStop(cb<1, 0, EV_LPSTOP>);
+    nb[0].attachELongPressStart(cb<1, 0, EV_ELPSTART>);
+    nb[0].attachELongPressStop(cb<1, 0, EV_ELPSTOP>);
+
+    ob[1]._pressFunc = cb<0, 1, EV_PRESS>;
+    ob[1]._longPressStartFunc = cb<0, 1, EV_LPSTART>;
+    nb[1].attachPress(cb<1, 1, EV_PRESS>);
+    nb[1].attachLongPressStart(cb<1, 1, EV_LPSTART>);
+
+    ob[2]._pressFunc = cb<0, 2, EV_PRESS>;
+    nb[2].attachPress(cb<1, 2, EV_PRESS>);
+}
+
+// Random press length, at least 40ms away from all thresholds
+static int pressLen()
+{
+    static const int thres[] = { 50, 200, 2000, 5000, 6000 };
+
+    for(;;) {
+        int l;
+        switch(rand() % 4) {
+        case 0:  l = 90 + rand() % 400;     break;
+        case 1:  l = 90 + rand() % 2500;    break;
+        case 2:  l = 2000 + rand() % 3500;  break;
+        default: l = 5000 + rand() % 4000;  break;
+        }
+        bool ok = true;
+        for(int t : thres) {
+            if(abs(l - t) < 40) ok = false;
+        }
+        if(ok) return l;
+    }
+}
+
+// Input schedule per pin: Levels per ms
+struct Gen {
+    int      level = 0;
+    uint32_t next = 500;        // Next edge
+    int      bounce = 0;        // Bounce toggles left
+    int      presses = 0;
+};
+
+static void genStep(Gen& g, int pin, uint32_t now)
+{
+    if(g.bounce) {
+        // Bounce: toggle every ms, end on the new level
+        host_setPin(pin, !host_getPin(pin));
+        g.bounce--;
+        return;
+    }
+    if(now < g.next) return;
+
+    g.level = !g.level;
+    if(g.level) {
+        g.presses++;
+        g.next = now + pressLen();
+    } else {
+        g.next = now + 250 + rand() % 2500;
+    }
+    // 0-5 ms of bounce: An even number of extra toggles
+    g.bounce = (rand() % 3) * 2;
+    host_setPin(pin, g.level);
+}
+
+int main()
+{
+    Gen gen[NBUT];
+    int presses = 0, events = 0, maxDt = 0, bad = 0;
+
+    host_init();
+    CHECK(tick_begin());
+
+    for(int i = 0; i < NBUT; i++) {
+        host_setPin(pins[i], 0);
+        nb[i].begin();
+    }
+    attachAll();
+
+    host_seed(42);
+    for(uint32_t ms = 0; ms < SIMMS; ms++) {
+        for(int i = 0; i < NBUT; i++) {
+            genStep(gen[i], pins[i], millis());
+        }
+        for(int i = 0; i < NBUT; i++) {
+            ob[i].scan();
+            nb[i].scan();
+        }
+        host_advance(1);
+    }
+
+    for(int b = 0; b < NBUT; b++) {
+        const std::vector<Ev>& o = evs[0][b];
+        const std::vector<Ev>& n = evs[1][b];
+        int cnt[5] = { 0 };
+
+        presses += gen[b].presses;
+        if(o.size() != n.size()) {
+            printf("  button %d: %d events before, %d now\n", b, (int)o.size(), (int)n.size());
+            bad++;
+        }
+        for(size_t i = 0; i < o.size() && i < n.size(); i++) {
+            int dt = abs((int)(n[i].time - o[i].time));
+            if(o[i].type != n[i].type || dt > 12) {
+                if(bad++ < 5) {
+                    printf("  button %d, event %d: %s at %d before, %s at %d now\n", b, (int)i,
+                        evNames[o[i].type], o[i].time, evNames[n[i].type], n[i].time);
+                }
+            }
+            if(dt > maxDt) maxDt = dt;
+            cnt[n[i].type]++;
+        }
+        events += n.size();
+        printf("  button %d: %d presses; %d press, %d/%d long, %d/%d extra long events\n", b,
+            gen[b].presses, cnt[EV_PRESS], cnt[EV_LPSTART], cnt[EV_LPSTOP], cnt[EV_ELPSTART], cnt[EV_ELPSTOP]);
+    }
+    printf("  %d presses, %d events, same order; max time difference %dms\n", presses, events, maxDt);
+
+    CHECK(!bad);
+    CHECK(events > 1000);
+
+    host_exit();
+}
@@ -0,0 +1,203 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Edge capture and replay with a stalled main loop (user-041)
+ *
+ * Replays edge traces (with µs resolution) on a button set up like
+ * Button 1, while scan() is called only every 1, 50, 300 or 700ms,
+ * as from a main loop stuck in wifi_loop() etc. The traces are
+ * modelled on a clean switch, a bouncy tactile button and a worn
+ * contact. Press lengths are random, away from the thresholds.
+ * - Every press is reported as what its true length says (press,
+ *   long press, extra long press), regardless of the scan interval
+ * - Taps shorter than the scan interval are not lost
+ * - Callbacks come no later than one scan interval after they
+ *   are due
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses input
+
+#include "../../dashgauges-A10001986/input.cpp"
+
+#include "host.h"
+
+#define PIN     36
+
+// Button 1 timing, as in dg_main.cpp
+#define B1_DEB      50
+#define B1_PRESS    200
+#define B1_HOLD     2000
+#define B1_EHOLD    6000
+
+enum { EV_PRESS, EV_LPSTART, EV_LPSTOP, EV_ELPSTART, EV_ELPSTOP };
+
+struct Ev {
+    int      type;
+    uint32_t time;
+};
+
+static std::vector<Ev> evs;
+
+template<int T> static void cb()
+{
+    evs.push_back({ T, (uint32_t)millis() });
+}
+
+// Bounce traces: Offsets (µs) of the edges at press and release;
+// each edge toggles the level
+struct Trace {
+    const char *name;
+    std::vector<uint32_t> press, release;
+};
+
+static const Trace traces[] = {
+    { "clean",    { 0 },                                  { 0 } },
+    { "tactile",  { 0, 150, 400, 900, 1300 },             { 0, 300, 700 } },
+    { "worn",     { 0, 50, 120, 400, 1800, 2100, 3500 },  { 0, 2000, 2600, 4100, 4500 } },
+};
+
+struct Edge {
+    uint64_t us;
+    int      level;
+};
+
+struct Press {
+    uint32_t start, len;        // ms, from the last edge of the press bounce
+    uint32_t end;               // ms, last edge of the release bounce
+};
+
+static DGButton but(PIN, false, false);
+
+static int pressLen()
+{
+    static const int thres[] = { 2000, 6000 };
+
+    for(;;) {
+        int l;
+        switch(rand() % 3) {
+        case 0:  l = 60 + rand() % 400;     break;
+        case 1:  l = 60 + rand() % 3000;    break;
+        default: l = 1500 + rand() % 6000;  break;
+        }
+        bool ok = true;
+        for(int t : thres) {
+            if(abs(l - t) < 30) ok = false;
+        }
+        if(ok) return l;
+    }
+}
+
+static std::vector<int> expected(uint32_t len)
+{
+    if(len < B1_HOLD) return { EV_PRESS };
+    if(len < B1_EHOLD) return { EV_LPSTART, EV_LPSTOP };
+    return { EV_LPSTART, EV_ELPSTART, EV_ELPSTOP };
+}
+
+static int run(uint32_t scanIval, int num, int *taps, int *maxLate)
+{
+    std::vector<Edge> edges;
+    std::vector<Press> presses;
+    uint64_t t = (uint64_t)(millis() + 1000) * 1000;
+    int bad = 0;
+
+    // Build the replay
+    for(int i = 0; i < num; i++) {
+        const Trace& tr = traces[rand() % 3];
+        int level = 0;
+        uint32_t len = pressLen();
+        for(uint32_t o : tr.press) {
+            edges.push_back({ t + o, level = !level });
+        }
+        uint32_t start = (t + tr.press.back()) / 1000;
+        t += tr.press.back() + (uint64_t)len * 1000;
+        for(uint32_t o : tr.release) {
+            edges.push_back({ t + o, level = !level });
+        }
+        presses.push_back({ start, len, (uint32_t)((t + tr.release.back()) / 1000) });
+        t += tr.release.back() + (300 + rand() % 1200) * 1000;
+    }
+
+    // Replay, scan() every scanIval ms; go on until the last
+    // press is surely reported
+    t += (uint64_t)(scanIval + B1_PRESS + B1_DEB) * 1000;
+    evs.clear();
+    *taps = *maxLate = 0;
+    size_t e = 0;
+    while(e < edges.size() || host_nowUs() < t) {
+        uint64_t next = (host_nowUs() / 1000 + 1) * 1000;
+        while(e < edges.size() && edges[e].us < next) {
+            host_advanceUs(edges[e].us - host_nowUs());
+            host_setPin(PIN, edges[e].level);
+            e++;
+        }
+        host_advanceUs(next - host_nowUs());
+        if(!(millis() % scanIval)) {
+            but.scan();
+        }
+    }
+
+    // Compare with what the true press lengths say
+    size_t n = 0;
+    for(const Press& p : presses) {
+        std::vector<int> x = expected(p.len);
+        for(size_t i = 0; i < x.size(); i++, n++) {
+            if(n >= evs.size() || evs[n].type != x[i]) {
+                if(bad++ < 5) {
+                    printf("  press of %dms at %d: event %d is %d, expected %d\n", p.len, p.start,
+                        (int)i, n < evs.size() ? evs[n].type : -1, x[i]);
+                }
+                continue;
+            }
+            // How late, compared to when due
+            uint32_t due = 0;
+            switch(x[i]) {
+            case EV_PRESS:    due = p.end + B1_PRESS;           break;
+            case EV_LPSTART:  due = p.start + B1_HOLD;          break;
+            case EV_ELPSTART: due = p.start + B1_EHOLD;         break;
+            default:          due = p.end + B1_DEB;             break;
+            }
+            int late = (int)(evs[n].time - due);
+            if(late > *maxLate) *maxLate = late;
+            if(late > (int)scanIval + 10) bad++;
+        }
+        if(p.len < scanIval) (*taps)++;
+    }
+    if(evs.size() != n) bad++;
+
+    return bad;
+}
+
+int main()
+{
+    static const uint32_t ivals[] = { 1, 50, 300, 700 };
+
+    host_init();
+    CHECK(tick_begin());
+
+    host_setPin(PIN, 0);
+    but.begin();
+    but.setTiming(B1_DEB, B1_PRESS, B1_HOLD, B1_EHOLD);
+    but.attachPress(cb<EV_PRESS>);
+    but.attachLongPressStart(cb<EV_LPSTART>);
+    but.attachLongPressStop(cb<EV_LPSTOP>);
+    but.attachELongPressStart(cb<EV_ELPSTART>);
+    but.attachELongPressStop(cb<EV_ELPSTOP>);
+
+    host_seed(41);
+    for(uint32_t s : ivals) {
+        int taps, late;
+        int bad = run(s, 300, &taps, &late);
+        printf("  scan every %3dms: 300 presses, %2d shorter than the interval, %d wrong, latest %dms after due\n",
+            s, taps, bad, late);
+        CHECK(!bad);
+    }
+
+    host_exit();
+}
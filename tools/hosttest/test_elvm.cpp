@@ -0,0 +1,249 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Empty LED sequence engine (user-039)
+ *
+ * The sequence engine runs as a tick job, driven by the tick
+ * service on the virtual clock; the LED's PWM level is sampled
+ * after every tick and compared with the expected one, written
+ * out by hand (not derived from the bytecode).
+ * - All special signals, incl. specialDone() and stopping an
+ *   endless one
+ * - Standard blink with start delay
+ * - User patterns with levels and ramps; bad patterns are refused
+ * - A special signal during blinking; blink pace is kept
+ * - Pattern swaps every few ticks: Only levels of the current or
+ *   the previous pattern ever show up
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+
+#include "host.h"
+
+static EmptyLED led;
+
+struct Seg {
+    int  level;
+    int  ticks;
+    bool ramp;
+};
+
+// Expand segments to per-tick levels, "rep" times
+static std::vector<int> expand(const std::vector<Seg>& segs, int rep = 1, int from = 0)
+{
+    std::vector<int> v;
+    int lvl = from;
+
+    while(rep--) {
+        for(const Seg& s : segs) {
+            for(int p = 1; p <= s.ticks; p++) {
+                v.push_back(s.ramp ? lvl + (s.level - lvl) * p / s.ticks : s.level);
+            }
+            lvl = s.level;
+        }
+    }
+    return v;
+}
+
+static void append(std::vector<int>& a, const std::vector<int>& b)
+{
+    a.insert(a.end(), b.begin(), b.end());
+}
+
+static int level()
+{
+    return host_ledcDuty[EL_PWM_CHANNEL];
+}
+
+// Run n ticks, return levels after each
+static std::vector<int> ticks(int n)
+{
+    std::vector<int> v;
+
+    while(n--) {
+        host_advance(EL_TICK_MS);
+        v.push_back(level());
+    }
+    return v;
+}
+
+static int mismatch(const std::vector<int>& got, const std::vector<int>& exp)
+{
+    for(size_t i = 0; i < exp.size(); i++) {
+        if(i >= got.size() || got[i] != exp[i]) {
+            printf("  tick %d: level %d, expected %d\n", (int)i, i < got.size() ? got[i] : -1, exp[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_specials()
+{
+    static const int ON = 255, OFF = 0;
+    std::vector<int> e;
+
+    // 1: SOS, then off
+    e.clear();
+    append(e, expand({ { ON, 15 }, { OFF, 15 } }, 3));
+    append(e, expand({ { ON, 40 }, { OFF, 40 } }, 3));
+    append(e, expand({ { ON, 15 }, { OFF, 15 } }, 3));
+    e.push_back(OFF);
+    led.specialSignal(DGSEQ_NOAUDIO);
+    CHECK(!led.specialDone());
+    CHECK(!mismatch(ticks(e.size()), e));
+    CHECK(led.specialDone());
+
+    // 3: Alarm
+    e = expand({ { ON, 100 }, { OFF, 50 } }, 4);
+    e.push_back(OFF);
+    led.specialSignal(DGSEQ_ALARM);
+    CHECK(!mismatch(ticks(e.size()), e));
+    CHECK(led.specialDone());
+
+    // 5: Update available
+    e = expand({ { ON, 10 }, { OFF, 10 } }, 6);
+    e.push_back(OFF);
+    led.specialSignal(DGSEQ_UPDAVAIL);
+    CHECK(!mismatch(ticks(e.size()), e));
+    CHECK(led.specialDone());
+
+    // 2: Wait, endless until stopped
+    e = expand({ { ON, 50 }, { OFF, 50 } }, 5);
+    led.specialSignal(DGSEQ_WAIT);
+    CHECK(!mismatch(ticks(e.size()), e));
+    CHECK(!led.specialDone());
+    led.specialSignal(DGSEQ_WAIT);          // Restarts
+    CHECK(!mismatch(ticks(60), expand({ { ON, 50 }, { OFF, 10 } })));
+    led.specialSignal(0);
+    host_advance(EL_TICK_MS);
+    CHECK(led.specialDone());
+    CHECK(level() == OFF);
+
+    // 4: Copy error, endless
+    e = expand({ { ON, 20 }, { OFF, 20 }, { ON, 20 }, { OFF, 100 } }, 3);
+    led.specialSignal(DGSEQ_ERRCOPY);
+    CHECK(!mismatch(ticks(e.size()), e));
+    led.specialSignal(0);
+    ticks(2);
+    CHECK(led.specialDone() && level() == OFF);
+}
+
+// Standard blink: The first on phase is one tick shorter (as always)
+static std::vector<int> stdBlink(int rep)
+{
+    std::vector<int> e = expand({ { 255, 39 }, { 0, 40 } });
+    append(e, expand({ { 255, 40 }, { 0, 40 } }, rep - 1));
+    return e;
+}
+
+static void test_blink()
+{
+    // Standard blink, 400ms, after 30 ticks
+    std::vector<int> e(30, 0);
+    append(e, stdBlink(4));
+    led.startBlink(400, 30);
+    CHECK(!mismatch(ticks(e.size()), e));
+    led.stopBlink();
+    ticks(1);
+    CHECK(level() == 0);
+}
+
+static void test_pattern()
+{
+    // "100:20,r0:50,30:10,r60:7"
+    std::vector<Seg> s = { { 255, 20 }, { 0, 50, true }, { 76, 10 }, { 153, 7, true } };
+
+    CHECK(led.setBlinkPattern("100:20, r0:50, 30:10, R60:7"));
+    led.startBlink(400, 0);
+    std::vector<int> got = ticks(87 * 3);
+    std::vector<int> e = expand(s, 3);
+    CHECK(!mismatch(got, e));
+
+    // A special signal takes over; the pattern keeps running
+    // meanwhile, and shows right when the signal ends
+    led.specialSignal(DGSEQ_UPDAVAIL);
+    got = ticks(120 + 50);
+    e = expand({ { 255, 10 }, { 0, 10 } }, 6);
+    std::vector<int> full = expand(s, 6);
+    append(e, std::vector<int>(full.begin() + 87 * 3 + 120, full.begin() + 87 * 3 + 170));
+    CHECK(!mismatch(got, e));
+
+    // Bad patterns: Refused, standard blink
+    static const char *bad[] = { "101:10", "50:0", "50:256", "x", "50", "r:10" };
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK(!led.setBlinkPattern(bad[i]));
+    }
+    led.stopBlink();
+    ticks(1);
+    e = stdBlink(2);
+    led.startBlink(400, 0);
+    CHECK(!mismatch(ticks(e.size()), e));
+
+    // 20 steps fit, 21 don't
+    std::string l;
+    for(int i = 0; i < 20; i++) l += "50:1,";
+    CHECK(led.setBlinkPattern(l.c_str()));
+    l += "50:1";
+    CHECK(!led.setBlinkPattern(l.c_str()));
+    led.stopBlink();
+    ticks(1);
+}
+
+// Levels a pattern can show (the ramp goes from 76 to 102)
+static bool inPat(int p, int l)
+{
+    static const int lv[4][2] = { { 25, 51 }, { 76, 102 }, { 127, 127 }, { 153, 178 } };
+
+    return (l == lv[p][0] || l == lv[p][1] || (p == 1 && l > 76 && l < 102));
+}
+
+static void test_swap()
+{
+    static const char *pats[] = { "10:3,20:2", "30:1,r40:4", "50:5", "60:2,70:3" };
+    int bad = 0, swaps = 0, cur = 0;
+
+    CHECK(led.setBlinkPattern(pats[0]));
+    led.startBlink(400, 0);
+    host_seed(39);
+    for(int n = 0; n < 5000; n++) {
+        int prev = cur;
+        if(!(rand() % 3)) {
+            cur = rand() % 4;
+            CHECK(led.setBlinkPattern(pats[cur]));
+            swaps++;
+        }
+        // The tick of the swap may show either; later ones the new one
+        host_advance(EL_TICK_MS);
+        if(!inPat(cur, level()) && !inPat(prev, level())) bad++;
+        host_advance(EL_TICK_MS);
+        if(!inPat(cur, level())) bad++;
+    }
+    printf("  %d pattern swaps, %d bad levels\n", swaps, bad);
+    CHECK(!bad);
+    led.stopBlink();
+}
+
+int main()
+{
+    host_init();
+
+    CHECK(tick_begin());
+    led.begin(EMPTY_LED_PIN);
+    host_advance(EL_TICK_MS);
+
+    test_specials();
+    test_blink();
+    test_pattern();
+    test_swap();
+
+    host_exit();
+}
@@ -0,0 +1,126 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Gapless track transitions (user-027)
+ *
+ * Plays three MP3 tracks (silent MPEG-1 Layer III frames behind an
+ * ID3v2 tag, decoded by the real libmad) from an SD card with
+ * typical SPI latency, and measures what the listener would hear
+ * between tracks: time with an empty I2S buffer, and audio cut off
+ * by stopping the output. Once with the next track pre-opened, once
+ * with pre-opening suppressed (the old way).
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_audio
+
+#include "../../dashgauges-A10001986/dg_audio.cpp"
+
+#include "host.h"
+#include <vector>
+
+#define FRAME_LEN   417         // 128kbps, 44.1kHz, no padding
+#define TRACK_SECS  3
+
+static std::vector<uint8_t> makeMP3(int secs, int id3Len)
+{
+    std::vector<uint8_t> f;
+    int frames = secs * 44100 / 1152;
+
+    // ID3v2.3 tag, contents irrelevant
+    f.insert(f.end(), { 'I', 'D', '3', 3, 0, 0,
+                        (uint8_t)((id3Len >> 21) & 0x7f), (uint8_t)((id3Len >> 14) & 0x7f),
+                        (uint8_t)((id3Len >> 7) & 0x7f),  (uint8_t)(id3Len & 0x7f) });
+    f.resize(f.size() + id3Len, 0);
+
+    // Mono frames with all-zero side info: main_data_begin 0,
+    // part2_3_length 0, so libmad decodes silence
+    for(int i = 0; i < frames; i++) {
+        size_t o = f.size();
+        f.resize(o + FRAME_LEN, 0);
+        f[o] = 0xff; f[o+1] = 0xfb; f[o+2] = 0x90; f[o+3] = 0xc4;
+    }
+
+    return f;
+}
+
+struct Result {
+    uint64_t gapUs;
+    uint64_t maxGapUs;
+    uint64_t lost;
+    uint32_t stops;
+    int      tracks;
+};
+
+static Result play(bool preload)
+{
+    std::vector<uint8_t> mp3file = makeMP3(TRACK_SECS, 2000);
+    int lastTrack = -1, tracks = 0, lastStart = 0;
+
+    host_fsClear(SD);
+    host_fsMkdir(SD, "/music0");
+    for(int i = 0; i < 3; i++) {
+        char fn[32];
+        sprintf(fn, "/music0/%03d.mp3", i);
+        host_fsAddFile(SD, fn, mp3file.data(), mp3file.size());
+    }
+    // SD over SPI: ~5ms per open/exists, ~1ms per KB
+    host_fsSetLatency(SD, { 5000, 1000, 0 });
+
+    aud_state.maxMusic = 2;
+    aud_state.mpShuffle = 0;
+    haveMusic = true;
+    mpCurrIdx = 0;
+    host_audio = HostAudio();
+
+    mp_play(true);
+
+    // Main loop: One iteration per ms
+    for(int ms = 0; ms < (3 * TRACK_SECS + 1) * 1000; ms++) {
+        if(ms == 200) host_audioArm(true);
+        if(!preload) mpPreChecked = true;
+        audio_loop();
+        if(aud_state.curTrack != lastTrack) {
+            lastTrack = aud_state.curTrack;
+            lastStart = ms;
+            tracks++;
+        }
+        // Two transitions measured
+        if(lastTrack == 2 && ms - lastStart > 1000) break;
+        host_advance(1);
+    }
+    host_audioArm(false);
+    Result r = { host_audio.gapUs, host_audio.maxGapUs, host_audio.lostFrames, host_audio.stops, tracks };
+    mp_stop();
+
+    return r;
+}
+
+int main()
+{
+    host_init();
+    audio_setup();
+
+    Result old = play(false);
+    Result gl  = play(true);
+
+    printf("  without pre-open: %d output stops, %.1fms cut off, gap %.1fms total, %.1fms max\n",
+            old.stops, old.lost / 44.1, old.gapUs / 1000.0, old.maxGapUs / 1000.0);
+    printf("  with pre-open:    %d output stops, %.1fms cut off, gap %.1fms total, %.1fms max\n",
+            gl.stops, gl.lost / 44.1, gl.gapUs / 1000.0, gl.maxGapUs / 1000.0);
+
+    CHECK(old.tracks == 3 && gl.tracks == 3);
+    CHECK(old.gapUs + old.lost > 0);
+    // Output keeps running across both transitions, nothing is
+    // cut off, and the buffer never runs dry
+    CHECK(gl.stops == 0);
+    CHECK(gl.lost == 0);
+    CHECK(gl.gapUs == 0);
+
+    host_exit();
+}
@@ -0,0 +1,114 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: I2C job queue (user-033)
+ *
+ * The I2C task runs as a thread, under ThreadSanitizer.
+ * - Boot transfers (probe, EEPROM readback, bus speed) go through
+ *   the queue and are waited for
+ * - Gauge updates are queued, executed in order; the DAC ends up
+ *   with the last values
+ * - Failed transfers are counted, the next update resends all
+ *   channels; persistent errors reduce the bus speed
+ * - Without the task, jobs run directly
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+// HOSTTEST: tsan
+
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+
+#include "host.h"
+
+static Gauges gauges;
+
+// Wait for the I2C task to finish all queued jobs: Jobs are
+// executed in order, so a synchronous one finishes last
+static void drain()
+{
+    I2CJob job;
+    i2c_setupWrite(&job, 0x60);
+    i2c_transfer(&job);
+}
+
+static void test_updates()
+{
+    struct dgI2CStats st;
+
+    // Found a speed that works
+    drain();
+    gauges.getI2CStats(&st);
+    CHECK(st.clock == 400000);
+    CHECK(st.errors == 0);
+
+    for(int p = 0; p <= 100; p++) {
+        gauges.setValuePercent(0, p);
+        gauges.setValuePercent(1, 100 - p);
+        gauges.setValuePercent(2, p / 2);
+        gauges.UpdateAll();
+    }
+    drain();
+
+    gauges.getI2CStats(&st);
+    printf("  %d jobs, %d dropped\n", st.jobs, st.dropped);
+    // A dropped update is made up for by the next one
+    CHECK(host_dac.out[0] == 4095 && host_dac.out[1] == 0 && host_dac.out[2] == 2048);
+}
+
+static void test_errors()
+{
+    struct dgI2CStats st, st0;
+
+    drain();
+    gauges.getI2CStats(&st0);
+
+    // One failure: Counted, next update resends all channels
+    host_i2cFail = true;
+    gauges.setValuePercent(0, 10);
+    gauges.UpdateAll();
+    drain();
+    host_i2cFail = false;
+    gauges.getI2CStats(&st);
+    CHECK(st.errors > st0.errors);
+    CHECK(st.nacks > st0.nacks);
+
+    uint32_t b = host_i2c.bytes;
+    gauges.setValuePercent(0, 11);
+    gauges.UpdateAll();
+    drain();
+    CHECK(abs(host_dac.out[0] - 450) <= 1 && host_dac.out[1] == 0 && host_dac.out[2] == 2048);
+    // Three multi-writes plus address, plus the drain() probe
+    CHECK(host_i2c.bytes - b == 1 + 9 + 1);
+
+    // Persistent errors: Fall back to 100kHz
+    host_i2cFail = true;
+    for(int i = 0; i < I2C_ERR_FALLBACK; i++) {
+        gauges.setValuePercent(0, 20 + i);
+        gauges.UpdateAll();
+        drain();
+    }
+    host_i2cFail = false;
+    gauges.getI2CStats(&st);
+    CHECK(st.clock == 100000);
+    CHECK(Wire.getClock() == 100000);
+}
+
+int main()
+{
+    host_init();
+    host_dac.ldacLow = false;
+
+    CHECK(gauges.begin(3, 3, 4));
+    CHECK(_i2cQueue != NULL);
+
+    test_updates();
+    test_errors();
+
+    host_exit();
+}
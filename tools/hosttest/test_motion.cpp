@@ -0,0 +1,255 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Gauge motion engine (user-031)
+ *
+ * Simulates three analog gauges on the MCP4728 model, with
+ * Gauges::loop() called every ms.
+ * - Time travel drain (80/70/90% to 0 within P1): The previous 1%
+ *   stepping at computed intervals (replicated from the old main
+ *   loop) vs. the motion engine. Counts I2C transactions, the most
+ *   in any 100ms window, and the largest DAC step. Plots gauge A
+ *   (DAC output) and writes all trajectories to test_motion.csv
+ *   next to the binary.
+ * - Each easing curve with inertia: Monotonic, no overshoot, ends
+ *   at target, at most one transaction per DGM_TICK_MS
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+
+#include "host.h"
+#include <string>
+#include <vector>
+
+#define P1DUR       6600
+#define SIMDUR      (P1DUR + 1000)
+
+static Gauges gauges;
+
+static const int idle[3]  = { 80, 70, 90 };
+
+struct Trace {
+    std::vector<uint16_t> out[3];       // DAC output per ms
+    std::vector<uint64_t> txnAt;        // Time of each transaction (ms)
+    uint32_t txns;
+    uint32_t bytes;
+    int      maxStep;
+    int      maxTxnsPer100ms;
+};
+
+static void record(Trace& t, int ms, uint32_t txnsBefore)
+{
+    for(int i = 0; i < 3; i++) {
+        if(!t.out[i].empty()) {
+            int d = abs((int)host_dac.out[i] - (int)t.out[i].back());
+            if(d > t.maxStep) t.maxStep = d;
+        }
+        t.out[i].push_back(host_dac.out[i]);
+    }
+    for(uint32_t i = txnsBefore; i < host_i2c.txns; i++) {
+        t.txnAt.push_back(ms);
+    }
+}
+
+static void finish(Trace& t)
+{
+    size_t j = 0;
+
+    t.maxTxnsPer100ms = 0;
+    for(size_t i = 0; i < t.txnAt.size(); i++) {
+        while(t.txnAt[i] - t.txnAt[j] >= 100) j++;
+        if((int)(i - j + 1) > t.maxTxnsPer100ms) t.maxTxnsPer100ms = i - j + 1;
+    }
+    t.txns = t.txnAt.size();
+}
+
+static void toIdle()
+{
+    for(int i = 0; i < 3; i++) {
+        gauges.setValuePercent(i, idle[i]);
+    }
+    gauges.UpdateAll();
+    host_advance(100);
+    gauges.loop();
+    host_i2c = HostI2CStats();
+}
+
+// Old main loop: Step 1% every P1Dur / (steps + 2)
+static Trace drainOld()
+{
+    Trace t = Trace();
+    unsigned long ival[3], last[3];
+
+    toIdle();
+    for(int i = 0; i < 3; i++) {
+        ival[i] = P1DUR / (idle[i] + 2);
+        last[i] = millis();
+    }
+
+    for(int ms = 0; ms < SIMDUR; ms++) {
+        unsigned long now = millis();
+        uint32_t tx = host_i2c.txns;
+        bool doUpd = false;
+        if(ms < P1DUR) {
+            for(int i = 0; i < 3; i++) {
+                if(now - last[i] >= ival[i]) {
+                    int p = gauges.getValuePercent(i);
+                    gauges.setValuePercent(i, p ? p - 1 : 0);
+                    last[i] = now;
+                    doUpd = true;
+                }
+            }
+        }
+        if(doUpd) gauges.UpdateAll();
+        gauges.loop();
+        record(t, ms, tx);
+        host_advance(1);
+    }
+    t.bytes = host_i2c.bytes;
+    finish(t);
+
+    return t;
+}
+
+// Now: One linear move per gauge (as startTTDrain())
+static Trace drainNew()
+{
+    Trace t = Trace();
+
+    toIdle();
+    for(int i = 0; i < 3; i++) {
+        gauges.moveTo(i, 0, P1DUR * idle[i] / (idle[i] + 2), DGM_EASE_LINEAR);
+    }
+
+    for(int ms = 0; ms < SIMDUR; ms++) {
+        uint32_t tx = host_i2c.txns;
+        gauges.loop();
+        record(t, ms, tx);
+        host_advance(1);
+    }
+    t.bytes = host_i2c.bytes;
+    finish(t);
+
+    return t;
+}
+
+// Gauge A, old '.' and new '*', over time
+static void plot(const Trace& o, const Trace& n)
+{
+    const int rows = 12, cols = 64;
+    char g[rows][cols + 1];
+
+    memset(g, ' ', sizeof(g));
+    for(int c = 0; c < cols; c++) {
+        int ms = c * SIMDUR / cols;
+        int ro = (rows - 1) - o.out[0][ms] * (rows - 1) / 4095;
+        int rn = (rows - 1) - n.out[0][ms] * (rows - 1) / 4095;
+        g[ro][c] = '.';
+        g[rn][c] = (g[rn][c] == '.') ? '#' : '*';
+    }
+    printf("  gauge A, DAC output (. old, * now, # both), %dms:\n", SIMDUR);
+    for(int r = 0; r < rows; r++) {
+        g[r][cols] = 0;
+        printf("  |%s\n", g[r]);
+    }
+    printf("  +%s\n", std::string(cols, '-').c_str());
+}
+
+static void writeCSV(const char *fn, const Trace& o, const Trace& n)
+{
+    FILE *f = fopen(fn, "w");
+    if(!f) return;
+    fprintf(f, "ms,oldA,oldB,oldC,newA,newB,newC\n");
+    for(size_t ms = 0; ms < o.out[0].size(); ms++) {
+        fprintf(f, "%d,%d,%d,%d,%d,%d,%d\n", (int)ms,
+            o.out[0][ms], o.out[1][ms], o.out[2][ms], n.out[0][ms], n.out[1][ms], n.out[2][ms]);
+    }
+    fclose(f);
+}
+
+static void test_drain(const char *csv)
+{
+    Trace o = drainOld();
+    Trace n = drainNew();
+
+    plot(o, n);
+    writeCSV(csv, o, n);
+
+    printf("  old: %d transactions, %d bytes, max %d per 100ms, max DAC step %d\n",
+            o.txns, o.bytes, o.maxTxnsPer100ms, o.maxStep);
+    printf("  now: %d transactions, %d bytes, max %d per 100ms, max DAC step %d\n",
+            n.txns, n.bytes, n.maxTxnsPer100ms, n.maxStep);
+
+    // Bounded rate, smoother motion, same end point
+    CHECK(n.maxTxnsPer100ms <= 100 / DGM_TICK_MS);
+    CHECK(n.txns <= SIMDUR / DGM_TICK_MS);
+    CHECK(n.maxStep < o.maxStep / 3);
+    for(int i = 0; i < 3; i++) {
+        CHECK(n.out[i].back() == 0 && o.out[i].back() == 0);
+        CHECK(!gauges.isMoving(i));
+    }
+    // Drain is (nearly, due to inertia) complete at the end of P1
+    for(int i = 0; i < 3; i++) {
+        CHECK(n.out[i][P1DUR - 1] < 4095 / 100);
+    }
+}
+
+static void test_ease()
+{
+    static const char *names[] = { "linear", "in", "out", "inout" };
+
+    for(int e = DGM_EASE_LINEAR; e <= DGM_EASE_INOUT; e++) {
+        Trace t = Trace();
+        bool mono = true;
+        int half = -1;
+
+        gauges.setValuePercent(0, 0);
+        gauges.UpdateAll();
+        host_advance(100);
+        gauges.loop();
+        host_i2c = HostI2CStats();
+
+        gauges.moveTo(0, 100, 1000, e);
+        for(int ms = 0; ms < 2000; ms++) {
+            uint32_t tx = host_i2c.txns;
+            gauges.loop();
+            record(t, ms, tx);
+            if(ms && t.out[0][ms] < t.out[0][ms - 1]) mono = false;
+            if(half < 0 && t.out[0][ms] >= 4095 / 2) half = ms;
+            host_advance(1);
+        }
+        finish(t);
+        printf("  ease %-6s: half way at %4dms, %d transactions\n", names[e], half, t.txns);
+
+        // Inertia lags, but does not overshoot
+        CHECK(mono);
+        CHECK(t.out[0].back() == 4095);
+        CHECK(t.maxTxnsPer100ms <= 100 / DGM_TICK_MS);
+        CHECK(!gauges.isMoving(0));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string csv = std::string(argv[0]) + ".csv";
+
+    host_init();
+    host_failTaskCreate = true;         // I2C synchronous, deterministic
+    host_dac.ldacLow = true;
+
+    // Generic 0-5V gauges (full DAC range)
+    CHECK(gauges.begin(3, 3, 4));
+
+    test_drain(csv.c_str());
+    test_ease();
+
+    host_exit();
+}
@@ -0,0 +1,225 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Music library index (user-028)
+ *
+ * Ten folders of 999 tracks each (ID3v2 tag with title and artist,
+ * Xing header) on an SD card with typical SPI latency.
+ * - Boot time per folder: Cold (no index: search for last file,
+ *   build index), warm (validate index), and the search for the last
+ *   file alone (what a boot cost before the index)
+ * - The index holds correct meta data
+ * - A replaced first or last track invalidates the index at boot;
+ *   a replaced track in between is re-scanned when its info is
+ *   loaded, and the index is updated
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_audio
+
+#include "../../dashgauges-A10001986/dg_audio.cpp"
+
+#include "host.h"
+#include <vector>
+
+#define FOLDERS     10
+#define TRACKS      999
+#define FRAME_LEN   417         // 128kbps, 44.1kHz, no padding
+
+static void id3Frame(std::vector<uint8_t>& f, const char *id, const char *txt)
+{
+    uint32_t len = strlen(txt) + 1;
+
+    f.insert(f.end(), id, id + 4);
+    f.insert(f.end(), { (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len, 0, 0, 0 });
+    f.insert(f.end(), txt, txt + len - 1);
+}
+
+// ID3v2.3 tag with TIT2/TPE1, one Xing frame, two audio frames
+static std::vector<uint8_t> makeMP3(const char *title, const char *artist, uint32_t frames)
+{
+    std::vector<uint8_t> f = { 'I', 'D', '3', 3, 0, 0, 0, 0, 0, 0 };
+
+    id3Frame(f, "TIT2", title);
+    id3Frame(f, "TPE1", artist);
+    f.resize(f.size() + 64, 0);                 // Padding
+    uint32_t tl = f.size() - 10;
+    f[8] = (tl >> 7) & 0x7f; f[9] = tl & 0x7f;
+
+    for(int i = 0; i < 3; i++) {
+        size_t o = f.size();
+        f.resize(o + FRAME_LEN, 0);
+        f[o] = 0xff; f[o+1] = 0xfb; f[o+2] = 0x90; f[o+3] = 0xc4;
+        if(!i) {
+            // Mono MPEG1: Side info 17 bytes
+            memcpy(&f[o + 4 + 17], "Xing\0\0\0\x01", 8);
+            f[o+29] = frames >> 24; f[o+30] = frames >> 16; f[o+31] = frames >> 8; f[o+32] = frames;
+        }
+    }
+
+    return f;
+}
+
+static void addTrack(int folder, int num, const char *title)
+{
+    char fn[32], artist[32];
+
+    sprintf(fn, "/music%d/%03d.mp3", folder, num);
+    sprintf(artist, "Artist %d", num % 17);
+    std::vector<uint8_t> d = makeMP3(title, artist, 1000 + num);
+    host_fsAddFile(SD, fn, d.data(), d.size());
+}
+
+static void setup()
+{
+    char fn[32], title[48];
+
+    host_fsClear(SD);
+    for(int i = 0; i < FOLDERS; i++) {
+        sprintf(fn, "/music%d", i);
+        host_fsMkdir(SD, fn);
+        strcat(fn, "/TCD_DONE.TXT");
+        host_fsAddFile(SD, fn, 0);
+        for(int j = 0; j < TRACKS; j++) {
+            sprintf(title, "Track %d of folder %d", j, i);
+            addTrack(i, j, title);
+        }
+    }
+    // SD over SPI: ~5ms per open/exists, ~0.5ms per read
+    // (at least one sector), ~1ms per KB
+    host_fsSetLatency(SD, { 5000, 1000, 0, 500 });
+}
+
+struct Cost {
+    uint64_t us;
+    uint32_t opens;
+    uint32_t reads;
+};
+
+static Cost measure(void (*fn)(int), int folder)
+{
+    HostFSOps o = host_fsOps(SD);
+    uint64_t t = host_nowUs();
+
+    fn(folder);
+
+    return { host_nowUs() - t, host_fsOps(SD).opens - o.opens, host_fsOps(SD).reads - o.reads };
+}
+
+static void boot(int folder)
+{
+    musFolderNum = folder;
+    mp_init(true);
+}
+
+static void findMax(int folder)
+{
+    musFolderNum = folder;
+    CHECK(mp_findMaxNum() == TRACKS - 1);
+}
+
+static const MPLibEntry *info(int track)
+{
+    aud_state.curTrack = track;
+    return mp_getTrackInfo();
+}
+
+static void test_boot()
+{
+    Cost cold = { 0 }, warm = { 0 }, old = { 0 };
+
+    for(int i = 0; i < FOLDERS; i++) {
+        Cost c = measure(findMax, i);
+        old.us += c.us; old.opens += c.opens;
+    }
+    for(int i = 0; i < FOLDERS; i++) {
+        Cost c = measure(boot, i);
+        cold.us += c.us; cold.opens += c.opens;
+        CHECK(haveMusic && aud_state.maxMusic == TRACKS - 1);
+    }
+    for(int i = 0; i < FOLDERS; i++) {
+        Cost c = measure(boot, i);
+        warm.us += c.us; warm.opens += c.opens;
+        CHECK(haveMusic && aud_state.maxMusic == TRACKS - 1);
+    }
+
+    printf("  per folder: search for last file %.1fms (%d opens)\n",
+            old.us / 1000.0 / FOLDERS, old.opens / FOLDERS);
+    printf("              cold boot %.1fms (%d opens), warm boot %.1fms (%d opens)\n",
+            cold.us / 1000.0 / FOLDERS, cold.opens / FOLDERS, warm.us / 1000.0 / FOLDERS, warm.opens / FOLDERS);
+
+    // Warm boot must not scan the folder
+    CHECK(warm.opens < old.opens);
+    CHECK(warm.us < old.us);
+    CHECK(cold.opens > FOLDERS * TRACKS);
+}
+
+static void test_info()
+{
+    boot(4);
+    const MPLibEntry *e = info(123);
+    CHECK(!strcmp(e->title, "Track 123 of folder 4"));
+    CHECK(!strcmp(e->artist, "Artist 4"));          // 123 % 17
+    CHECK(e->duration == (1000 + 123) * 1152 / 44100);
+    e = info(998);
+    CHECK(!strcmp(e->title, "Track 998 of folder 4"));
+}
+
+static void test_replaced()
+{
+    char fn[32];
+
+    // Track in between: Index still valid at boot, info is re-scanned
+    // once and index updated
+    boot(3);
+    addTrack(3, 500, "Replaced track with a longer title");
+    boot(3);
+    Cost c = measure([](int) { CHECK(mplib_check(3, aud_state.maxMusic)); }, 0);
+    CHECK(c.opens < 10);
+    CHECK(!strcmp(info(500)->title, "Replaced track with a longer title"));
+    mpCurInfoTrack = -1;
+    HostFSOps o = host_fsOps(SD);
+    CHECK(!strcmp(info(500)->title, "Replaced track with a longer title"));
+    // Index read, size checked; no re-scan
+    CHECK(host_fsOps(SD).opens - o.opens == 2);
+
+    // Last track replaced: Index rebuilt at boot
+    addTrack(3, TRACKS - 1, "New last track, different size");
+    CHECK(!mplib_check(3, aud_state.maxMusic));
+    boot(3);
+    CHECK(mplib_check(3, aud_state.maxMusic));
+    CHECK(!strcmp(info(TRACKS - 1)->title, "New last track, different size"));
+
+    // First track replaced
+    addTrack(3, 0, "New first track, different size");
+    CHECK(!mplib_check(3, aud_state.maxMusic));
+
+    // Track added
+    boot(3);
+    addTrack(3, TRACKS, "Track 999");
+    CHECK(!mplib_check(3, aud_state.maxMusic));
+    boot(3);
+    CHECK(aud_state.maxMusic == TRACKS);
+
+    // Last track removed
+    sprintf(fn, "/music3/%03d.mp3", TRACKS);
+    SD.remove(fn);
+    CHECK(!mplib_check(3, aud_state.maxMusic));
+}
+
+int main()
+{
+    host_init();
+    setup();
+
+    test_boot();
+    test_info();
+    test_replaced();
+
+    host_exit();
+}
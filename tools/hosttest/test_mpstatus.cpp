@@ -0,0 +1,184 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Music player status publishing (user-030)
+ *
+ * Runs a scripted interaction (connect, play, hold volume button,
+ * skip tracks, listen, toggle shuffle, stop) with mp_sendStatus()
+ * called every ms as from audio_loop(), and counts MQTT publishes;
+ * against the previous implementation (publish on every change of
+ * aud_state), replicated below.
+ * - Bursts are coalesced, at most one publish per MP_STAT_INT
+ * - The last publish after each step holds the final state
+ * - Position is re-sent while playing
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_audio
+
+#include "../../dashgauges-A10001986/dg_audio.cpp"
+
+#include "host.h"
+
+// Previous mp_sendStatus(), without building the message
+static Aud_State oldState;
+static uint32_t  oldPubs = 0;
+
+static void old_sendStatus(int force = 0)
+{
+    aud_state.state = (!FPBUnitIsOn || TTrunning || !haveMusic || dgBusy) ? 0 : (mpActive ? 1 : 2);
+    if(memcmp((void *)&oldState, (void *)&aud_state, sizeof(aud_state)) || force) {
+        memcpy((void *)&oldState, (void *)&aud_state, sizeof(aud_state));
+        oldPubs++;
+    }
+}
+
+static bool     useOld;
+static uint64_t lastPubUs;
+static uint64_t minGapUs;
+static uint32_t pubs;
+static uint32_t posPubs;
+static char     lastPl[1024];
+
+// Payload without position
+static void stripPos(char *d, const char *s)
+{
+    const char *p = strstr(s, ",\"P\":");
+    strcpy(d, s);
+    if(p) d[p - s] = 0;
+}
+
+static void send(int force = 0)
+{
+    if(useOld) {
+        old_sendStatus(force);
+        return;
+    }
+
+    uint32_t p = host_mqttPubs;
+    mp_sendStatus(force);
+    if(host_mqttPubs != p) {
+        if(pubs && !force && host_nowUs() - lastPubUs < minGapUs) minGapUs = host_nowUs() - lastPubUs;
+        lastPubUs = host_nowUs();
+        pubs++;
+        char pl[1024];
+        stripPos(pl, host_mqttLastPayload);
+        if(!strcmp(pl, lastPl)) posPubs++;
+        strcpy(lastPl, pl);
+    }
+}
+
+// Let ms pass, with a status check every ms
+static void run(uint32_t ms)
+{
+    while(ms--) {
+        host_advance(1);
+        send();
+    }
+}
+
+static int key(const char *k)
+{
+    char s[8];
+    sprintf(s, "\"%s\":\"", k);
+    const char *p = strstr(host_mqttLastPayload, s);
+    return p ? atoi(p + strlen(s)) : -1;
+}
+
+// Published state must match current state
+static void checkSettled()
+{
+    if(useOld) return;
+    run(MP_STAT_INT);
+    CHECK(key("C") == aud_state.curTrack);
+    CHECK(key("V") == aud_state.curVolume * 100 / (VOL_LEVELS - 1));
+    CHECK(key("SH") == aud_state.mpShuffle);
+    CHECK(strstr(host_mqttLastPayload, aud_state.state == 1 ? "\"S\":\"P\"" : "\"S\":\"I\""));
+}
+
+static uint32_t script(bool old)
+{
+    useOld = old;
+    pubs = posPubs = 0;
+    oldPubs = 0;
+    minGapUs = UINT64_MAX;
+
+    haveMusic = true;
+    mpActive = false;
+    aud_state.curTrack = 0;
+    aud_state.curVolume = 10;
+    aud_state.maxMusic = 99;
+    aud_state.mpShuffle = 0;
+
+    // MQTT connect
+    send(1);
+    run(1000);
+
+    // Play
+    mpActive = true;
+    mpTrackNow = millis();
+    run(1);
+    checkSettled();
+    run(2000);
+
+    // Hold volume up: 8 steps, 80ms apart
+    for(int i = 0; i < 8; i++) {
+        aud_state.curVolume++;
+        run(80);
+    }
+    checkSettled();
+    run(2000);
+
+    // Skip 4 tracks, 150ms apart
+    for(int i = 0; i < 4; i++) {
+        aud_state.curTrack++;
+        mpTrackNow = millis();
+        run(150);
+    }
+    checkSettled();
+
+    // Listen
+    run(35000);
+    if(!old) {
+        CHECK(key("P") >= 30);
+    }
+
+    // Toggle shuffle on and off and on
+    for(int i = 0; i < 3; i++) {
+        aud_state.mpShuffle ^= 1;
+        run(100);
+    }
+    checkSettled();
+
+    // Stop
+    mpActive = false;
+    run(1);
+    checkSettled();
+    run(1000);
+
+    return old ? oldPubs : pubs;
+}
+
+int main()
+{
+    host_init();
+    pubMP = true;
+    FPBUnitIsOn = true;
+
+    uint32_t o = script(true);
+    uint32_t n = script(false);
+
+    printf("  scripted interaction: %d publishes before, %d now (%d of which position updates)\n", o, n, posPubs);
+
+    CHECK(n - posPubs < o);
+    CHECK(posPubs >= 3);
+    CHECK(minGapUs >= MP_STAT_INT * 1000);
+    CHECK(strstr(host_mqttLastPayload, "\"T\":\"") && strstr(host_mqttLastPayload, "\"D\":\""));
+
+    host_exit();
+}
@@ -0,0 +1,194 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: PWM gauges and the digital gauge rate limiter (user-037)
+ *
+ * - PWM: Duty cycle is maxDuty * percent / 100 (rounded), with and
+ *   without calibration curve, and follows motion monotonically;
+ *   each gauge has its own LEDC timer and frequency; off() and on()
+ *   work; a pin can't be shared, and strapping pins are refused
+ * - Digital: Random on/off requests over 10 minutes, with
+ *   sched_run() as from the main loop. The pin never switches
+ *   faster than DIG_SWITCH_MIN_TIME, switches right away after a
+ *   quiet period, and always ends up in the last requested state
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dgdisplay
+
+#include "../../dashgauges-A10001986/dgdisplay.cpp"
+
+#include "host.h"
+
+static Gauges gauges;
+
+#define CH_A    PWM_CHANNEL(0)
+#define CH_B    PWM_CHANNEL(1)
+
+static void test_types()
+{
+    struct ga_types t = { 21, "Test PWM", DGD_TYPE_PWM, {}, { 4 }, { 1000, 512 } };
+
+    // Strapping pins and bad parameters are refused
+    static const uint8_t badPins[] = { 0, 2, 15, 5, 34 };
+    for(size_t i = 0; i < sizeof(badPins); i++) {
+        struct ga_types b = t;
+        b.dga.gpioPin = badPins[i];
+        CHECK(!gauges.addGaugeType(true, &b));
+    }
+    struct ga_types b = t;
+    b.pga.freq = PWM_MAX_FREQ + 1;
+    CHECK(!gauges.addGaugeType(true, &b));
+    b = t;
+    b.pga.maxDuty = PWM_MAX_DUTY + 1;
+    CHECK(!gauges.addGaugeType(true, &b));
+
+    CHECK(gauges.addGaugeType(true, &t));
+
+    // A second PWM gauge on gpio 4 can't be used along with 21
+    t.id = 22;
+    CHECK(gauges.addGaugeType(false, &t));
+}
+
+static void test_pwm()
+{
+    // A: Built-in PWM on DIGITAL_GAUGE_PIN (5kHz, full duty)
+    // B: User type on gpio 4 (1kHz, half duty)
+    // C: Same pin as B, refused
+    CHECK(gauges.begin(6, 21, 22));
+    CHECK(gauges.supportVariablePercentage(0));
+    CHECK(gauges.supportVariablePercentage(1));
+    CHECK(!gauges.supportVariablePercentage(2));
+
+    // Own timer per gauge, not the Empty LED's
+    CHECK((CH_A >> 1) != (CH_B >> 1));
+    CHECK((CH_A >> 1) != (EL_PWM_CHANNEL >> 1) && (CH_B >> 1) != (EL_PWM_CHANNEL >> 1));
+    CHECK(host_ledcFreq[CH_A] == 5000);
+    CHECK(host_ledcFreq[CH_B] == 1000);
+
+    // Linear
+    int bad = 0;
+    for(int p = 0; p <= 100; p++) {
+        gauges.setValuePercent(0, p);
+        gauges.setValuePercent(1, p);
+        gauges.UpdateAll();
+        if(host_ledcDuty[CH_A] != (uint32_t)lround(PWM_MAX_DUTY * p / 100.0)) bad++;
+        if(host_ledcDuty[CH_B] != (uint32_t)lround(512 * p / 100.0)) bad++;
+    }
+    CHECK(!bad);
+
+    // Calibrated
+    CHECK(gauges.setCalibration(1, "50:25"));
+    gauges.setValuePercent(1, 50);
+    gauges.UpdateAll();
+    CHECK(host_ledcDuty[CH_B] == 128);
+    gauges.setValuePercent(1, 75);
+    gauges.UpdateAll();
+    CHECK(host_ledcDuty[CH_B] == 320);
+    CHECK(gauges.setCalibration(1, ""));
+
+    // off() and on()
+    gauges.setValuePercent(0, 60);
+    gauges.setValuePercent(1, 60);
+    gauges.UpdateAll();
+    gauges.off();
+    CHECK(host_ledcDuty[CH_A] == 0 && host_ledcDuty[CH_B] == 0);
+    gauges.on();
+    CHECK(host_ledcDuty[CH_A] == 614 && host_ledcDuty[CH_B] == 307);
+
+    // Motion: Monotonic, at most one write per DGM_TICK_MS
+    gauges.setValuePercent(0, 0);
+    gauges.UpdateAll();
+    host_advance(DGM_TICK_MS);
+    gauges.loop();
+    uint32_t w = host_ledcWrites, prev = 0;
+    int dec = 0;
+    gauges.moveTo(0, 100, 1000, DGM_EASE_INOUT);
+    for(int ms = 0; ms < 2000; ms++) {
+        host_advance(1);
+        gauges.loop();
+        if(host_ledcDuty[CH_A] < prev) dec++;
+        prev = host_ledcDuty[CH_A];
+    }
+    // Two gauges written per update
+    printf("  PWM motion 0-100%% in 1s: %d duty writes\n", (host_ledcWrites - w) / 2);
+    CHECK(!dec);
+    CHECK(host_ledcDuty[CH_A] == PWM_MAX_DUTY);
+    CHECK((host_ledcWrites - w) / 2 <= 2000 / DGM_TICK_MS);
+}
+
+static void test_digital()
+{
+    int changes = 0, late = 0, tooFast = 0, lost = 0, immediate = 0, quiet = 0;
+    int pin = DIGITAL_GAUGE_PIN;
+    int want = 0, lastLevel;
+    unsigned long lastChg = 0, lastReq = 0;
+
+    // A: Digital (relay) gauge on DIGITAL_GAUGE_PIN
+    CHECK(gauges.begin(2, 0, 0));
+    CHECK(!gauges.supportVariablePercentage(0));
+    gauges.setBinGaugeThreshold(0, 50);
+    host_advance(DIG_SWITCH_MIN_TIME);
+    lastLevel = host_getPin(pin);
+    CHECK(lastLevel == 0);
+
+    host_seed(37);
+    unsigned long next = millis() + 100;
+    for(int ms = 0; ms < 600000; ms++) {
+        unsigned long now = millis();
+
+        if(now == next) {
+            int req = rand() & 1;
+            // Quiet periods now and then
+            next = now + ((rand() % 8) ? 10 + rand() % 800 : 2000 + rand() % 3000);
+            gauges.setValuePercent(0, req ? 80 : 20);
+            gauges.UpdateAll();
+            if(req != want) {
+                if(req != lastLevel && now - lastChg >= DIG_SWITCH_MIN_TIME) {
+                    quiet++;
+                    if(host_getPin(pin) == req) immediate++;
+                }
+                want = req;
+                lastReq = now;
+            }
+        }
+
+        sched_run(now);
+
+        int l = host_getPin(pin);
+        if(l != lastLevel) {
+            if(changes && now - lastChg < DIG_SWITCH_MIN_TIME) tooFast++;
+            changes++;
+            lastChg = now;
+            lastLevel = l;
+        }
+        // Settled: Request older than the minimum time, pin must follow
+        if(now - lastReq > DIG_SWITCH_MIN_TIME && l != want) lost++;
+        if(now - lastReq == DIG_SWITCH_MIN_TIME + 1 && l != want) late++;
+
+        host_advance(1);
+    }
+
+    printf("  relay: %d switches in 10min, %d of %d after quiet periods immediate\n", changes, immediate, quiet);
+    CHECK(changes > 100);
+    CHECK(!tooFast);
+    CHECK(!lost && !late);
+    CHECK(quiet > 10 && immediate == quiet);
+}
+
+int main()
+{
+    host_init();
+    host_failTaskCreate = true;
+
+    test_types();
+    test_pwm();
+    test_digital();
+
+    host_exit();
+}
@@ -0,0 +1,150 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Renamer directory scan (user-029)
+ *
+ * Runs in real time, so the scan task and the loop task actually
+ * run concurrently. Scans a folder with 999 new MP3s (and some
+ * other files) on an SD card with slow directory reads, with the
+ * scan task, and with task creation failing (enumeration on the
+ * loop task, as before). The loop task keeps servicing WiFi, which
+ * takes its time, too.
+ * - Both ways collect the same file names
+ * - Wall clock time of both
+ * - A full rename produces 000.mp3... in (case insensitive) sort
+ *   order of the original names
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_audio
+
+#include "../../dashgauges-A10001986/dg_audio.cpp"
+
+#include "host.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define NEWFILES    999
+
+static void setup()
+{
+    char fn[64];
+
+    host_fsClear(SD);
+    host_fsMkdir(SD, "/music0");
+    for(int i = 0; i < NEWFILES; i++) {
+        // Contents: Original name
+        sprintf(fn, "/music0/%02d - Some Artist - Song number %d.mp3", i % 100, i);
+        host_fsAddFile(SD, fn, (const uint8_t *)fn + 8, strlen(fn + 8));
+    }
+    host_fsAddFile(SD, "/music0/cover.jpg", 16);
+    host_fsAddFile(SD, "/music0/._hidden.mp3", 16);
+    host_fsAddFile(SD, "/music0/notes.txt", 16);
+}
+
+struct Scan {
+    std::vector<std::string> names;
+    uint64_t us;
+};
+
+// mp_renameFilesInDir() up to the end of the scan
+static Scan scan(bool useTask)
+{
+    Scan r;
+    MPRenState st;
+    char **a = (char **)malloc(1000 * sizeof(char *));
+
+    memset((void *)&st, 0, sizeof(st));
+    st.bufs[0] = (char *)malloc(16384);
+    st.c = st.bufs[0];
+    st.bufSize = 16384;
+    st.d = a;
+
+    host_failTaskCreate = !useTask;
+    uint64_t t = host_nowUs();
+    File origin = SD.open("/music0");
+    mpren_scanDir(origin, &st);
+    origin.close();
+    r.us = host_nowUs() - t;
+    host_failTaskCreate = false;
+
+    for(int i = 0; i < st.fileNum; i++) {
+        r.names.push_back(a[i]);
+    }
+    std::sort(r.names.begin(), r.names.end());
+
+    for(int i = 0; i <= st.allocBufIdx; i++) {
+        free(st.bufs[i]);
+    }
+    free(a);
+
+    return r;
+}
+
+static void test_scan()
+{
+    // Long names are spread over several FAT LFN entries: ~2ms
+    // per file over SPI. A WiFi loop iteration: ~5ms.
+    host_fsSetLatency(SD, { 0, 0, 2000, 0 });
+    host_wifiLoopUs = 5000;
+
+    Scan loop = scan(false);
+    Scan task = scan(true);
+
+    printf("  scan of %d files: loop task %.0fms, scan task %.0fms\n",
+            NEWFILES + 3, loop.us / 1000.0, task.us / 1000.0);
+
+    CHECK(loop.names.size() == NEWFILES);
+    CHECK(task.names == loop.names);
+    CHECK(task.us < loop.us);
+}
+
+static void test_rename()
+{
+    char fn[64];
+
+    host_fsSetLatency(SD, { 0, 0, 0, 0 });
+    host_wifiLoopUs = 0;
+
+    std::vector<std::string> names = scan(true).names;
+    std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+        for(size_t i = 0; i < a.size() && i < b.size(); i++) {
+            if(mpren_toUpper(a[i]) != mpren_toUpper(b[i]))
+                return mpren_toUpper(a[i]) < mpren_toUpper(b[i]);
+        }
+        return a.size() < b.size();
+    });
+
+    musFolderNum = 0;
+    CHECK(mp_renameFilesInDir(true));
+    CHECK(host_fsExists(SD, "/music0/TCD_DONE.TXT"));
+    CHECK(host_fsExists(SD, "/music0/cover.jpg"));
+    CHECK(host_fsExists(SD, "/music0/._hidden.mp3"));
+
+    int bad = 0;
+    for(int i = 0; i < NEWFILES; i++) {
+        sprintf(fn, "/music0/%03d.mp3", i);
+        std::vector<uint8_t> d = host_fsRead(SD, fn);
+        if(std::string(d.begin(), d.end()) != names[i]) bad++;
+    }
+    CHECK(bad == 0);
+    CHECK(host_fsOps(SD).renames == NEWFILES);
+    CHECK(!host_fsExists(SD, "/music0/00 - Some Artist - Song number 0.mp3"));
+}
+
+int main()
+{
+    host_init(true);
+    setup();
+
+    test_scan();
+    test_rename();
+
+    host_exit();
+}
@@ -0,0 +1,182 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Timer scheduler across the millis() wrap (user-038)
+ *
+ * Virtual clock, sched_run() every ms, as from the main loop.
+ * - Random timers (start in the past or now, random delays, random
+ *   stops and re-arms), run across the 32 bit millis() wrap and
+ *   the signed boundary: Every timer fires exactly at its due
+ *   time, in due order, stopped timers never fire
+ * - The same requests, checked the old way (millis() >= scheduled),
+ *   fire early or late around the wrap
+ * - A timer re-armed from its callback keeps its period across the
+ *   wrap
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_sched
+
+#include "../../dashgauges-A10001986/dg_sched.cpp"
+
+#include "host.h"
+
+#define NTIMERS     SCHED_MAX_TIMERS
+
+struct Rec {
+    struct schedTimer t;
+    uint32_t due;               // Due time (32 bit)
+    uint32_t fireAt;            // Expected: Due time, or now if passed
+    uint32_t oldSched;          // millis() >= oldSched, as before
+    bool     armed;
+    bool     oldArmed;
+};
+
+static Rec      recs[NTIMERS];
+static uint32_t lastFiredDue;
+static bool     firedThisRun;
+static int      fired, wrong, outOfOrder, stray;
+
+static void due(struct schedTimer *t, unsigned long now)
+{
+    Rec *r = &recs[t->id];
+
+    if(!r->armed) {
+        stray++;
+        return;
+    }
+    if((uint32_t)now != r->fireAt) wrong++;
+    if(firedThisRun && (int32_t)(r->due - lastFiredDue) < 0) outOfOrder++;
+    lastFiredDue = r->due;
+    firedThisRun = true;
+    r->armed = false;
+    fired++;
+}
+
+// Run random timers for "ms" ms from millis() = "from"
+static int run(uint32_t from, uint32_t ms, int *oldEarly, int *oldLate)
+{
+    fired = wrong = outOfOrder = stray = 0;
+    *oldEarly = *oldLate = 0;
+
+    host_setMillis(from);
+    for(int i = 0; i < NTIMERS; i++) {
+        sched_init(&recs[i].t, due, NULL, i);
+        recs[i].armed = recs[i].oldArmed = false;
+    }
+
+    for(uint32_t n = 0; n < ms; n++) {
+        uint32_t now = (uint32_t)millis();
+
+        // Arm, re-arm or stop a random timer now and then
+        if(!(rand() % 20)) {
+            Rec *r = &recs[rand() % NTIMERS];
+            if(rand() % 4) {
+                uint32_t back = (rand() % 3) ? 0 : rand() % 500;
+                uint32_t del = rand() % 4000;
+                CHECK(sched_start(&r->t, now - back, del));
+                r->due = now - back + del;
+                r->fireAt = ((int32_t)(r->due - now) > 0) ? r->due : now;
+                r->armed = true;
+                // Old: millis() + delay, compared with >=
+                r->oldSched = now - back + del;
+                r->oldArmed = true;
+            } else {
+                sched_stop(&r->t);
+                r->armed = r->oldArmed = false;
+            }
+        }
+
+        for(int i = 0; i < NTIMERS; i++) {
+            Rec *r = &recs[i];
+            if(r->oldArmed && now >= r->oldSched) {
+                if((int32_t)(now - r->due) < 0) (*oldEarly)++;
+                r->oldArmed = false;
+            } else if(r->oldArmed && (int32_t)(now - r->due) > 1) {
+                (*oldLate)++;
+                r->oldArmed = false;
+            }
+        }
+
+        firedThisRun = false;
+        sched_run(millis());
+
+        host_advance(1);
+    }
+
+    for(int i = 0; i < NTIMERS; i++) {
+        sched_stop(&recs[i].t);
+    }
+
+    CHECK(!wrong);
+    CHECK(!outOfOrder);
+    CHECK(!stray);
+    CHECK(fired > 100);
+
+    return fired;
+}
+
+static void test_random()
+{
+    static const struct {
+        const char *name;
+        uint32_t from;
+    } starts[] = {
+        { "boot",           0 },
+        { "signed wrap",    0x7fffffff - 30000 },
+        { "millis() wrap",  0xffffffff - 30000 },
+    };
+
+    host_seed(38);
+    for(size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        int oe, ol;
+        int f = run(starts[i].from, 60000, &oe, &ol);
+        printf("  %-14s: %4d timers fired on time; old check: %d early, %d late\n", starts[i].name, f, oe, ol);
+        if(starts[i].from == 0xffffffff - 30000) {
+            CHECK(oe + ol > 0);
+        }
+    }
+}
+
+static uint32_t perLast, perBad, perCnt;
+
+static void periodic(struct schedTimer *t, unsigned long now)
+{
+    if(perCnt && (uint32_t)now - perLast != 7) perBad++;
+    perLast = now;
+    perCnt++;
+    sched_start(t, t->due, 7);
+}
+
+static void test_periodic()
+{
+    struct schedTimer t;
+
+    host_setMillis(0xffffffff - 1000);
+    sched_init(&t, periodic);
+    sched_start(&t, millis(), 7);
+    for(int n = 0; n < 2000; n++) {
+        sched_run(millis());
+        host_advance(1);
+    }
+    sched_stop(&t);
+
+    printf("  periodic: %d runs across the wrap\n", perCnt);
+    CHECK(perCnt == 2000 / 7);
+    CHECK(!perBad);
+}
+
+int main()
+{
+    host_init();
+
+    test_random();
+    test_periodic();
+
+    host_exit();
+}
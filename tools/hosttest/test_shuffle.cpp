@@ -0,0 +1,118 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Music player shuffle (user-026)
+ *
+ * - idx2track is a permutation of 0..maxMusic for all sizes, and
+ *   track2idx is its inverse (so mp_gotonum() needs no search)
+ * - the same seed gives the same order
+ * - the first track is uniformly distributed over seeds
+ * - after a reshuffle, none of the last MP_SHUF_HIST tracks is
+ *   among the first MP_SHUF_HIST ones
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_audio
+
+#include "../../dashgauges-A10001986/dg_audio.cpp"
+
+#include "host.h"
+#include <vector>
+
+static std::vector<int> order(int n, uint32_t seed)
+{
+    std::vector<int> o(n);
+
+    aud_state.maxMusic = n - 1;
+    aud_state.mpShuffle = 1;
+    mp_shuffleSetKey(seed);
+    for(int i = 0; i < n; i++) {
+        o[i] = mp_idx2track(i);
+    }
+    return o;
+}
+
+static void test_permutation()
+{
+    static const int sizes[] = { 1, 2, 3, 4, 5, 15, 16, 17, 63, 64, 65, 100, 255, 256, 257, 999, 1000 };
+
+    for(int n : sizes) {
+        for(uint32_t seed = 1; seed < 50; seed++) {
+            std::vector<int> o = order(n, seed * 2654435761u);
+            std::vector<bool> seen(n, false);
+            for(int i = 0; i < n; i++) {
+                CHECK(o[i] >= 0 && o[i] < n);
+                if(o[i] < 0 || o[i] >= n) break;
+                CHECK(!seen[o[i]]);
+                seen[o[i]] = true;
+                CHECK(mp_track2idx(o[i]) == i);
+            }
+        }
+    }
+}
+
+static void test_deterministic()
+{
+    CHECK(order(500, 12345) == order(500, 12345));
+    CHECK(order(500, 12345) != order(500, 12346));
+}
+
+// Chi-square of first track's distribution over many seeds
+static void test_uniform(int n, int runs)
+{
+    std::vector<int> cnt(n, 0);
+    double exp = (double)runs / n, chi = 0;
+
+    for(int s = 1; s <= runs; s++) {
+        cnt[order(n, esp_random() | 1)[0]]++;
+    }
+    for(int i = 0; i < n; i++) {
+        chi += (cnt[i] - exp) * (cnt[i] - exp) / exp;
+    }
+
+    // 99.9% quantile of chi-square with n-1 degrees of freedom,
+    // Wilson-Hilferty approximation
+    double k = n - 1, z = 3.09;
+    double lim = k * pow(1 - 2 / (9 * k) + z * sqrt(2 / (9 * k)), 3);
+    printf("  n=%d: chi2 %.1f (limit %.1f)\n", n, chi, lim);
+    CHECK(chi < lim);
+}
+
+static void test_history()
+{
+    int clashes = 0, n = 100;
+
+    for(uint32_t seed = 1; seed <= 1000; seed++) {
+        std::vector<int> o = order(n, seed * 7919);
+        mp_reshuffle();
+        for(int i = 0; i < MP_SHUF_HIST; i++) {
+            int nt = mp_idx2track(i);
+            for(int j = 0; j < MP_SHUF_HIST; j++) {
+                if(nt == o[n - 1 - j]) clashes++;
+            }
+        }
+    }
+    printf("  reshuffle: %d clashes in 1000 runs\n", clashes);
+    CHECK(clashes == 0);
+}
+
+int main()
+{
+    host_init();
+    host_seed(42);
+    haveMusic = true;
+
+    test_permutation();
+    test_deterministic();
+    test_uniform(5, 20000);
+    test_uniform(37, 37000);
+    test_uniform(1000, 100000);
+    test_history();
+
+    host_exit();
+}
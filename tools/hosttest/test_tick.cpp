@@ -0,0 +1,115 @@
+/*
+ * -------------------------------------------------------------------
+ * Dash Gauges Panel
+ * (C) 2023-2026 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Dash-Gauges
+ * https://dg.out-a-ti.me
+ *
+ * Host test: Tick service (user-040)
+ *
+ * - Virtual clock: Jobs run exactly at multiples of their periods;
+ *   the base tick is the GCD of all periods, so the timer never
+ *   fires without a job due; adding a job changes the base tick
+ *   without making the others drift
+ * - Real time: While the main thread is blocked for 200ms at a
+ *   time (like a slow wifi_loop()), a 2ms job keeps its period
+ *
+ * License: Modified MIT NON-AI (see LICENSE)
+ */
+
+// HOSTTEST: uses dg_sched
+
+#include "../../dashgauges-A10001986/dg_sched.cpp"
+
+#include "host.h"
+#include <atomic>
+
+struct Job {
+    uint16_t               period;
+    std::atomic<int>       runs;
+    std::vector<uint32_t>  at;          // millis() of each run
+};
+
+static void job(void *arg)
+{
+    Job *j = (Job *)arg;
+    j->at.push_back(millis());
+    j->runs++;
+}
+
+static void test_virtual()
+{
+    static Job a, b, c;
+    int bad = 0;
+
+    a.period = 10; b.period = 4; c.period = 6;
+
+    CHECK(tick_begin());
+    CHECK(tick_addJob(job, &a, a.period));
+    CHECK(tickMs == 10);
+    CHECK(tick_addJob(job, &b, b.period));
+    CHECK(tickMs == 2);
+
+    host_advance(1000);
+
+    // Adding a 6ms job: Base tick stays 2ms
+    CHECK(tick_addJob(job, &c, c.period));
+    CHECK(tickMs == 2);
+    uint32_t t6 = millis();
+    host_advance(1200);
+
+    for(Job *j : { &a, &b }) {
+        for(size_t i = 0; i < j->at.size(); i++) {
+            if(j->at[i] != (i + 1) * j->period) bad++;
+        }
+    }
+    for(size_t i = 0; i < c.at.size(); i++) {
+        if(c.at[i] != t6 + (i + 1) * c.period) bad++;
+    }
+    printf("  jobs 10/4/6ms: %d/%d/%d runs in 2.2s, base tick %dms\n",
+            (int)a.runs, (int)b.runs, (int)c.runs, (int)tickMs);
+    CHECK(!bad);
+    CHECK(a.runs == 220 && b.runs == 550 && c.runs == 200);
+}
+
+static void test_realtime()
+{
+    static Job d;
+
+    // Restart the timer on the real clock. Jobs can't be removed;
+    // the others keep running.
+    esp_timer_stop(tickTimer);
+    esp_timer_start_periodic(tickTimer, (uint64_t)tickMs * 1000);
+    d.period = 2;
+    CHECK(tick_addJob(job, &d, d.period));
+    uint64_t t0 = host_nowUs();
+
+    // Main loop stuck in 200ms calls
+    for(int i = 0; i < 5; i++) {
+        delay(200);
+    }
+    double ms = (host_nowUs() - t0) / 1000.0;
+    esp_timer_stop(tickTimer);
+
+    int runs = d.runs;
+    uint32_t maxGap = 0;
+    for(size_t i = 1; i < d.at.size(); i++) {
+        if(d.at[i] - d.at[i - 1] > maxGap) maxGap = d.at[i] - d.at[i - 1];
+    }
+    printf("  2ms job during 5 x 200ms main loop stalls: %d runs in %.0fms, longest gap %dms\n", runs, ms, maxGap);
+    // Allow for scheduling noise on a loaded host
+    CHECK(runs >= (int)(ms / d.period) / 2);
+    CHECK(runs <= (int)(ms / d.period) + 2);
+    CHECK(maxGap <= 10);
+}
+
+int main()
+{
+    host_init();
+    test_virtual();
+
+    host_init(true);
+    test_realtime();
+
+    host_exit();
+}
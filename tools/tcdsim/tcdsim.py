@@ -0,0 +1,576 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# Dash Gauges Panel
+# (C) 2023-2026 Thomas Winischhofer (A10001986)
+# https://github.com/realA10001986/Dash-Gauges
+# https://dg.out-a-ti.me
+#
+# tcdsim: Time Circuits Display stand-in for testing the BTTFN
+# client without a real TCD.
+#
+# License: Modified MIT NON-AI (see LICENSE)
+# -------------------------------------------------------------------
+#
+# Speaks the 48-byte BTTFN protocol as seen from the Dash Gauges
+# (see bttfnRsp/bttfnNot in dg_main.cpp):
+#
+# - answers status requests on port 1338 (speed, status, caps),
+# - answers DISCOVER on 224.0.0.224:1339 if the hostname hash matches,
+# - sends notifications (speed, TT, alarm, commands, NOT_DATA) by
+#   unicast, or by multicast to 224.0.0.224:1340,
+# - drops and reorders packets on request,
+# - counts what the panel sends, and times the panel's reactions.
+#
+# Python 3, standard library only.
+
+import argparse
+import heapq
+import random
+import select
+import signal
+import socket
+import struct
+import sys
+import time
+
+PACKET_SIZE     = 48
+BTTFN_VERSION   = 1
+TCD_PORT        = 1338      # TCD listens here; panels too (unicast)
+DISCOVER_PORT   = 1339      # DISCOVER requests (multicast)
+MC_PORT         = 1340      # Notifications to panels (multicast)
+MC_GROUP        = "224.0.0.224"
+
+# Request bits (byte 5 of request)
+RQ_SPEED        = 0x02
+RQ_STATUS       = 0x10
+RQ_CAPS         = 0x40
+RQ_DISCOVER     = 0x80      # With hostname hash; without: trigger TT
+
+# Panel capability bits (byte 4 of request)
+SUP_MC          = 0x80
+SUP_ND          = 0x40
+
+# Our capabilities (byte 31 of response)
+CAP_MC_SPEED    = 0x01
+CAP_NOT_DATA    = 0x10
+CAP_CMD_DOOR    = 0x20
+
+# Status bits (byte 26 of response)
+ST_NM           = 0x01
+ST_FPO          = 0x02
+ST_BUSY         = 0x10
+ST_ROTENC       = 0x80
+
+NOT_PREPARE     = 1
+NOT_TT          = 2
+NOT_REENTRY     = 3
+NOT_ABORT_TT    = 4
+NOT_ALARM       = 5
+NOT_REFILL      = 6
+NOT_PCG_CMD     = 9
+NOT_WAKEUP      = 10
+NOT_SPD         = 15
+NOT_INFO        = 16
+NOT_DATA        = 0x80
+
+REMCMD_DOOR      = 100
+REMCMD_KEEPALIVE = 101
+
+SSRC_GPS        = 1
+SSRC_ROTENC     = 2
+
+NOT_NAMES = {
+    NOT_PREPARE: "PREPARE", NOT_TT: "TT", NOT_REENTRY: "REENTRY",
+    NOT_ABORT_TT: "ABORT_TT", NOT_ALARM: "ALARM", NOT_REFILL: "REFILL",
+    NOT_PCG_CMD: "PCG_CMD", NOT_WAKEUP: "WAKEUP", NOT_SPD: "SPD",
+    NOT_INFO: "INFO", NOT_DATA: "DATA",
+}
+
+DEVTYPES = { 0: "any", 1: "FC", 2: "SID", 3: "DG", 4: "VSR", 5: "AUX", 6: "Remote" }
+
+
+def now_ms():
+    return time.monotonic() * 1000.0
+
+
+def hostname_hash(name):
+    # As bttfn_setup() in dg_main.cpp
+    h = 0
+    for c in name.lower().encode():
+        h = (37 * h + c) & 0xffffffff
+    return h
+
+
+def checksum(buf):
+    a = 0
+    for b in buf[4:PACKET_SIZE - 1]:
+        a += b ^ 0x55
+    return a & 0xff
+
+
+def new_packet(ver, flags):
+    buf = bytearray(PACKET_SIZE)
+    buf[0:4] = b"BTTF"
+    buf[4] = ver
+    buf[5] = flags
+    return buf
+
+
+def finish(buf):
+    buf[PACKET_SIZE - 1] = checksum(buf)
+    return bytes(buf)
+
+
+def notification(ntype, p0=0, p1=0, cmd=None, seq=0):
+    buf = new_packet(BTTFN_VERSION | 0x40, ntype)
+    if cmd is not None:
+        struct.pack_into("<I", buf, 6, cmd)
+    else:
+        struct.pack_into("<HH", buf, 6, p0 & 0xffff, p1 & 0xffff)
+    struct.pack_into("<I", buf, 12, seq)
+    return finish(buf)
+
+
+class Stat:
+    """ min/avg/max of a series of times (ms) """
+
+    def __init__(self):
+        self.n = 0
+        self.sum = 0.0
+        self.min = None
+        self.max = None
+
+    def add(self, v):
+        self.n += 1
+        self.sum += v
+        self.min = v if self.min is None else min(self.min, v)
+        self.max = v if self.max is None else max(self.max, v)
+
+    def __str__(self):
+        if not self.n:
+            return "-"
+        return "n=%d min=%.0f avg=%.0f max=%.0f" % (self.n, self.min, self.sum / self.n, self.max)
+
+
+class Client:
+
+    def __init__(self, addr):
+        self.addr = addr
+        self.name = "?"
+        self.devtype = 0
+        self.last_seen = 0.0
+        self.requests = 0
+        self.discovers = 0
+        self.tt_triggers = 0
+        self.commands = {}
+        self.door = { "open": 0, "close": 0 }
+        self.last_poll = None
+        self.lost_rsp = None        # Time of last dropped response
+        self.prepare = None         # Time of last NOT_PREPARE sent
+        self.last_ka = None
+        self.last_cmd_seq = None
+        self.cmd_seq_gaps = 0
+        self.poll_int = Stat()      # Between status requests
+        self.retry = Stat()         # Dropped response -> next request
+        self.prep_react = Stat()    # NOT_PREPARE -> next request
+        self.ka_int = Stat()        # Between KEEPALIVEs
+        self.nd = False             # Supports NOT_DATA
+
+
+class TCDSim:
+
+    def __init__(self, args):
+        self.a = args
+        self.rnd = random.Random(args.seed)
+        self.hash = hostname_hash(args.name)
+        self.clients = {}
+        self.timers = []
+        self.tseq = 0
+        self.held = {}              # Reordering: dest -> (due, packet)
+        self.spd_seq = 0
+        self.data_seq = 0
+        self.session = self.rnd.getrandbits(32) or 1
+        self.speed = 0
+        self.spd_dir = 1
+        self.status = 0
+        self.ttrunning = False
+        self.cnt = { "rx": 0, "rx_bad": 0, "rsp": 0, "rsp_lost": 0,
+                     "not": 0, "not_lost": 0, "not_reord": 0, "not_mc": 0 }
+        self.not_cnt = {}
+        self.start = now_ms()
+
+        self.caps = CAP_CMD_DOOR
+        if args.mc:
+            self.caps |= CAP_MC_SPEED
+        if args.notdata:
+            self.caps |= CAP_NOT_DATA
+
+        self.sock = self.open_socket()
+        self.mcsock = self.open_discover_socket()
+
+    # Sockets -----------------------------------------------------
+
+    def open_socket(self):
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        s.bind((self.a.bind, TCD_PORT))
+        s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+        s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+        if self.a.bind:
+            s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(self.a.bind))
+        return s
+
+    def open_discover_socket(self):
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        try:
+            s.bind((MC_GROUP, DISCOVER_PORT))
+        except OSError:
+            s.bind(("", DISCOVER_PORT))
+        iface = socket.inet_aton(self.a.bind) if self.a.bind else struct.pack("=I", socket.INADDR_ANY)
+        s.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(MC_GROUP) + iface)
+        return s
+
+    # Timers ------------------------------------------------------
+
+    def at(self, when, fn, *args):
+        self.tseq += 1
+        heapq.heappush(self.timers, (when, self.tseq, fn, args))
+
+    def every(self, period_ms, fn):
+        if period_ms <= 0:
+            return
+        def tick(due):
+            fn()
+            self.at(due + period_ms, tick, due + period_ms)
+        self.at(now_ms() + period_ms, tick, now_ms() + period_ms)
+
+    # Sending -----------------------------------------------------
+
+    def lose(self, pct):
+        return pct > 0 and self.rnd.random() * 100.0 < pct
+
+    def send(self, pkt, dest, is_not):
+        """ Send with simulated loss and reordering """
+        if self.lose(self.a.loss):
+            self.cnt["not_lost" if is_not else "rsp_lost"] += 1
+            return False
+
+        if is_not and self.a.reorder > 0:
+            held = self.held.pop(dest, None)
+            if held is None and self.lose(self.a.reorder):
+                # Hold back; goes out after the next one to dest
+                self.held[dest] = (now_ms() + self.a.reorder_hold, pkt)
+                self.cnt["not_reord"] += 1
+                return True
+            self.sock.sendto(pkt, dest)
+            if held is not None:
+                self.sock.sendto(held[1], dest)
+            return True
+
+        self.sock.sendto(pkt, dest)
+        return True
+
+    def flush_held(self, force=False):
+        t = now_ms()
+        for dest in list(self.held):
+            due, pkt = self.held[dest]
+            if force or t >= due:
+                del self.held[dest]
+                self.sock.sendto(pkt, dest)
+
+    def active_clients(self):
+        t = now_ms()
+        return [c for c in self.clients.values() if t - c.last_seen < self.a.client_to * 1000]
+
+    def notify(self, ntype, p0=0, p1=0, cmd=None, seq=0):
+        pkt = notification(ntype, p0, p1, cmd, seq)
+        name = NOT_NAMES.get(ntype, str(ntype))
+        self.not_cnt[name] = self.not_cnt.get(name, 0) + 1
+        if self.a.mc:
+            self.cnt["not"] += 1
+            self.cnt["not_mc"] += 1
+            self.send(pkt, (MC_GROUP, MC_PORT), True)
+        else:
+            for c in self.active_clients():
+                self.cnt["not"] += 1
+                self.send(pkt, c.addr, True)
+        if ntype == NOT_PREPARE:
+            t = now_ms()
+            for c in self.active_clients():
+                c.prepare = t
+        self.log(2, "-> NOT_%s p0=%d p1=%d" % (name, p0, p1))
+
+    def response(self, flags, rid):
+        buf = new_packet(BTTFN_VERSION | 0x80, flags)
+        struct.pack_into("<I", buf, 6, rid)
+        if flags & RQ_SPEED:
+            struct.pack_into("<h", buf, 18, self.speed if self.speed_valid() else -1)
+        if flags & RQ_STATUS:
+            buf[26] = self.status
+        if flags & RQ_CAPS:
+            buf[31] = self.caps
+        return finish(buf)
+
+    def data_packet(self):
+        # NOT_DATA: a response without request; id is a sequence counter
+        self.data_seq = (self.data_seq + 1) & 0xffffffff or 1
+        buf = new_packet(BTTFN_VERSION | 0x40, NOT_DATA | RQ_SPEED | RQ_STATUS)
+        struct.pack_into("<I", buf, 6, self.data_seq)
+        struct.pack_into("<h", buf, 18, self.speed if self.speed_valid() else -1)
+        buf[26] = self.status
+        struct.pack_into("<I", buf, 27, self.session)
+        return finish(buf)
+
+    # Streams -----------------------------------------------------
+
+    def speed_valid(self):
+        return self.a.speed_rate > 0 or self.ttrunning
+
+    def step_speed(self):
+        self.speed += self.spd_dir
+        if self.speed >= 88 or self.speed <= 0:
+            self.spd_dir = -self.spd_dir
+        self.spd_seq = (self.spd_seq + 1) & 0xffffffff or 1
+        self.notify(NOT_SPD, self.speed, self.a.speed_src, seq=self.spd_seq)
+
+    def send_data(self):
+        for c in self.active_clients():
+            if c.nd:
+                self.cnt["not"] += 1
+                self.not_cnt["DATA"] = self.not_cnt.get("DATA", 0) + 1
+                self.send(self.data_packet(), c.addr, True)
+
+    def time_travel(self):
+        if self.ttrunning:
+            return
+        self.ttrunning = True
+        self.status |= ST_BUSY
+        self.notify(NOT_PREPARE)
+        t = now_ms() + self.a.prep_lead
+        self.at(t, self.notify, NOT_TT, self.a.tt_lead, self.a.tt_p1)
+        self.at(t + self.a.tt_lead + self.a.tt_p1, self.reentry)
+
+    def reentry(self):
+        self.notify(NOT_REENTRY)
+        self.ttrunning = False
+        self.status &= ~ST_BUSY
+
+    def send_cmd(self):
+        self.notify(NOT_PCG_CMD, cmd=self.rnd.choice(self.a.cmd))
+
+    def new_session(self):
+        # As if TCD rebooted: panels re-sync their NOT_DATA sequence
+        self.session = self.rnd.getrandbits(32) or 1
+        self.data_seq = 0
+        self.log(1, "New NOT_DATA session %08x" % self.session)
+
+    # Receiving ---------------------------------------------------
+
+    def client(self, addr):
+        c = self.clients.get(addr[0])
+        if c is None:
+            c = self.clients[addr[0]] = Client((addr[0], addr[1]))
+        c.addr = (addr[0], addr[1])
+        return c
+
+    def receive(self, sock, via_mc):
+        try:
+            data, addr = sock.recvfrom(256)
+        except (BlockingIOError, InterruptedError):
+            return
+        t = now_ms()
+
+        self.cnt["rx"] += 1
+        if len(data) < PACKET_SIZE or data[0:4] != b"BTTF" or checksum(data) != data[PACKET_SIZE - 1]:
+            self.cnt["rx_bad"] += 1
+            self.log(1, "Bad packet from %s" % addr[0])
+            return
+        if (data[4] & 0x0f) != BTTFN_VERSION:
+            self.cnt["rx_bad"] += 1
+            return
+
+        c = self.client(addr)
+        c.last_seen = t
+        c.name = data[10:23].split(b"\0")[0].decode(errors="replace")
+        c.devtype = data[23]
+        c.nd = self.a.notdata and bool(data[4] & SUP_ND)
+        flags = data[5]
+        rid = struct.unpack_from("<I", data, 6)[0]
+
+        if flags & RQ_DISCOVER:
+            hsh = struct.unpack_from("<I", data, 31)[0]
+            if via_mc or hsh:
+                c.discovers += 1
+                if hsh != self.hash:
+                    self.log(2, "DISCOVER from %s for other TCD (%08x)" % (addr[0], hsh))
+                    return
+                self.log(1, "DISCOVER from %s (%s)" % (addr[0], c.name))
+                self.request(c, flags, rid, t)
+            else:
+                c.tt_triggers += 1
+                self.log(1, "TT triggered by %s" % c.name)
+                self.time_travel()
+            return
+
+        if via_mc:
+            return
+
+        if flags:
+            self.request(c, flags, rid, t)
+            return
+
+        # Command: seq at 6, cmd + parms at 25-27
+        cmd, p1, p2 = data[25], data[26], data[27]
+        c.commands[cmd] = c.commands.get(cmd, 0) + 1
+        if c.last_cmd_seq is not None and rid != ((c.last_cmd_seq + 1) & 0xffffffff or 1):
+            c.cmd_seq_gaps += 1
+        c.last_cmd_seq = rid
+        if cmd == REMCMD_KEEPALIVE:
+            if c.last_ka is not None:
+                c.ka_int.add(t - c.last_ka)
+            c.last_ka = t
+            self.log(1, "KEEPALIVE from %s" % c.name)
+        elif cmd == REMCMD_DOOR:
+            c.door["close" if p1 & 0x80 else "open"] += 1
+            self.log(1, "DOOR %s door %d, delay %dms, from %s" % (
+                "close" if p1 & 0x80 else "open", (p1 >> 5) & 0x03,
+                ((p1 & 0x1f) << 8) | p2, c.name))
+        else:
+            self.log(1, "Command %d (%d, %d) from %s" % (cmd, p1, p2, c.name))
+
+    def request(self, c, flags, rid, t):
+        c.requests += 1
+
+        if c.lost_rsp is not None:
+            c.retry.add(t - c.lost_rsp)
+            c.lost_rsp = None
+        elif c.last_poll is not None:
+            c.poll_int.add(t - c.last_poll)
+        if c.prepare is not None:
+            c.prep_react.add(t - c.prepare)
+            c.prepare = None
+        c.last_poll = t
+
+        pkt = self.response(flags, rid)
+        delay = self.a.rsp_delay
+        if self.a.rsp_jitter:
+            delay += self.rnd.uniform(0, self.a.rsp_jitter)
+        if self.lose(self.a.rsp_loss):
+            self.cnt["rsp_lost"] += 1
+            c.lost_rsp = t
+            return
+        self.cnt["rsp"] += 1
+        if delay > 0:
+            self.at(t + delay, self.sock.sendto, pkt, c.addr)
+        else:
+            self.sock.sendto(pkt, c.addr)
+
+    # Output ------------------------------------------------------
+
+    def log(self, level, msg):
+        if self.a.verbose >= level:
+            print("%9.3f %s" % ((now_ms() - self.start) / 1000.0, msg), flush=True)
+
+    def report(self):
+        el = (now_ms() - self.start) / 1000.0
+        c = self.cnt
+        print("--- %.1fs: rx %d (bad %d), responses %d (lost %d), "
+              "notifications %d (lost %d, reordered %d, multicast %d)" % (
+              el, c["rx"], c["rx_bad"], c["rsp"], c["rsp_lost"],
+              c["not"], c["not_lost"], c["not_reord"], c["not_mc"]))
+        if self.not_cnt:
+            print("    sent: " + ", ".join("%s %d" % kv for kv in sorted(self.not_cnt.items())))
+        for cl in self.clients.values():
+            cmds = ", ".join("%d:%d" % kv for kv in sorted(cl.commands.items())) or "-"
+            print("  %s (%s, %s)%s: requests %d, discover %d, TT %d, commands [%s], "
+                  "door open %d close %d, cmd seq gaps %d" % (
+                  cl.addr[0], cl.name, DEVTYPES.get(cl.devtype, cl.devtype),
+                  " ND" if cl.nd else "", cl.requests, cl.discovers, cl.tt_triggers,
+                  cmds, cl.door["open"], cl.door["close"], cl.cmd_seq_gaps))
+            print("    poll interval ms:           %s" % cl.poll_int)
+            print("    retry after lost rsp ms:    %s" % cl.retry)
+            print("    PREPARE -> next request ms: %s" % cl.prep_react)
+            print("    keepalive interval ms:      %s" % cl.ka_int)
+        sys.stdout.flush()
+
+    # Main loop ---------------------------------------------------
+
+    def run(self):
+        a = self.a
+        if a.speed_rate > 0:
+            self.every(1000.0 / a.speed_rate, self.step_speed)
+        self.every(a.tt_every * 1000, self.time_travel)
+        self.every(a.alarm_every * 1000, lambda: self.notify(NOT_ALARM))
+        if a.cmd_rate > 0:
+            self.every(1000.0 / a.cmd_rate, self.send_cmd)
+        if a.notdata:
+            self.every(a.data_int, self.send_data)
+            self.every(a.session_every * 1000, self.new_session)
+        self.every(a.report * 1000, self.report)
+        if a.duration > 0:
+            self.at(now_ms() + a.duration * 1000, self.stop)
+
+        print("tcdsim: '%s' (hash %08x) on %s:%d, caps %02x" % (
+              a.name, self.hash, a.bind or "*", TCD_PORT, self.caps), flush=True)
+
+        self.running = True
+        while self.running:
+            t = now_ms()
+            while self.timers and self.timers[0][0] <= t:
+                _, _, fn, args = heapq.heappop(self.timers)
+                fn(*args)
+            self.flush_held()
+            wait = 0.1
+            if self.timers:
+                wait = min(wait, max(0.0, (self.timers[0][0] - now_ms()) / 1000.0))
+            r, _, _ = select.select([self.sock, self.mcsock], [], [], wait)
+            for s in r:
+                self.receive(s, s is self.mcsock)
+
+        self.flush_held(True)
+        self.report()
+
+    def stop(self):
+        self.running = False
+
+
+def main():
+    p = argparse.ArgumentParser(description="TCD stand-in for testing BTTFN clients")
+    p.add_argument("--bind", default="", help="local IP address to use (default: all)")
+    p.add_argument("--name", default="timecircuits", help="hostname for DISCOVER (default: timecircuits)")
+    p.add_argument("--mc", action="store_true", help="send notifications by multicast")
+    p.add_argument("--notdata", action="store_true", help="support NOT_DATA (push status instead of polling)")
+    p.add_argument("--data-int", type=float, default=5000, help="NOT_DATA interval in ms (default 5000)")
+    p.add_argument("--session-every", type=float, default=0, help="start new NOT_DATA session every N s")
+    p.add_argument("--speed-rate", type=float, default=0, help="NOT_SPD packets per second (0=off)")
+    p.add_argument("--speed-src", type=int, default=SSRC_GPS, help="speed source (1=GPS, 2=RotEnc, ...)")
+    p.add_argument("--tt-every", type=float, default=0, help="time travel every N s (0=off)")
+    p.add_argument("--prep-lead", type=float, default=2000, help="ms from NOT_PREPARE to NOT_TT")
+    p.add_argument("--tt-lead", type=int, default=5000, help="TT lead in ms (default 5000)")
+    p.add_argument("--tt-p1", type=int, default=6600, help="TT P1 duration in ms (default 6600)")
+    p.add_argument("--alarm-every", type=float, default=0, help="alarm every N s (0=off)")
+    p.add_argument("--cmd-rate", type=float, default=0, help="NOT_PCG_CMD packets per second (0=off)")
+    p.add_argument("--cmd", type=lambda s: [int(x) for x in s.split(",")], default=[1, 3],
+                   help="comma-separated commands to pick from (default 1,3)")
+    p.add_argument("--loss", type=float, default=0, help="%% of notifications dropped")
+    p.add_argument("--reorder", type=float, default=0, help="%% of notifications sent late")
+    p.add_argument("--reorder-hold", type=float, default=200, help="max ms a late packet is held")
+    p.add_argument("--rsp-loss", type=float, default=0, help="%% of responses dropped")
+    p.add_argument("--rsp-delay", type=float, default=0, help="response delay in ms")
+    p.add_argument("--rsp-jitter", type=float, default=0, help="random extra response delay in ms")
+    p.add_argument("--client-to", type=float, default=120, help="forget silent panels after N s")
+    p.add_argument("--report", type=float, default=10, help="print statistics every N s")
+    p.add_argument("--duration", type=float, default=0, help="stop after N s (0=run until Ctrl-C)")
+    p.add_argument("--seed", type=int, default=None, help="random seed")
+    p.add_argument("-v", "--verbose", action="count", default=0)
+    sim = TCDSim(p.parse_args())
+
+    signal.signal(signal.SIGINT, lambda *x: sim.stop())
+    signal.signal(signal.SIGTERM, lambda *x: sim.stop())
+    sim.run()
+
+
+if __name__ == "__main__":
+    main()